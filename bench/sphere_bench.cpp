@@ -0,0 +1,146 @@
+// -*- lsst-c++ -*-
+/**
+ * @file sphere_bench.cpp
+ * @brief Microbenchmark of the ray/sphere closest-hit kernel.
+ *
+ * @details Compares Sphere::intersect_closest (half-b form, precomputed radius², interval test
+ * without division, hit point evaluated once for the closest hit) with the previous kernel
+ * (full b² - 4ac form, two divisions, hit point evaluated for every candidate). Every ray is
+ * tested against every sphere, so the timings measure the kernel itself.
+ *
+ * Usage: sphere_bench [rays] [spheres] [repetitions]
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "elements.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Previous Sphere::intersect, kept as the baseline of the benchmark.
+    Intersection legacy_intersect(const Sphere &sphere, const Ray &ray)
+    {
+        Vec3 oc = ray.source - sphere.center;
+        double a = ray.direction.dot(ray.direction);
+        double b = 2.0 * oc.dot(ray.direction);
+        double c = oc.dot(oc) - sphere.radius * sphere.radius;
+        double discriminant = b * b - 4 * a * c;
+
+        if (discriminant > 0)
+        {
+            double sqrtDiscriminant = std::sqrt(discriminant);
+            double t1 = (-b - sqrtDiscriminant) / (2.0 * a);
+            double t2 = (-b + sqrtDiscriminant) / (2.0 * a);
+            double t = t1 > ray.t_min ? t1 : t2;
+            if (t > ray.t_min && t < ray.t_max)
+            {
+                return Intersection(ray.at(t), t, &sphere);
+            }
+        }
+        return Intersection();
+    }
+
+    // Closest hit over all the spheres with the previous kernel.
+    Intersection legacy_closest(const std::vector<std::unique_ptr<Sphere>> &spheres, const Ray &ray)
+    {
+        Intersection closest;
+        closest.t = ray.t_max;
+        for (const auto &sphere : spheres)
+        {
+            Intersection hit = legacy_intersect(*sphere, ray);
+            if (hit.valid && hit.t < closest.t)
+            {
+                closest = hit;
+            }
+        }
+        return closest;
+    }
+
+    // Closest hit over all the spheres with the current kernel.
+    Intersection current_closest(const std::vector<std::unique_ptr<Sphere>> &spheres, const Ray &ray)
+    {
+        Ray interval_ray = ray;
+        Intersection closest;
+        for (const auto &sphere : spheres)
+        {
+            sphere->intersect_closest(interval_ray, closest);
+        }
+        if (closest.valid)
+        {
+            closest.point = ray.at(closest.t);
+        }
+        return closest;
+    }
+
+    // Run a kernel over every ray `repetitions` times; return the time in seconds and a checksum.
+    template <typename Kernel>
+    double run(const std::vector<Ray> &rays, int repetitions, Kernel kernel, double &checksum, std::vector<const Element *> &closest)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int repetition = 0; repetition < repetitions; ++repetition)
+        {
+            for (std::size_t i = 0; i < rays.size(); ++i)
+            {
+                Intersection hit = kernel(rays[i]);
+                checksum += hit.valid ? hit.point[0] + hit.point[1] + hit.point[2] : 0.0;
+                closest[i] = hit.element;
+            }
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::size_t ray_count = argc > 1 ? std::stoul(argv[1]) : 1 << 16;
+    const std::size_t sphere_count = argc > 2 ? std::stoul(argv[2]) : 64;
+    const int repetitions = argc > 3 ? std::stoi(argv[3]) : 20;
+
+    // Random spheres in a box in front of the rays, random normalized directions
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> position(-10.0, 10.0);
+    std::uniform_real_distribution<double> size(0.2, 2.0);
+    std::uniform_real_distribution<double> spread(-0.5, 0.5);
+
+    std::vector<std::unique_ptr<Sphere>> spheres;
+    for (std::size_t k = 0; k < sphere_count; ++k)
+    {
+        spheres.push_back(std::make_unique<Sphere>(Vec3(position(generator), position(generator), position(generator) - 20.0), size(generator), Material()));
+    }
+    std::vector<Ray> rays;
+    for (std::size_t k = 0; k < ray_count; ++k)
+    {
+        rays.emplace_back(Vec3(0.0, 0.0, 1.0), Vec3(spread(generator), spread(generator), -1.0).normalize());
+    }
+
+    double legacy_checksum = 0.0, current_checksum = 0.0;
+    std::vector<const Element *> legacy_hits(ray_count), current_hits(ray_count);
+    double legacy_time = run(rays, repetitions, [&](const Ray &ray)
+                             { return legacy_closest(spheres, ray); }, legacy_checksum, legacy_hits);
+    double current_time = run(rays, repetitions, [&](const Ray &ray)
+                              { return current_closest(spheres, ray); }, current_checksum, current_hits);
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < ray_count; ++i)
+    {
+        mismatches += legacy_hits[i] != current_hits[i];
+    }
+
+    const double tests = static_cast<double>(ray_count) * sphere_count * repetitions;
+    std::cout << "rays: " << ray_count << ", spheres: " << sphere_count << ", repetitions: " << repetitions << "\n"
+              << "legacy kernel:  " << 1e9 * legacy_time / tests << " ns/test (checksum " << legacy_checksum << ")\n"
+              << "current kernel: " << 1e9 * current_time / tests << " ns/test (checksum " << current_checksum << ")\n"
+              << "speedup: " << legacy_time / current_time << "x, closest-hit mismatches: " << mismatches << "\n";
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,107 @@
+// -*- lsst-c++ -*-
+/**
+ * @file aabb.hpp
+ * @brief Declaration of the Aabb struct (axis-aligned bounding box).
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef AABB_HPP_
+#define AABB_HPP_
+
+#include "vec3.hpp"
+
+#include <algorithm>
+#include <limits>
+
+struct Aabb
+{
+    Vec3 min; ///< Lower corner of the box.
+    Vec3 max; ///< Upper corner of the box.
+
+    /**
+     * @brief Default constructor.
+     * @details Initializes an empty box (min = +inf, max = -inf) so that any expansion replaces it.
+     */
+    Aabb()
+        : min(std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()),
+          max(-std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()) {}
+
+    /**
+     * @brief Constructor with both corners.
+     * @param lower Lower corner of the box.
+     * @param upper Upper corner of the box.
+     */
+    Aabb(const Vec3 &lower, const Vec3 &upper) : min(lower), max(upper) {}
+
+    /**
+     * @brief Tell if the box contains nothing.
+     * @return true if the box is empty, false otherwise.
+     */
+    bool empty() const { return min[0] > max[0] || min[1] > max[1] || min[2] > max[2]; }
+
+    /**
+     * @brief Grow the box so that it contains the point.
+     * @param point The considered point.
+     */
+    void expand(const Vec3 &point)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            min[axis] = std::min(min[axis], point[axis]);
+            max[axis] = std::max(max[axis], point[axis]);
+        }
+    }
+
+    /**
+     * @brief Grow the box so that it contains another box.
+     * @param box The considered box.
+     */
+    void expand(const Aabb &box)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            min[axis] = std::min(min[axis], box.min[axis]);
+            max[axis] = std::max(max[axis], box.max[axis]);
+        }
+    }
+
+    /**
+     * @brief Center of the box.
+     * @return The centroid.
+     */
+    Vec3 centroid() const { return (min + max) * 0.5; }
+
+    /**
+     * @brief Size of the box along each axis.
+     * @return The box diagonal.
+     */
+    Vec3 extent() const { return max - min; }
+
+    /**
+     * @brief Index of the axis along which the box is the largest.
+     * @return 0, 1 or 2.
+     */
+    int largest_axis() const
+    {
+        Vec3 e = extent();
+        return (e[0] > e[1] && e[0] > e[2]) ? 0 : (e[1] > e[2] ? 1 : 2);
+    }
+
+    /**
+     * @brief Surface area of the box (0 for an empty box).
+     * @return The surface area.
+     */
+    double surface_area() const
+    {
+        if (empty())
+        {
+            return 0.0;
+        }
+        Vec3 e = extent();
+        return 2.0 * (e[0] * e[1] + e[1] * e[2] + e[2] * e[0]);
+    }
+};
+
+#endif // AABB_HPP_
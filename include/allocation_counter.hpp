@@ -0,0 +1,32 @@
+// -*- lsst-c++ -*-
+/**
+ * @file allocation_counter.hpp
+ * @brief Heap allocation counter (debug builds).
+ *
+ * @details When the program is compiled with PATH_TRACING_COUNT_ALLOCATIONS (the default for
+ * Debug builds), the global operator new is replaced by a version that counts the allocations
+ * made by each thread. The renderers use it to check that their steady-state loop does not
+ * touch the heap.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef ALLOCATION_COUNTER_HPP_
+#define ALLOCATION_COUNTER_HPP_
+
+#include <cstddef>
+
+/**
+ * @brief Tell if the allocations are counted.
+ * @return true if the program was compiled with PATH_TRACING_COUNT_ALLOCATIONS, false otherwise.
+ */
+bool allocation_counting_enabled();
+
+/**
+ * @brief Number of heap allocations made so far by the calling thread.
+ * @return The number of allocations (always 0 if the allocations are not counted).
+ */
+std::size_t thread_allocation_count();
+
+#endif // ALLOCATION_COUNTER_HPP_
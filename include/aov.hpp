@@ -0,0 +1,105 @@
+// -*- lsst-c++ -*-
+/**
+ * @file aov.hpp
+ * @brief Declaration of the AovBuffers struct (auxiliary outputs of the primary rays).
+ *
+ * @details Arbitrary output variables recorded at the first hit of every camera ray, next to
+ * Screen::pixels: depth, world normal, albedo, element index, number of shadow rays traced and
+ * cost of the pixel.
+ * Each quantity is a separate planar buffer in row-major order, allocated only if its channel
+ * is requested; renderers skip the recording entirely when no channel is.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef AOV_HPP_
+#define AOV_HPP_
+
+#include "intersection.hpp"
+#include "vec3.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Scene;
+
+struct AovBuffers
+{
+    /**
+     * @brief Channels of the buffers (flags, combined with |).
+     */
+    enum Channel : unsigned
+    {
+        Depth = 1u << 0,      ///< Distance t to the first hit.
+        Normal = 1u << 1,     ///< World normal at the first hit.
+        Albedo = 1u << 2,     ///< Albedo of the element hit first.
+        ElementId = 1u << 3,  ///< Index of the element hit first in Scene::elements.
+        ShadowRays = 1u << 4, ///< Shadow rays traced for the pixel (per facing light, and per hit of the path and per sample in depth-first mode).
+        Cost = 1u << 5,       ///< Cycles spent on the pixel, all samples included (depth-first mode only, see cycle_counter.hpp).
+        All = (1u << 6) - 1   ///< Every channel.
+    };
+
+    static constexpr std::uint32_t no_element = 0xffffffffu; ///< Element index of a miss.
+
+    int width = 0;                             ///< Width of the buffers in pixels.
+    int height = 0;                            ///< Height of the buffers in pixels.
+    unsigned channels = 0;                     ///< Allocated channels.
+    std::vector<float> depth;                  ///< Distance t to the first hit (0 on a miss).
+    std::array<std::vector<float>, 3> normal;  ///< World normal at the first hit (0 on a miss).
+    std::array<std::vector<float>, 3> albedo;  ///< Albedo of the element hit first (0 on a miss).
+    std::vector<std::uint32_t> element_id;     ///< Index of the element hit first (no_element on a miss).
+    std::vector<std::uint32_t> shadow_rays;    ///< Number of shadow rays traced for the pixel.
+    std::vector<std::uint64_t> cost;           ///< Cycles spent on the pixel.
+
+    /**
+     * @brief Allocate the requested channels (every pixel is a miss) and free the others.
+     * @param width, height size of the image in pixels.
+     * @param channels requested channels (Channel flags).
+     */
+    void resize(int width, int height, unsigned channels);
+
+    /**
+     * @brief Tell if every given channel is allocated.
+     * @param requested Channel flags.
+     */
+    bool has(unsigned requested) const { return (channels & requested) == requested; }
+
+    /**
+     * @brief Record the first hit of the ray of a pixel (in the allocated channels).
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     * @param scene The rendered scene (normals).
+     * @param hit The first intersection of the camera ray (an invalid one for a miss).
+     * @param shadow_ray_count Number of shadow rays traced for the pixel.
+     */
+    void record(int i, int j, const Scene &scene, const Intersection &hit, std::uint32_t shadow_ray_count);
+
+    /**
+     * @brief Record the cost of a pixel (if the channel is allocated).
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     * @param cycles Cycles spent on the pixel.
+     */
+    void record_cost(int i, int j, std::uint64_t cycles)
+    {
+        if (channels & Cost)
+        {
+            cost[static_cast<std::size_t>(j) * width + i] = cycles;
+        }
+    }
+
+    /**
+     * @brief Save every allocated channel as a Portable float map named prefix_<channel>.pfm.
+     * @details Depth, element index, shadow rays and cost are grayscale maps, normal and albedo RGB maps.
+     *
+     * @param prefix path and beginning of the file names.
+     * @throws std::runtime_error if a file cannot be written.
+     */
+    void save_as_pfm(const std::string &prefix) const;
+};
+
+#endif // AOV_HPP_
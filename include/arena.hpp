@@ -0,0 +1,124 @@
+// -*- lsst-c++ -*-
+/**
+ * @file arena.hpp
+ * @brief Declaration of the Arena class (bump allocator for transient render data).
+ *
+ * @details An Arena hands out memory by bumping an offset inside large blocks and frees
+ * everything at once with reset(). The blocks are kept across resets, so once an arena has
+ * grown to the size of a tile (or of a frame), the render loop stops calling malloc. Each
+ * render thread owns its own arena: there is no locking.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class Arena
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param block_size Size in bytes of the blocks requested from the heap.
+     */
+    explicit Arena(std::size_t block_size = 64 * 1024);
+
+    // delete the copy constructor and affectation operator (the memory is not shared).
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    Arena(Arena &&) = default;
+
+    Arena &operator=(Arena &&) = default;
+
+    /**
+     * @brief Allocate memory from the arena.
+     * @param size Number of bytes.
+     * @param alignment Alignment of the memory (power of two, at most alignof(std::max_align_t)).
+     * @return Pointer to the memory, valid until the next reset().
+     */
+    void *allocate(std::size_t size, std::size_t alignment)
+    {
+        if (current < blocks.size())
+        {
+            std::size_t start = (offset + alignment - 1) & ~(alignment - 1);
+            if (start + size <= blocks[current].size)
+            {
+                offset = start + size;
+                return blocks[current].data.get() + start;
+            }
+        }
+        return allocate_slow(size, alignment);
+    }
+
+    /**
+     * @brief Release every allocation at once (the blocks are kept for reuse).
+     */
+    void reset()
+    {
+        current = 0;
+        offset = 0;
+    }
+
+    /**
+     * @brief Total size of the blocks owned by the arena.
+     * @return The capacity in bytes.
+     */
+    std::size_t capacity() const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> data; ///< Memory of the block.
+        std::size_t size;                      ///< Size of the block in bytes.
+    };
+
+    std::size_t block_size;    ///< Default size of the blocks.
+    std::vector<Block> blocks; ///< Blocks, in allocation order.
+    std::size_t current = 0;   ///< Block being filled.
+    std::size_t offset = 0;    ///< First free byte of the current block.
+
+    void *allocate_slow(std::size_t size, std::size_t alignment);
+};
+
+/**
+ * @brief Standard allocator drawing from an Arena (deallocate is a no-op).
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena &arena) : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+
+    void deallocate(T *, std::size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    Arena *arena; ///< Arena providing the memory.
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>; ///< Vector living in an Arena.
+
+#endif // ARENA_HPP_
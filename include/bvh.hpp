@@ -0,0 +1,282 @@
+// -*- lsst-c++ -*-
+/**
+ * @file bvh.hpp
+ * @brief Declaration of the Bvh class (bounding volume hierarchy).
+ *
+ * @details The hierarchy is stored as a flat, depth-first array of 32-byte nodes: the first
+ * child of an interior node immediately follows it, the second one is referenced by index.
+ * The Bvh only knows primitive bounds and indices; the caller provides the primitive
+ * intersection routine to the (templated) traversal functions.
+ *
+ * Three builders produce this layout (see BvhBuildMethod). The top of the tree is split on the
+ * whole ThreadPool, then the subtrees of at most Bvh::subtree_size primitives are built in
+ * parallel, one per task, and copied at their place in the depth-first array. Every split is
+ * deterministic, so the tree does not depend on the number of threads.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef BVH_HPP_
+#define BVH_HPP_
+
+#include "aabb.hpp"
+#include "ray.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Split strategy of the Bvh builders.
+ */
+enum class BvhBuildMethod
+{
+    Median,    ///< Median of the centroids along the largest axis (serial, balanced tree).
+    BinnedSah, ///< Surface area heuristic evaluated on 16 bins along the largest axis (best traversal speed).
+    Morton     ///< Linear BVH: primitives sorted along a Morton curve, split on its bits (fastest build).
+};
+
+/**
+ * @brief Node of a flattened Bvh (32 bytes, two nodes per cache line).
+ */
+struct BvhNode
+{
+    float lower[3];       ///< Lower corner of the node bounds (rounded down).
+    float upper[3];       ///< Upper corner of the node bounds (rounded up).
+    std::uint32_t offset; ///< Leaf: first entry in Bvh::indices. Interior: index of the second child.
+    std::uint16_t count;  ///< Number of primitives of a leaf (0 for an interior node).
+    std::uint16_t axis;   ///< Split axis of an interior node.
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode is expected to be 32 bytes");
+
+/**
+ * @brief Ray data precomputed once per traversal (inverse direction and direction signs).
+ */
+struct BvhRay
+{
+    double origin[3];        ///< Origin of the ray.
+    double t_min;            ///< Lower bound of the ray interval.
+    double inv_direction[3]; ///< Component-wise inverse of the ray direction.
+    bool negative[3];        ///< True if the direction component is negative.
+
+    /**
+     * @brief Constructor from a ray.
+     * @param ray The considered ray.
+     */
+    explicit BvhRay(const Ray &ray);
+
+    /**
+     * @brief Slab test of the ray against a node.
+     * @param node The considered node.
+     * @param t_max Upper bound of the ray interval.
+     * @param t_entry Distance at which the ray enters the node (output).
+     *
+     * @return true if the ray overlaps the node within [t_min, t_max], false otherwise.
+     */
+    bool intersect(const BvhNode &node, double t_max, double &t_entry) const
+    {
+        double t_near = t_min;
+        double t_far = t_max;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            double t0 = (node.lower[axis] - origin[axis]) * inv_direction[axis];
+            double t1 = (node.upper[axis] - origin[axis]) * inv_direction[axis];
+            if (negative[axis])
+            {
+                std::swap(t0, t1);
+            }
+            t_near = t0 > t_near ? t0 : t_near;
+            t_far = t1 < t_far ? t1 : t_far;
+        }
+        t_entry = t_near;
+        return t_near <= t_far;
+    }
+};
+
+class Bvh
+{
+public:
+    static constexpr int max_leaf_size = 4;   ///< Maximal number of primitives per leaf.
+    static constexpr int max_stack_size = 96; ///< Maximal traversal depth.
+    static constexpr std::uint32_t subtree_size = 1 << 14; ///< Largest subtree built by a single task.
+
+    std::vector<BvhNode> nodes;         ///< Flattened nodes (depth-first order, root first).
+    std::vector<std::uint32_t> indices; ///< Primitive indices, in leaf order.
+
+    /**
+     * @brief Build the hierarchy over a list of primitive bounds, on the calling thread.
+     * @details Median split along the largest axis of the centroid bounds.
+     *
+     * @param bounds The bounds of the primitives (primitive i has bounds[i]).
+     */
+    void build(const std::vector<Aabb> &bounds);
+
+    /**
+     * @brief Build the hierarchy over a list of primitive bounds with a pool of threads.
+     * @param bounds The bounds of the primitives (primitive i has bounds[i]).
+     * @param pool Threads sharing the build.
+     * @param method Split strategy.
+     */
+    void build(const std::vector<Aabb> &bounds, ThreadPool &pool, BvhBuildMethod method);
+
+    /**
+     * @brief Update the node bounds after the primitives moved, keeping the topology.
+     * @details Much cheaper than build(), but the tree quality degrades if the primitives move a lot.
+     *
+     * @param bounds The new bounds of the primitives (same count as for the build).
+     */
+    void refit(const std::vector<Aabb> &bounds);
+
+    /**
+     * @brief Tell if the hierarchy holds no primitive.
+     * @return true if the hierarchy is empty, false otherwise.
+     */
+    bool empty() const { return nodes.empty(); }
+
+    /**
+     * @brief Bounds of the whole hierarchy.
+     * @return The root bounds (empty box if the hierarchy is empty).
+     */
+    Aabb bounds() const;
+
+    /**
+     * @brief Find the closest primitive hit by the ray.
+     * @param ray The considered ray, whose t_max is shrunk to the closest hit distance.
+     * @param intersect_primitive Callable `bool(std::uint32_t primitive, Ray &ray)` that tests a
+     * primitive within the ray interval, returns true on a hit and then shrinks ray.t_max.
+     *
+     * @return true if a primitive was hit, false otherwise.
+     */
+    template <typename Intersector>
+    bool closest_hit(Ray &ray, Intersector &&intersect_primitive) const;
+
+    /**
+     * @brief Tell if any primitive is hit within the ray interval.
+     * @param ray The considered ray.
+     * @param intersect_primitive Callable `bool(std::uint32_t primitive, const Ray &ray)` that tells
+     * if a primitive is hit within the ray interval.
+     *
+     * @return true if a primitive was hit, false otherwise.
+     */
+    template <typename Intersector>
+    bool any_hit(const Ray &ray, Intersector &&intersect_primitive) const;
+};
+
+template <typename Intersector>
+bool Bvh::closest_hit(Ray &ray, Intersector &&intersect_primitive) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const BvhRay bvh_ray(ray);
+    double t_entry;
+    if (!bvh_ray.intersect(nodes[0], ray.t_max, t_entry))
+    {
+        return false;
+    }
+
+    std::pair<std::uint32_t, double> stack[max_stack_size];
+    int stack_size = 0;
+    std::uint32_t node_index = 0;
+    bool hit = false;
+
+    while (true)
+    {
+        const BvhNode &node = nodes[node_index];
+        if (node.count > 0)
+        {
+            for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                hit = intersect_primitive(indices[i], ray) || hit;
+            }
+        }
+        else
+        {
+            std::uint32_t near_child = node_index + 1;
+            std::uint32_t far_child = node.offset;
+            if (bvh_ray.negative[node.axis])
+            {
+                std::swap(near_child, far_child);
+            }
+            double t_near, t_far;
+            bool hit_near = bvh_ray.intersect(nodes[near_child], ray.t_max, t_near);
+            bool hit_far = bvh_ray.intersect(nodes[far_child], ray.t_max, t_far);
+            if (hit_near && hit_far)
+            {
+                if (t_far < t_near)
+                {
+                    std::swap(near_child, far_child);
+                    std::swap(t_near, t_far);
+                }
+                stack[stack_size++] = {far_child, t_far};
+                node_index = near_child;
+                continue;
+            }
+            if (hit_near || hit_far)
+            {
+                node_index = hit_near ? near_child : far_child;
+                continue;
+            }
+        }
+
+        // Pop the next node that may still contain a closer hit
+        do
+        {
+            if (stack_size == 0)
+            {
+                return hit;
+            }
+            --stack_size;
+        } while (stack[stack_size].second > ray.t_max);
+        node_index = stack[stack_size].first;
+    }
+}
+
+template <typename Intersector>
+bool Bvh::any_hit(const Ray &ray, Intersector &&intersect_primitive) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const BvhRay bvh_ray(ray);
+    std::uint32_t stack[max_stack_size];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        const BvhNode &node = nodes[stack[--stack_size]];
+        double t_entry;
+        if (!bvh_ray.intersect(node, ray.t_max, t_entry))
+        {
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                if (intersect_primitive(indices[i], ray))
+                {
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            std::uint32_t node_index = static_cast<std::uint32_t>(&node - nodes.data());
+            stack[stack_size++] = node.offset;
+            stack[stack_size++] = node_index + 1;
+        }
+    }
+    return false;
+}
+
+#endif // BVH_HPP_
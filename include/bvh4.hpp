@@ -0,0 +1,241 @@
+// -*- lsst-c++ -*-
+/**
+ * @file bvh4.hpp
+ * @brief Declaration of the Bvh4 class (4-wide bounding volume hierarchy).
+ *
+ * @details A Bvh4 is collapsed from a binary Bvh: every node holds up to four children, whose
+ * bounds are stored axis by axis (structure of arrays), so that a ray is tested against the four
+ * boxes by one loop over the lanes that the compiler vectorises (four doubles: one AVX register
+ * with PATH_TRACING_NATIVE_ARCH, two SSE2 registers otherwise). The children hit by the ray are
+ * visited from the nearest to the farthest, for closest-hit and any-hit queries alike.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef BVH4_HPP_
+#define BVH4_HPP_
+
+#include "bvh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Node of a Bvh4 (128 bytes, two cache lines).
+ * @details An unused child slot has empty bounds (+inf lower, -inf upper): no ray overlaps it.
+ */
+struct alignas(64) Bvh4Node
+{
+    float lower[3][4];       ///< Lower corners of the children bounds, axis by axis.
+    float upper[3][4];       ///< Upper corners of the children bounds, axis by axis.
+    std::uint32_t child[4];  ///< Interior child: index of its node. Leaf child: first entry in Bvh4::indices.
+    std::uint16_t count[4];  ///< Number of primitives of a leaf child (0 for an interior child).
+    std::uint32_t padding[2]; ///< Pads the node to 128 bytes.
+};
+
+static_assert(sizeof(Bvh4Node) == 128, "Bvh4Node is expected to be 128 bytes");
+
+class Bvh4
+{
+public:
+    static constexpr int width = 4;                                    ///< Number of children per node.
+    static constexpr int max_stack_size = 3 * Bvh::max_stack_size + 1; ///< Each node pushes at most three more entries than it pops.
+
+    std::vector<Bvh4Node> nodes;        ///< Nodes (depth-first order, root first).
+    std::vector<std::uint32_t> indices; ///< Primitive indices, in leaf order.
+
+    /**
+     * @brief Collapse a binary hierarchy.
+     * @details Each node takes the two children of a binary node, then repeatedly replaces its
+     * interior child of largest surface area by that child's two children, until it has four.
+     *
+     * @param bvh The binary hierarchy (its leaves are kept).
+     */
+    void build(const Bvh &bvh);
+
+    /**
+     * @brief Tell if the hierarchy holds no primitive.
+     * @return true if the hierarchy is empty, false otherwise.
+     */
+    bool empty() const { return nodes.empty(); }
+
+    /**
+     * @brief Find the closest primitive hit by the ray.
+     * @param ray The considered ray, whose t_max is shrunk to the closest hit distance.
+     * @param intersect_primitive Callable `bool(std::uint32_t primitive, Ray &ray)`, as for Bvh::closest_hit.
+     *
+     * @return true if a primitive was hit, false otherwise.
+     */
+    template <typename Intersector>
+    bool closest_hit(Ray &ray, Intersector &&intersect_primitive) const;
+
+    /**
+     * @brief Tell if any primitive is hit within the ray interval.
+     * @param ray The considered ray.
+     * @param intersect_primitive Callable `bool(std::uint32_t primitive, const Ray &ray)`, as for Bvh::any_hit.
+     *
+     * @return true if a primitive was hit, false otherwise.
+     */
+    template <typename Intersector>
+    bool any_hit(const Ray &ray, Intersector &&intersect_primitive) const;
+
+private:
+    /**
+     * @brief Entry of the traversal stack: a node or a leaf, and the distance at which the ray enters it.
+     */
+    struct StackEntry
+    {
+        std::uint32_t offset; ///< Node index, or first entry in `indices` for a leaf.
+        std::uint32_t count;  ///< Number of primitives of a leaf (0 for a node).
+        double t_entry;       ///< Distance at which the ray enters the entry.
+    };
+
+    /**
+     * @brief Start loading a node into the cache (both of its cache lines).
+     * @details The child nodes are fetched while the current one is processed: on large scenes the
+     * traversal waits on memory more than on the box tests.
+     *
+     * @param node The node about to be visited.
+     */
+    static void prefetch(const Bvh4Node &node)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(&node);
+        __builtin_prefetch(reinterpret_cast<const char *>(&node) + 64);
+#else
+        (void)node;
+#endif
+    }
+
+    /**
+     * @brief Test a ray against the four children of a node and push the ones it hits, farthest first.
+     * @details The interior children hit are prefetched.
+     *
+     * @param ray Ray data (from BvhRay).
+     * @param node The considered node.
+     * @param t_max Upper bound of the ray interval.
+     * @param stack The traversal stack.
+     * @param stack_size Number of entries of the stack (updated).
+     */
+    void push_children(const BvhRay &ray, const Bvh4Node &node, double t_max, StackEntry *stack, int &stack_size) const
+    {
+        // Slab test of the four children, lane by lane (vectorised)
+        double t_near[width];
+        double t_far[width];
+        for (int lane = 0; lane < width; ++lane)
+        {
+            t_near[lane] = ray.t_min;
+            t_far[lane] = t_max;
+        }
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float *near_planes = ray.negative[axis] ? node.upper[axis] : node.lower[axis];
+            const float *far_planes = ray.negative[axis] ? node.lower[axis] : node.upper[axis];
+            for (int lane = 0; lane < width; ++lane)
+            {
+                const double t0 = (near_planes[lane] - ray.origin[axis]) * ray.inv_direction[axis];
+                const double t1 = (far_planes[lane] - ray.origin[axis]) * ray.inv_direction[axis];
+                t_near[lane] = t0 > t_near[lane] ? t0 : t_near[lane];
+                t_far[lane] = t1 < t_far[lane] ? t1 : t_far[lane];
+            }
+        }
+
+        // Children hit, sorted by decreasing entry distance, so that the nearest is popped first
+        StackEntry hits[width];
+        int hit_count = 0;
+        for (int lane = 0; lane < width; ++lane)
+        {
+            if (t_near[lane] <= t_far[lane])
+            {
+                StackEntry entry{node.child[lane], node.count[lane], t_near[lane]};
+                if (entry.count == 0)
+                {
+                    prefetch(nodes[entry.offset]);
+                }
+                int k = hit_count++;
+                for (; k > 0 && hits[k - 1].t_entry < entry.t_entry; --k)
+                {
+                    hits[k] = hits[k - 1];
+                }
+                hits[k] = entry;
+            }
+        }
+        for (int k = 0; k < hit_count; ++k)
+        {
+            stack[stack_size++] = hits[k];
+        }
+    }
+};
+
+template <typename Intersector>
+bool Bvh4::closest_hit(Ray &ray, Intersector &&intersect_primitive) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const BvhRay bvh_ray(ray);
+    StackEntry stack[max_stack_size];
+    int stack_size = 0;
+    push_children(bvh_ray, nodes[0], ray.t_max, stack, stack_size);
+    bool hit = false;
+
+    while (stack_size > 0)
+    {
+        const StackEntry entry = stack[--stack_size];
+        if (entry.t_entry > ray.t_max)
+        {
+            continue; // a closer hit was found since the entry was pushed
+        }
+        if (entry.count > 0)
+        {
+            for (std::uint32_t i = entry.offset; i < entry.offset + entry.count; ++i)
+            {
+                hit = intersect_primitive(indices[i], ray) || hit;
+            }
+        }
+        else
+        {
+            push_children(bvh_ray, nodes[entry.offset], ray.t_max, stack, stack_size);
+        }
+    }
+    return hit;
+}
+
+template <typename Intersector>
+bool Bvh4::any_hit(const Ray &ray, Intersector &&intersect_primitive) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const BvhRay bvh_ray(ray);
+    StackEntry stack[max_stack_size];
+    int stack_size = 0;
+    push_children(bvh_ray, nodes[0], ray.t_max, stack, stack_size);
+
+    while (stack_size > 0)
+    {
+        const StackEntry entry = stack[--stack_size];
+        if (entry.count > 0)
+        {
+            for (std::uint32_t i = entry.offset; i < entry.offset + entry.count; ++i)
+            {
+                if (intersect_primitive(indices[i], ray))
+                {
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            push_children(bvh_ray, nodes[entry.offset], ray.t_max, stack, stack_size);
+        }
+    }
+    return false;
+}
+
+#endif // BVH4_HPP_
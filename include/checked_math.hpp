@@ -0,0 +1,57 @@
+// -*- lsst-c++ -*-
+/**
+ * @file checked_math.hpp
+ * @brief Checked/unchecked policy of the vector math (Vec3 division and normalization, Ray::at).
+ *
+ * @details With PATH_TRACING_CHECKED_MATH (the default for Debug builds) a degenerate operation
+ * throws, as it always used to. Otherwise the operation is carried out with plain IEEE
+ * arithmetic (producing infinities or NaNs) and only counted, so the kernels have no
+ * exception path and can be inlined and vectorized.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef CHECKED_MATH_HPP_
+#define CHECKED_MATH_HPP_
+
+#include <cstddef>
+#include <iosfwd>
+
+#ifdef PATH_TRACING_CHECKED_MATH
+constexpr bool checked_math = true; ///< true if degenerate operations throw.
+#else
+constexpr bool checked_math = false; ///< true if degenerate operations throw.
+#endif
+
+/**
+ * @brief Kinds of degenerate operations.
+ */
+enum class DegenerateMath
+{
+    DivisionByZero,      ///< Vec3 divided by zero.
+    ZeroLengthNormalize, ///< Normalization of a zero-length Vec3.
+    NonPositiveRayTime,  ///< Ray::at called with t <= 0.
+    Count                ///< Number of kinds.
+};
+
+/**
+ * @brief Count a degenerate operation (unchecked mode).
+ * @param kind The kind of the operation.
+ */
+void report_degenerate_math(DegenerateMath kind);
+
+/**
+ * @brief Number of degenerate operations counted since the start of the program.
+ * @param kind The kind of the operations.
+ * @return The number of operations.
+ */
+std::size_t degenerate_math_count(DegenerateMath kind);
+
+/**
+ * @brief Print the non-zero counters of degenerate operations.
+ * @param os The output stream.
+ */
+void print_degenerate_math_report(std::ostream &os);
+
+#endif // CHECKED_MATH_HPP_
@@ -0,0 +1,37 @@
+// -*- lsst-c++ -*-
+/**
+ * @file cycle_counter.hpp
+ * @brief Cheap timestamp used to measure the cost of pixels.
+ *
+ * @details On x86 the time-stamp counter (rdtsc) is read; elsewhere the steady clock is used
+ * and the counts are nanoseconds instead of cycles.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef CYCLE_COUNTER_HPP_
+#define CYCLE_COUNTER_HPP_
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/**
+ * @brief Read the cycle counter of the calling core.
+ * @return The number of cycles (nanoseconds where rdtsc is not available) since an arbitrary origin.
+ */
+inline std::uint64_t read_cycle_counter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+#endif // CYCLE_COUNTER_HPP_
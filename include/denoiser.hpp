@@ -0,0 +1,54 @@
+// -*- lsst-c++ -*-
+/**
+ * @file denoiser.hpp
+ * @brief Declaration of the Denoiser class (edge-avoiding à-trous wavelet filter).
+ *
+ * @details Dammertz et al. 2010: successive 5x5 B3-spline passes whose taps are spaced by
+ * 1, 2, 4, ... pixels, each tap weighted by its similarity to the filtered pixel in color,
+ * normal, albedo and depth (the auxiliary buffers of the render). Edges of the guides stop
+ * the blur, so noise is removed within surfaces only. Every pass runs in parallel over tiles.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef DENOISER_HPP_
+#define DENOISER_HPP_
+
+#include "aov.hpp"
+#include "screen.hpp"
+#include "thread_pool.hpp"
+
+struct DenoiseSettings
+{
+    int iterations = 5;         ///< Number of passes (the last one spans 2^(iterations + 1) pixels).
+    double sigma_color = 0.6;   ///< Color tolerance of the first pass (halved at every pass).
+    double sigma_normal = 0.1;  ///< Normal tolerance (difference of unit vectors).
+    double sigma_albedo = 0.1;  ///< Albedo tolerance.
+    double sigma_depth = 0.05;  ///< Depth tolerance, relative to the depth and per pixel of tap spacing.
+};
+
+class Denoiser
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param settings The considered settings.
+     */
+    explicit Denoiser(const DenoiseSettings &settings = DenoiseSettings());
+
+    /**
+     * @brief Denoise the pixels of the screen.
+     * @param screen The considered screen (its pixels are replaced).
+     * @param aovs The auxiliary buffers recorded by the render of the screen.
+     * @param pool threads running the passes.
+     * @throws std::invalid_argument if the auxiliary buffers do not match the screen, or if the screen
+     * has a memory budget (the passes hold whole frames).
+     */
+    void apply(Screen &screen, const AovBuffers &aovs, ThreadPool &pool) const;
+
+private:
+    DenoiseSettings settings; ///< Settings of the filter.
+};
+
+#endif // DENOISER_HPP_
@@ -2,11 +2,14 @@
 #define ELEMENTS_HPP_
 
 #include "vec3.hpp"
+#include "aabb.hpp"
 #include "ray.hpp"
 #include "material.hpp"
 #include "intersection.hpp"
 #include "light.hpp"
 
+class Transform;
+
 class Element
 {
 public:
@@ -28,6 +31,21 @@ public:
      */
     Element(const Material &mat, const Vec3 &c) : material(mat), center(c) {}
 
+    /**
+     * @brief Virtual method to get the bounds of the element (used by the acceleration structures).
+     * @return The axis-aligned bounding box of the element.
+     */
+    virtual Aabb bounds() const = 0;
+
+    /**
+     * @brief Place the element by applying a transformation to its rest pose (the pose it was created with).
+     * @details Used to animate sequences; the default implementation throws.
+     *
+     * @param transform The transformation applied to the rest pose.
+     * @throws std::logic_error if the element cannot be animated.
+     */
+    virtual void set_transform(const Transform &transform);
+
     /**
      * @brief Virtual method to check if a point is inside the element.
      * @param point The point to check.
@@ -49,9 +67,30 @@ public:
      */
     virtual Vec3 get_normal(const Vec3 &point) const = 0;
 
+    /**
+     * @brief Get the normal at an intersection point of the element.
+     * @details Elements made of several sub-primitives (meshes) use the intersection data to avoid
+     * searching the point; the default implementation forwards to get_normal(intersection.point).
+     *
+     * @param intersection An intersection with this element.
+     * @return The normal vector at the intersection point.
+     */
+    virtual Vec3 get_normal(const Intersection &intersection) const { return get_normal(intersection.point); }
+
+    /**
+     * @brief Get the geometric normal (normal of the actual surface) at an intersection point.
+     * @details Differs from get_normal only for elements with interpolated (shading) normals;
+     * secondary rays leave the surface along this normal. The default implementation forwards
+     * to get_normal(intersection).
+     *
+     * @param intersection An intersection with this element.
+     * @return The geometric normal vector at the intersection point.
+     */
+    virtual Vec3 get_geometric_normal(const Intersection &intersection) const { return get_normal(intersection); }
+
     /**
      * @brief Calculate the intersection of a Ray with the Sphere.
-     * @param ray The Ray to test for intersection.
+     * @param ray The Ray to test for intersection (only hits within its interval are considered).
      * @return intersection information (if no intersection is found then intersection.valid = false).
      */
     virtual Intersection intersect(const Ray &ray) const = 0;
@@ -64,16 +103,33 @@ public:
      * @return true if the light is visible from the point, false otherwise.
      */
     virtual bool is_light_visible_from_point(const Light &light, const Vec3 &point) const = 0;
+
+    /**
+     * @brief Tell if the source is visible from an intersection point on the element.
+     * @param light considered light.
+     * @param intersection An intersection with this element.
+     *
+     * @return true if the light is visible from the point, false otherwise.
+     */
+    virtual bool is_light_visible_from_point(const Light &light, const Intersection &intersection) const
+    {
+        return is_light_visible_from_point(light, intersection.point);
+    }
 };
 
 /**
  * @brief Create a sphere object.
  */
-class Sphere : public Element, public std::enable_shared_from_this<Sphere>
+class Sphere final : public Element
 {
 public:
     // Vec3 center;   ///< Center of the sphere.
     double radius; ///< Radius of the sphere.
+    Vec3 rest_center;   ///< Center of the sphere when it was created (see set_transform).
+    double rest_radius; ///< Radius of the sphere when it was created (see set_transform).
+
+    using Element::get_normal;
+    using Element::is_light_visible_from_point;
 
     /**
      * @brief Constructor with center, radius, and basic material properties.
@@ -90,6 +146,18 @@ public:
     // Disable move constructor
     Sphere(Sphere &&) = delete;
 
+    /**
+     * @brief Return the bounds of the Sphere.
+     * @return The axis-aligned bounding box of the Sphere.
+     */
+    Aabb bounds() const override;
+
+    /**
+     * @brief Move the sphere: its rest center is transformed, its rest radius scaled.
+     * @param transform A similarity (rotation, uniform scaling, translation) applied to the rest pose.
+     */
+    void set_transform(const Transform &transform) override;
+
     /**
      * @brief Return if the considered point is within the Sphere.
      * @param point The point to check.
@@ -113,11 +181,22 @@ public:
 
     /**
      * @brief Calculate the intersection of a Ray with the Sphere.
-     * @param ray The Ray to test for intersection.
+     * @param ray The Ray to test for intersection (only hits within its interval are considered).
      * @return intersection information (if no intersection is found then intersection.valid = false).
      */
     Intersection intersect(const Ray &ray) const override;
 
+    /**
+     * @brief Closest-hit kernel used by the scene traversal.
+     * @details Half-b quadratic compared against the ray interval without division. The hit point
+     * is not computed: the caller evaluates it once, for the final closest hit.
+     *
+     * @param ray The considered ray, whose t_max is shrunk to the hit distance on a hit.
+     * @param hit Filled on a hit (t, element, primitive, u, v and valid; the point is left untouched).
+     * @return true if the sphere is hit within the ray interval, false otherwise.
+     */
+    bool intersect_closest(Ray &ray, Intersection &hit) const;
+
     /**
      * @brief Tell if the source is visible from a point on the border of the Element.
      * @param light considered light.
@@ -126,6 +205,45 @@ public:
      * @return true if the light is visible from the point, false otherwise.
      */
     bool is_light_visible_from_point(const Light &light, const Vec3 &point) const override;
+
+private:
+    double radius_squared; ///< Square of the radius (kept in sync by the constructor and set_transform).
 };
 
+// Half-b ray/sphere test: the roots (-h -+ sqrt(h^2 - a c)) / a are compared to the ray interval scaled by a.
+inline bool Sphere::intersect_closest(Ray &ray, Intersection &hit) const
+{
+    const Vec3 oc = ray.source - center;
+    const double a = ray.direction.dot(ray.direction);
+    const double half_b = oc.dot(ray.direction);
+    const double c = oc.dot(oc) - radius_squared;
+    const double discriminant = half_b * half_b - a * c;
+    if (discriminant <= 0)
+    {
+        return false;
+    }
+
+    // Leastest root within the ray interval
+    const double sqrt_discriminant = std::sqrt(discriminant);
+    const double lower = a * ray.t_min;
+    double numerator = -half_b - sqrt_discriminant;
+    if (!(numerator > lower))
+    {
+        numerator = -half_b + sqrt_discriminant;
+    }
+    if (!(numerator > lower && numerator < a * ray.t_max))
+    {
+        return false;
+    }
+
+    ray.t_max = numerator / a;
+    hit.t = ray.t_max;
+    hit.element = this;
+    hit.primitive = 0;
+    hit.u = 0.0;
+    hit.v = 0.0;
+    hit.valid = true;
+    return true;
+}
+
 #endif // ELEMENTS_HPP_
\ No newline at end of file
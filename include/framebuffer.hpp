@@ -0,0 +1,230 @@
+// -*- lsst-c++ -*-
+/**
+ * @file framebuffer.hpp
+ * @brief Declaration of the Framebuffer class (tiled image storage, optionally out-of-core).
+ *
+ * @details The pixels are stored tile by tile (square tiles of tile_size pixels, each one a
+ * whole number of memory pages). When the image fits in the memory budget it lives in an
+ * anonymous mapping; otherwise it is backed by an unlinked temporary file, and every tile the
+ * renderer completes (or a writer goes past) is spilled: its pages are dropped from the
+ * process, the file keeps their content.
+ *
+ * The budget then bounds the pages in flight, whatever the resolution: the renderers go through
+ * the image tile by tile, at most tiles_in_flight() at once, and the writers read the pixels
+ * with read_row, which maps no page. A row-major writer (PPM, PFM) still keeps band_height()
+ * rows of its own output, at least one (up to 16 bytes per pixel of width); the tiled
+ * half-float writer does not. Buffers holding a whole frame (auxiliary buffers, denoiser planes,
+ * preview, reproducibility check) are refused within a budget. The scene is not accounted for.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef FRAMEBUFFER_HPP_
+#define FRAMEBUFFER_HPP_
+
+#include "color.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class Framebuffer
+{
+public:
+    static constexpr int tile_size = 64; ///< Side of the tiles in pixels.
+
+    /**
+     * @brief Constructor: every pixel is black.
+     * @param width, height size of the image in pixels.
+     * @param memory_budget bytes the image may keep in memory (0 for no limit); a larger image is spilled to a file.
+     * @throws std::runtime_error if the storage cannot be created.
+     */
+    Framebuffer(int width, int height, std::size_t memory_budget = 0);
+
+    /**
+     * @brief Copy constructor (same size and budget, new storage).
+     */
+    Framebuffer(const Framebuffer &other);
+
+    /**
+     * @brief Move constructor.
+     */
+    Framebuffer(Framebuffer &&other) noexcept;
+
+    /**
+     * @brief Copy the pixels of another framebuffer (the tiles are not completed any more).
+     */
+    Framebuffer &operator=(const Framebuffer &other);
+
+    /**
+     * @brief Move assignment.
+     */
+    Framebuffer &operator=(Framebuffer &&other) noexcept;
+
+    /**
+     * @brief Destructor: unmaps the storage (and closes the spill file).
+     */
+    ~Framebuffer();
+
+    /**
+     * @brief Width of the image in pixels.
+     */
+    int width() const { return image_width; }
+
+    /**
+     * @brief Height of the image in pixels.
+     */
+    int height() const { return image_height; }
+
+    /**
+     * @brief Bytes the image may keep in memory (0 for no limit).
+     */
+    std::size_t memory_budget() const { return budget; }
+
+    /**
+     * @brief Tell if the image is backed by a spill file (it does not fit in the memory budget).
+     */
+    bool is_spilled() const { return file >= 0; }
+
+    /**
+     * @brief Number of tiles.
+     */
+    std::size_t tile_count() const { return static_cast<std::size_t>(tiles_x) * tiles_y; }
+
+    /**
+     * @brief Number of tiles a renderer may have in flight at once.
+     * @return Every tile when the image is not spilled, otherwise as many as the budget holds (at least one).
+     */
+    std::size_t tiles_in_flight() const;
+
+    /**
+     * @brief Number of rows a row-major writer should go through at a time.
+     * @return A row of tiles when the image is not spilled, otherwise the largest power of two (at
+     * least one row) whose band buffers, up to 16 bytes per pixel, fit in the budget.
+     */
+    int band_height() const;
+
+    /**
+     * @brief Rectangle of pixels of a tile (edge tiles are clipped to the image).
+     * @param tile index of the tile, in row-major order.
+     * @param x, y output: upper-left pixel of the tile.
+     * @param w, h output: size of the tile in pixels.
+     */
+    void tile_rectangle(std::size_t tile, int &x, int &y, int &w, int &h) const;
+
+    /**
+     * @brief Access a pixel (no bounds check).
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     */
+    Color &operator()(int i, int j) { return storage[index(i, j)]; }
+
+    /**
+     * @brief Access a pixel (no bounds check).
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     */
+    const Color &operator()(int i, int j) const { return storage[index(i, j)]; }
+
+    /**
+     * @brief Tell that a rectangle of pixels holds its final color (thread-safe).
+     * @details A tile is spilled once all its pixels are completed; nothing happens when the image
+     * is not spilled. Each pixel must be completed once per render.
+     *
+     * @param x, y upper-left pixel of the rectangle.
+     * @param w, h size of the rectangle in pixels.
+     */
+    void complete(int x, int y, int w, int h);
+
+    /**
+     * @brief Position of a pixel in render order.
+     * @details The render order goes tile by tile (row-major within a tile) when the image is
+     * spilled, so that the tiles are completed one after the other, and row by row otherwise.
+     *
+     * @param pixel index of the pixel in render order.
+     * @param i, j output: position of the pixel.
+     */
+    void render_order_pixel(std::size_t pixel, int &i, int &j) const;
+
+    /**
+     * @brief Number of pixels that can be rendered, in render order, within the tiles in flight.
+     * @param first_pixel index in render order of the next pixel (the pixels before it are completed).
+     * @return Pixels from first_pixel to the end of the tiles_in_flight()-th tile it reaches.
+     */
+    std::size_t render_order_limit(std::size_t first_pixel) const;
+
+    /**
+     * @brief Tell that a range of pixels, in render order, holds its final color (thread-safe).
+     * @param first_pixel index in render order of the first pixel.
+     * @param count number of pixels.
+     */
+    void complete_range(std::size_t first_pixel, std::size_t count);
+
+    /**
+     * @brief Copy pixels of a row (thread-safe).
+     * @details A spilled image is read from its file: unlike operator(), this maps none of its pages
+     * in the process (a read fault would map the neighbouring pages too).
+     *
+     * @param x, j first pixel.
+     * @param count number of pixels.
+     * @param colors output: count colors.
+     * @throws std::runtime_error if the spill file cannot be read.
+     */
+    void read_row(int x, int j, int count, Color *colors) const;
+
+    /**
+     * @brief Spill the pages holding only rows a writer is done with (for code filling the rows in order).
+     * @details The rows must lie in one row of tiles; give every row done with in it (from the top of
+     * the row of tiles to the last row written), the pages shared with other rows are kept. Nothing
+     * happens when the image is not spilled; the pixels stay readable and writable (they are read
+     * back from the file).
+     *
+     * @param begin_row, end_row range of rows done with.
+     */
+    void release_rows(int begin_row, int end_row) const;
+
+private:
+    int image_width;                 ///< Width of the image in pixels.
+    int image_height;                ///< Height of the image in pixels.
+    std::size_t budget;              ///< Bytes the image may keep in memory (0 for no limit).
+    int tiles_x;                     ///< Number of tiles per row.
+    int tiles_y;                     ///< Number of tiles per column.
+    std::size_t tile_stride;         ///< Colors between two tiles (tile_size² rounded up to whole pages).
+    std::size_t storage_size;        ///< Size of the mapping in bytes.
+    Color *storage;                  ///< Mapped pixels.
+    int file;                        ///< Spill file descriptor (-1 when the image lives in memory).
+    std::unique_ptr<std::atomic<std::uint32_t>[]> completed; ///< Completed pixels per tile (spilled images only).
+
+    /**
+     * @brief Position of a pixel in the storage.
+     */
+    std::size_t index(int i, int j) const
+    {
+        const std::size_t tile = static_cast<std::size_t>(j / tile_size) * tiles_x + i / tile_size;
+        return tile * tile_stride + (j % tile_size) * tile_size + i % tile_size;
+    }
+
+    /**
+     * @brief Index in render order of the first pixel of a tile (spilled images only).
+     */
+    std::size_t tile_start(std::size_t tile) const;
+
+    /**
+     * @brief Number of pixels of a tile (edge tiles are clipped to the image).
+     */
+    std::uint32_t tile_area(int tile_x, int tile_y) const;
+
+    /**
+     * @brief Drop the pages of a tile from memory (its content stays in the spill file).
+     */
+    void spill(std::size_t tile) const;
+
+    /**
+     * @brief Release the storage.
+     */
+    void unmap();
+};
+
+#endif // FRAMEBUFFER_HPP_
@@ -0,0 +1,183 @@
+// -*- lsst-c++ -*-
+/**
+ * @file grid.hpp
+ * @brief Declaration of the UniformGrid class (alternative to the Bvh for dense, equal-size primitives).
+ *
+ * @details The grid covers the bounds of the primitives with about `density` cells per primitive.
+ * Its cells are stored in a compact, CSR-like layout: the primitives overlapping cell c are
+ * indices[cell_offsets[c]] to indices[cell_offsets[c + 1] - 1], in increasing order. The build
+ * (stable radix sort of the (cell, primitive) pairs) is linear in the number of primitives, runs on
+ * a ThreadPool and gives the same grid whatever the number of threads. Rays walk the cells they
+ * cross in order with a 3D-DDA (Amanatides and Woo 1987), through the same closest-hit and any-hit
+ * interface as the Bvh.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef GRID_HPP_
+#define GRID_HPP_
+
+#include "aabb.hpp"
+#include "ray.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+class UniformGrid
+{
+public:
+    static constexpr double density = 2.0;       ///< Number of cells per primitive.
+    static constexpr int max_resolution = 1024;  ///< Maximal number of cells along an axis.
+
+    int resolution[3] = {0, 0, 0};           ///< Number of cells along each axis.
+    Aabb box;                                ///< Bounds of the grid.
+    Vec3 cell_size;                          ///< Size of a cell along each axis.
+    std::vector<std::uint32_t> cell_offsets; ///< First entry of every cell in `indices` (one more entry than cells).
+    std::vector<std::uint32_t> indices;      ///< Primitive indices, cell by cell.
+
+    /**
+     * @brief Build the grid over a list of primitive bounds.
+     * @param bounds The bounds of the primitives (primitive i has bounds[i]).
+     * @param pool Threads sharing the build.
+     */
+    void build(const std::vector<Aabb> &bounds, ThreadPool &pool);
+
+    /**
+     * @brief Update the grid after the primitives moved (the grid is simply rebuilt, in linear time).
+     * @param bounds The new bounds of the primitives.
+     * @param pool Threads sharing the build.
+     */
+    void refit(const std::vector<Aabb> &bounds, ThreadPool &pool) { build(bounds, pool); }
+
+    /**
+     * @brief Tell if the grid holds no primitive.
+     * @return true if the grid is empty, false otherwise.
+     */
+    bool empty() const { return indices.empty(); }
+
+    /**
+     * @brief Bounds of the whole grid.
+     * @return The grid bounds (empty box if the grid is empty).
+     */
+    Aabb bounds() const { return empty() ? Aabb() : box; }
+
+    /**
+     * @brief Find the closest primitive hit by the ray.
+     * @param ray The considered ray, whose t_max is shrunk to the closest hit distance.
+     * @param intersect_primitive Callable `bool(std::uint32_t primitive, Ray &ray)`, as for Bvh::closest_hit.
+     *
+     * @return true if a primitive was hit, false otherwise.
+     */
+    template <typename Intersector>
+    bool closest_hit(Ray &ray, Intersector &&intersect_primitive) const;
+
+    /**
+     * @brief Tell if any primitive is hit within the ray interval.
+     * @param ray The considered ray.
+     * @param intersect_primitive Callable `bool(std::uint32_t primitive, const Ray &ray)`, as for Bvh::any_hit.
+     *
+     * @return true if a primitive was hit, false otherwise.
+     */
+    template <typename Intersector>
+    bool any_hit(const Ray &ray, Intersector &&intersect_primitive) const;
+
+private:
+    /**
+     * @brief State of the 3D-DDA walk of a ray through the cells.
+     */
+    struct Walk
+    {
+        int cell[3];      ///< Current cell.
+        int step[3];      ///< Direction of the walk along each axis (-1 or 1).
+        int stop[3];      ///< First cell index outside the grid along each axis.
+        double t_next[3]; ///< Distance at which the ray leaves the current cell along each axis.
+        double t_delta[3]; ///< Distance the ray travels to cross a cell along each axis.
+    };
+
+    /**
+     * @brief Start the walk of a ray.
+     * @param ray The considered ray.
+     * @param walk The walk state (output).
+     * @return false if the ray misses the grid within its interval.
+     */
+    bool start_walk(const Ray &ray, Walk &walk) const;
+
+    /**
+     * @brief Index of a cell in `cell_offsets`.
+     * @param cell Coordinates of the cell along each axis.
+     * @return The index of the cell (x fastest, then y, then z).
+     */
+    std::size_t cell_index(const int cell[3]) const
+    {
+        return static_cast<std::size_t>(cell[0]) + static_cast<std::size_t>(resolution[0]) * (cell[1] + static_cast<std::size_t>(resolution[1]) * cell[2]);
+    }
+
+    /**
+     * @brief Move to the next cell crossed by the ray.
+     * @param walk The walk state.
+     * @param t_exit Distance at which the ray left the previous cell (output).
+     * @return false if the ray left the grid.
+     */
+    static bool advance(Walk &walk, double &t_exit)
+    {
+        int axis = walk.t_next[0] < walk.t_next[1] ? 0 : 1;
+        axis = walk.t_next[2] < walk.t_next[axis] ? 2 : axis;
+        t_exit = walk.t_next[axis];
+        walk.cell[axis] += walk.step[axis];
+        walk.t_next[axis] += walk.t_delta[axis];
+        return walk.cell[axis] != walk.stop[axis];
+    }
+};
+
+template <typename Intersector>
+bool UniformGrid::closest_hit(Ray &ray, Intersector &&intersect_primitive) const
+{
+    Walk walk;
+    if (empty() || !start_walk(ray, walk))
+    {
+        return false;
+    }
+
+    bool hit = false;
+    double t_exit;
+    do
+    {
+        const std::size_t cell = cell_index(walk.cell);
+        for (std::uint32_t i = cell_offsets[cell]; i < cell_offsets[cell + 1]; ++i)
+        {
+            hit = intersect_primitive(indices[i], ray) || hit;
+        }
+        // A hit found before the ray leaves the cell cannot be beaten by the next cells
+    } while (advance(walk, t_exit) && t_exit < ray.t_max);
+    return hit;
+}
+
+template <typename Intersector>
+bool UniformGrid::any_hit(const Ray &ray, Intersector &&intersect_primitive) const
+{
+    Walk walk;
+    if (empty() || !start_walk(ray, walk))
+    {
+        return false;
+    }
+
+    double t_exit;
+    do
+    {
+        const std::size_t cell = cell_index(walk.cell);
+        for (std::uint32_t i = cell_offsets[cell]; i < cell_offsets[cell + 1]; ++i)
+        {
+            if (intersect_primitive(indices[i], ray))
+            {
+                return true;
+            }
+        }
+    } while (advance(walk, t_exit) && t_exit < ray.t_max);
+    return false;
+}
+
+#endif // GRID_HPP_
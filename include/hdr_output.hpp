@@ -0,0 +1,126 @@
+// -*- lsst-c++ -*-
+/**
+ * @file hdr_output.hpp
+ * @brief Declaration of the linear HDR writers (PFM and tiled half-float images), and of the
+ * choice of the output format.
+ *
+ * @details Both formats keep the linear radiance of the screen, without clamping. The
+ * half-float format is laid out like a tiled OpenEXR file:
+ * - header (little-endian): "PTHF", version (u32 = 1), width, height, tile size (i32),
+ *   channels (u32 = 3), compression (u32: 0 none, 1 RLE);
+ * - offset of every tile from the start of the file (u64, tiles in row-major order);
+ * - every tile: for each of its scanlines, the stored size (u32) followed by the scanline,
+ *   made of the R, G then B halves of its pixels. A scanline stored with its raw size is
+ *   not compressed; otherwise it is RLE-compressed like OpenEXR (bytes split into low and
+ *   high halves, delta predictor, then runs).
+ *
+ * load_half_image reads such a file back (Image::load uses it), e.g. to compare it with a PFM
+ * of the same render in image_diff: the values are the PFM ones rounded to halves.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef HDR_OUTPUT_HPP_
+#define HDR_OUTPUT_HPP_
+
+#include "screen.hpp"
+#include "thread_pool.hpp"
+#include "tone_mapping.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Compression of the scanlines of a half-float image.
+ */
+enum class HalfCompression
+{
+    None, ///< Raw halves.
+    Rle   ///< OpenEXR-like run-length encoding (kept only where it saves space).
+};
+
+/**
+ * @brief Convert a float to a half (IEEE 754 binary16, rounded to nearest even).
+ * @param value The considered value (overflows become infinities).
+ * @return The bits of the half.
+ */
+std::uint16_t float_to_half(float value);
+
+/**
+ * @brief Convert a half (IEEE 754 binary16) to a float (exact).
+ * @param half The bits of the half.
+ * @return The value of the half.
+ */
+float half_to_float(std::uint16_t half);
+
+/**
+ * @brief RLE-compress a buffer like OpenEXR (byte split, delta predictor, runs).
+ * @param data The bytes to compress.
+ * @param size Number of bytes.
+ * @param output Compressed bytes (replaced).
+ */
+void rle_compress(const unsigned char *data, std::size_t size, std::vector<unsigned char> &output);
+
+/**
+ * @brief Decompress a buffer compressed by rle_compress.
+ * @param data The compressed bytes.
+ * @param size Number of compressed bytes.
+ * @param raw_size Number of bytes before compression.
+ * @param output Decompressed bytes (replaced).
+ * @throws std::runtime_error if the data does not decompress to raw_size bytes.
+ */
+void rle_decompress(const unsigned char *data, std::size_t size, std::size_t raw_size, std::vector<unsigned char> &output);
+
+/**
+ * @brief Save the screen image as a Portable float map (linear RGB, 32-bit floats).
+ * @param screen The considered screen.
+ * @param filename name (and path) of the created file.
+ * @param pool threads converting the pixels (one row of tiles at a time).
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void save_image_as_pfm(const Screen &screen, const std::string &filename, ThreadPool &pool);
+
+/**
+ * @brief Save planar float buffers as a Portable float map (grayscale for one plane, RGB for three).
+ * @param filename name (and path) of the created file.
+ * @param width, height size of the planes in pixels.
+ * @param planes row-major planes, top row first.
+ * @throws std::invalid_argument if there is neither one nor three planes.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void save_planes_as_pfm(const std::string &filename, int width, int height, const std::vector<const float *> &planes);
+
+/**
+ * @brief Save the screen image as a tiled half-float image (see the file description).
+ * @param screen The considered screen.
+ * @param filename name (and path) of the created file.
+ * @param compression compression of the scanlines.
+ * @param pool threads encoding the tiles (one row of tiles at a time).
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void save_image_as_half(const Screen &screen, const std::string &filename, HalfCompression compression, ThreadPool &pool);
+
+/**
+ * @brief Load a tiled half-float image (see the file description).
+ * @param filename name (and path) of the file.
+ * @return The image, in linear RGB.
+ * @throws std::runtime_error if the file cannot be read or is not a valid half-float image.
+ */
+Image load_half_image(const std::string &filename);
+
+/**
+ * @brief Save the screen image in the format given by the extension of its name.
+ * @details .pfm and .half keep the linear radiance, any other name gives a tone mapped PPM.
+ *
+ * @param screen The considered screen.
+ * @param filename name (and path) of the created file.
+ * @param tone_mapper conversion of the pixels to bytes (PPM only).
+ * @param compression compression of the scanlines (.half only).
+ * @param pool threads encoding the image.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void save_image(Screen &screen, const std::string &filename, const ToneMapper &tone_mapper, HalfCompression compression, ThreadPool &pool);
+
+#endif // HDR_OUTPUT_HPP_
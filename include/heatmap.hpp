@@ -0,0 +1,53 @@
+// -*- lsst-c++ -*-
+/**
+ * @file heatmap.hpp
+ * @brief Declaration of the per-pixel cost outputs (false-colour heatmap and per-tile table).
+ *
+ * @details Both outputs read the Cost channel of the auxiliary buffers, recorded by the
+ * depth-first renderer (cycles spent in Screen::trace_pixel, see cycle_counter.hpp).
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef HEATMAP_HPP_
+#define HEATMAP_HPP_
+
+#include "aov.hpp"
+
+#include <array>
+#include <string>
+
+/**
+ * @brief False colour of a normalised value, shared by the heatmap and the image diff.
+ * @param x The value (clamped to [0, 1]).
+ * @return The colour as bytes: 0 blue, 0.25 cyan, 0.5 green, 0.75 yellow, 1 red.
+ */
+std::array<unsigned char, 3> false_colour(double x);
+
+/**
+ * @brief Save the cost of the pixels as a false-colour binary PPM.
+ * @details Costs are normalised by their 99th percentile (a few very slow pixels would
+ * otherwise flatten the map) and mapped from blue (cheap) through cyan, green and yellow to
+ * red (expensive).
+ *
+ * @param aovs Auxiliary buffers holding the Cost channel.
+ * @param filename Path of the image.
+ * @throws std::invalid_argument if the Cost channel was not recorded.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void save_cost_heatmap(const AovBuffers &aovs, const std::string &filename);
+
+/**
+ * @brief Save the cost of the tiles of the image as a CSV table.
+ * @details One line per tile of Framebuffer::tile_size pixels (row-major order), with the columns
+ * tile_x, tile_y, x, y, width, height, pixels, total_cycles, mean_cycles and max_cycles.
+ *
+ * @param aovs Auxiliary buffers holding the Cost channel.
+ * @param filename Path of the table.
+ * @throws std::invalid_argument if the Cost channel was not recorded.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void save_cost_csv(const AovBuffers &aovs, const std::string &filename);
+
+#endif // HEATMAP_HPP_
@@ -14,6 +14,7 @@
 #define IMAGE_HPP_
 
 #include "color.hpp"
+#include <string>
 #include <vector>
 
 class Image
@@ -21,7 +22,7 @@ class Image
 private:
     int width;                              // Width of the image
     int height;                             // Height of the image
-    std::vector<std::vector<Color>> pixels; // 2D array of Color objects representing the image
+    std::vector<Color> pixels;              // Pixels of the image, row by row
 
 public:
     /**
@@ -33,6 +34,18 @@ public:
      */
     Image(int w, int h);
 
+    /**
+     * @brief Load an image from a Portable pixmap (P3 or P6), a Portable float map (PF or Pf) or a
+     * tiled half-float image (see hdr_output.hpp).
+     * @details Pixmap values are divided by their maximal value (so they lie in [0, 1]); float map
+     * and half-float values are kept as they are, and a grey float map fills the three channels.
+     *
+     * @param filename The name of the file.
+     * @return The image.
+     * @throws std::runtime_error if the file cannot be read or is not a supported image.
+     */
+    static Image load(const std::string &filename);
+
     /**
      * @brief Get the width of the image.
      * @return The width of the image.
@@ -74,6 +87,22 @@ public:
      */
     Color get_pixel(int x, int y) const;
 
+    /**
+     * @brief Access a pixel (no bounds check).
+     * @param x The x-coordinate of the pixel.
+     * @param y The y-coordinate of the pixel.
+     * @return The Color of the pixel at (x, y).
+     */
+    const Color &operator()(int x, int y) const { return pixels[static_cast<std::size_t>(y) * width + x]; }
+
+    /**
+     * @brief Access a pixel (no bounds check).
+     * @param x The x-coordinate of the pixel.
+     * @param y The y-coordinate of the pixel.
+     * @return The Color of the pixel at (x, y).
+     */
+    Color &operator()(int x, int y) { return pixels[static_cast<std::size_t>(y) * width + x]; }
+
     /**
      * @brief Save the image to a file in PPM format.
      * @details This method writes the image data to a file in plain text PPM format (P3).
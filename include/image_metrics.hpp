@@ -0,0 +1,57 @@
+// -*- lsst-c++ -*-
+/**
+ * @file image_metrics.hpp
+ * @brief Declaration of the image comparison metrics (RMSE, PSNR, FLIP-like error, max difference).
+ *
+ * @details Used by the image_diff tool to check that a change of the renderer did not change the
+ * picture. RMSE, PSNR and the maximal difference compare the stored values. The FLIP-like error
+ * is a simplified version of FLIP (Andersson et al. 2020): it compares the images as displayed
+ * (channels clamped to [0, 1] and read as sRGB), in CIELAB, after a Gaussian blur standing for
+ * the contrast sensitivity of the eye (wider for the chrominance), with the HyAB colour distance,
+ * and raises the colour error to a power that decreases where the edges of the images differ.
+ * It does not reproduce the FLIP filters exactly: use it to compare renders with each other, not
+ * with values published for FLIP.
+ *
+ * Every metric is computed row by row on a ThreadPool, and the per-row sums are added in row
+ * order, so the results do not depend on the number of threads.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef IMAGE_METRICS_HPP_
+#define IMAGE_METRICS_HPP_
+
+#include "image.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <limits>
+
+/**
+ * @brief Differences between a reference image and a test image.
+ */
+struct ImageDifference
+{
+    double rmse = 0.0;                ///< Root mean square difference over every channel.
+    double psnr = std::numeric_limits<double>::infinity(); ///< Peak signal-to-noise ratio in dB (peak value 1, infinite for equal images).
+    double flip = 0.0;                ///< Mean FLIP-like error, in [0, 1].
+    double max_flip = 0.0;            ///< Largest FLIP-like error of a pixel.
+    double max_abs_difference = 0.0;  ///< Largest absolute difference of a channel.
+    std::size_t differing_pixels = 0; ///< Number of pixels with at least one different channel.
+};
+
+/**
+ * @brief Compare two images.
+ * @param reference The reference image.
+ * @param test The compared image (same size).
+ * @param pool Threads sharing the comparison.
+ * @param error_map If not nullptr, receives the FLIP-like error of every pixel in false colour
+ * (blue for no error, red for the largest one, see false_colour).
+ *
+ * @return The differences of both images.
+ * @throws std::invalid_argument if the images do not have the same size.
+ */
+ImageDifference compare_images(const Image &reference, const Image &test, ThreadPool &pool, Image *error_map = nullptr);
+
+#endif // IMAGE_METRICS_HPP_
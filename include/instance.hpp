@@ -0,0 +1,136 @@
+// -*- lsst-c++ -*-
+/**
+ * @file instance.hpp
+ * @brief Declaration of the Instance class (transformed copy of a shared mesh).
+ *
+ * @details An Instance references a TriangleMesh and its Bvh (the bottom-level structure)
+ * and places it in the world with a Transform. Rays are moved into object space to
+ * traverse the mesh, so any number of instances share one copy of the geometry; the
+ * scene builds its top-level structure over the instance bounds.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef INSTANCE_HPP_
+#define INSTANCE_HPP_
+
+#include "elements.hpp"
+#include "mesh.hpp"
+#include "transform.hpp"
+
+#include <memory>
+
+class Instance final : public Element
+{
+public:
+    std::shared_ptr<const TriangleMesh> mesh; ///< Instanced geometry (bottom-level structure), shared between instances.
+    Transform object_to_world;                ///< Placement of the mesh in the world.
+    Transform rest_transform;                 ///< Placement of the mesh when the instance was created (see set_transform).
+
+    using Element::get_normal;
+    using Element::is_light_visible_from_point;
+
+    /**
+     * @brief Constructor with mesh, transformation and material.
+     * @param mesh The instanced mesh (its own material is ignored).
+     * @param transform Placement of the mesh in the world.
+     * @param mat The material of the instance.
+     */
+    Instance(std::shared_ptr<const TriangleMesh> mesh, const Transform &transform, const Material &mat);
+
+    /**
+     * @brief Constructor using the material of the mesh.
+     * @param mesh The instanced mesh.
+     * @param transform Placement of the mesh in the world.
+     */
+    Instance(std::shared_ptr<const TriangleMesh> mesh, const Transform &transform);
+
+    // Disable copy constructor
+    Instance(const Instance &) = delete;
+
+    // Disable move constructor
+    Instance(Instance &&) = delete;
+
+    /**
+     * @brief Move the instance: object_to_world = transform * rest_transform.
+     * @param transform The transformation applied to the rest pose.
+     */
+    void set_transform(const Transform &transform) override;
+
+    /**
+     * @brief Bounds of the transformed mesh.
+     * @return The instance bounds in world space.
+     */
+    Aabb bounds() const override;
+
+    /**
+     * @brief Return if the considered point is inside the transformed mesh.
+     * @param point The point to check.
+     * @return true if the point lies within the instance, false otherwise.
+     */
+    bool contains(const Vec3 &point) const override;
+
+    /**
+     * @brief Return if the considered point lies on the transformed mesh.
+     * @param point The point to check.
+     * @return true if the point is on the instance border, false otherwise.
+     */
+    bool is_on_border(const Vec3 &point) const override;
+
+    /**
+     * @brief Return the world-space normal at a point of the instance (slow, see TriangleMesh).
+     * @param point The point at which to calculate the normal.
+     * @return The normal vector at the given point.
+     */
+    Vec3 get_normal(const Vec3 &point) const override;
+
+    /**
+     * @brief Return the world-space normal at an intersection.
+     * @param intersection An intersection with this instance.
+     * @return The normal vector at the intersection point.
+     */
+    Vec3 get_normal(const Intersection &intersection) const override;
+
+    /**
+     * @brief Return the world-space normal of the intersected triangle (never interpolated).
+     * @param intersection An intersection with this instance.
+     * @return The geometric normal at the intersection point.
+     */
+    Vec3 get_geometric_normal(const Intersection &intersection) const override;
+
+    /**
+     * @brief Calculate the closest intersection of a (world-space) Ray with the instance.
+     * @param ray The Ray to test for intersection (only hits within its interval are considered).
+     * @return intersection information (if no intersection is found then intersection.valid = false).
+     */
+    Intersection intersect(const Ray &ray) const override;
+
+    /**
+     * @brief Closest-hit kernel used by the scene traversal (the hit point is not computed).
+     * @param ray The considered (world-space) ray, whose t_max is shrunk to the hit distance on a hit.
+     * @param hit Filled on a hit (t, element, primitive, u, v and valid; the point is left untouched).
+     * @return true if the instance is hit within the ray interval, false otherwise.
+     */
+    bool intersect_closest(Ray &ray, Intersection &hit) const;
+
+    /**
+     * @brief Tell if the source is visible from a point on the instance.
+     * @param light considered light.
+     * @param point considered point.
+     *
+     * @return true if the light is visible from the point, false otherwise.
+     */
+    bool is_light_visible_from_point(const Light &light, const Vec3 &point) const override;
+
+    /**
+     * @brief Tell if the source is visible from an intersection point on the instance.
+     * @param light considered light.
+     * @param intersection An intersection with this instance.
+     *
+     * @return true if the light is visible from the point, false otherwise.
+     */
+    bool is_light_visible_from_point(const Light &light, const Intersection &intersection) const override;
+};
+
+#endif // INSTANCE_HPP_
@@ -2,13 +2,12 @@
 #define INTERSECTION_HPP_
 
 #include "vec3.hpp"
-#include "elements.hpp"
+
+#include <cstdint>
 
 // Forward declaration of the Element class
 class Element;
 
-#include <memory>
-
 /**
  * @brief Struct to hold intersection information between a Ray and an Element.
  */
@@ -16,20 +15,26 @@ struct Intersection
 {
     Vec3 point;                             ///< The point of intersection.
     double t;                               ///< The "time" or distance along the ray to the intersection point.
-    std::shared_ptr<const Element> element; ///< The element of the intersection (const to prevent modification).
+    const Element *element;                 ///< The element of the intersection (owned by the scene, const to prevent modification).
+    int type;                               ///< Index of the element type in the scene PrimitiveSet.
+    std::uint32_t primitive;                ///< Index of the sub-primitive hit (triangle of a mesh, 0 otherwise).
+    double u;                               ///< First barycentric coordinate of the hit on the sub-primitive.
+    double v;                               ///< Second barycentric coordinate of the hit on the sub-primitive.
     bool valid;                             ///< True if the intersection is valid, false otherwise.
+    std::uint32_t element_index;            ///< Index of the element in Scene::elements (set by the scene queries only).
 
     /**
      * @brief Default constructor for Intersection.
      */
-    Intersection() : point(Vec3()), t(0.0), element(nullptr), valid(false) {}
+    Intersection() : point(Vec3()), t(0.0), element(nullptr), type(0), primitive(0), u(0.0), v(0.0), valid(false), element_index(0) {}
 
     /**
      * @brief Constructor for Intersection with given point and time.
      * @param p The point of intersection.
      * @param time The distance along the ray to the intersection point.
+     * @param elem The intersected element.
      */
-    Intersection(const Vec3 &p, double time, std::shared_ptr<const Element> elem) : point(p), t(time), element(elem), valid(true) {}
+    Intersection(const Vec3 &p, double time, const Element *elem) : point(p), t(time), element(elem), type(0), primitive(0), u(0.0), v(0.0), valid(true), element_index(0) {}
 };
 
 #endif // INTERSECTION_HPP_
\ No newline at end of file
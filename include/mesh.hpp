@@ -0,0 +1,217 @@
+// -*- lsst-c++ -*-
+/**
+ * @file mesh.hpp
+ * @brief Declaration of the TriangleMesh class.
+ *
+ * @details A TriangleMesh is a single scene element made of indexed triangles: the vertices
+ * (and optional per-vertex normals) are stored once and shared by the triangles through a
+ * compact index buffer. The triangles are organised in a Bvh owned by the mesh, so a mesh
+ * of any size is one Element of the scene.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef MESH_HPP_
+#define MESH_HPP_
+
+#include "elements.hpp"
+#include "aabb.hpp"
+#include "bvh.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TriangleMesh final : public Element
+{
+public:
+    using Triangle = std::array<std::uint32_t, 3>; ///< Indices of the three vertices of a triangle.
+
+    std::vector<Vec3> vertices;     ///< Vertex positions.
+    std::vector<Vec3> normals;      ///< Per-vertex normals (empty for flat shading).
+    std::vector<Triangle> indices;  ///< Index buffer (counter-clockwise triangles seen from outside).
+    Bvh bvh;                        ///< Hierarchy over the triangles.
+
+    using Element::get_normal;
+    using Element::is_light_visible_from_point;
+
+    /**
+     * @brief Constructor from vertex and index buffers.
+     * @details Builds the triangle hierarchy.
+     *
+     * @param vertices Vertex positions.
+     * @param indices Index buffer.
+     * @param mat The material of the mesh.
+     * @param normals Per-vertex normals (optional, must match the vertices otherwise).
+     * @throws std::invalid_argument if there is no triangle, or if an index or the normal buffer size is invalid.
+     */
+    TriangleMesh(std::vector<Vec3> vertices, std::vector<Triangle> indices, const Material &mat, std::vector<Vec3> normals = {});
+
+    // Disable copy constructor
+    TriangleMesh(const TriangleMesh &) = delete;
+
+    // Disable move constructor
+    TriangleMesh(TriangleMesh &&) = delete;
+
+    /**
+     * @brief Load a mesh from a Wavefront OBJ file.
+     * @details Only vertex positions and faces are read (polygons are fan-triangulated).
+     *
+     * @param filename name (and path) of the OBJ file.
+     * @param mat The material of the mesh.
+     * @param smooth true to compute area-weighted vertex normals, false for flat shading.
+     * @throws std::runtime_error if the file cannot be read or is malformed.
+     * @throws std::invalid_argument if the file has no face.
+     * @return The loaded mesh.
+     */
+    static std::shared_ptr<TriangleMesh> load_obj(const std::string &filename, const Material &mat, bool smooth = false);
+
+    /**
+     * @brief Number of triangles of the mesh.
+     * @return The number of triangles.
+     */
+    std::size_t triangle_count() const { return indices.size(); }
+
+    /**
+     * @brief Bounds of a triangle.
+     * @param triangle Index of the triangle.
+     * @return The triangle bounds.
+     */
+    Aabb triangle_bounds(std::uint32_t triangle) const;
+
+    /**
+     * @brief Bounds of the whole mesh.
+     * @return The mesh bounds.
+     */
+    Aabb bounds() const override;
+
+    /**
+     * @brief Geometric (unit) normal of a triangle, given by its winding.
+     * @param triangle Index of the triangle.
+     * @return The geometric normal.
+     */
+    Vec3 triangle_normal(std::uint32_t triangle) const;
+
+    /**
+     * @brief Return if the considered point is inside the (closed) mesh.
+     * @details Counts the triangles crossed by a ray leaving the point (linear in the triangle count).
+     *
+     * @param point The point to check.
+     * @return true if the point lies within the mesh, false otherwise.
+     */
+    bool contains(const Vec3 &point) const override;
+
+    /**
+     * @brief Return if the considered point lies on a triangle of the mesh.
+     * @details Linear in the triangle count: the render loop uses the intersection data instead.
+     *
+     * @param point The point to check.
+     * @return true if the point is on the mesh border, false otherwise.
+     */
+    bool is_on_border(const Vec3 &point) const override;
+
+    /**
+     * @brief Return the normal of the triangle containing the point.
+     * @details Linear in the triangle count: the render loop uses get_normal(intersection) instead.
+     *
+     * @param point The point at which to calculate the normal (should be on the mesh).
+     * @return The normal vector at the given point.
+     */
+    Vec3 get_normal(const Vec3 &point) const override;
+
+    /**
+     * @brief Return the (interpolated if the mesh has vertex normals) normal at an intersection.
+     * @param intersection An intersection with this mesh.
+     * @return The normal vector at the intersection point.
+     */
+    Vec3 get_normal(const Intersection &intersection) const override;
+
+    /**
+     * @brief Return the normal of the intersected triangle (never interpolated).
+     * @param intersection An intersection with this mesh.
+     * @return The geometric normal of the triangle.
+     */
+    Vec3 get_geometric_normal(const Intersection &intersection) const override;
+
+    /**
+     * @brief Calculate the closest intersection of a Ray with the triangles of the mesh.
+     * @param ray The Ray to test for intersection (only hits within its interval are considered).
+     * @return intersection information (if no intersection is found then intersection.valid = false).
+     */
+    Intersection intersect(const Ray &ray) const override;
+
+    /**
+     * @brief Closest-hit kernel used by the scene traversal (the hit point is not computed).
+     * @param ray The considered ray, whose t_max is shrunk to the hit distance on a hit.
+     * @param hit Filled on a hit (t, element, primitive, u, v and valid; the point is left untouched).
+     * @return true if a triangle is hit within the ray interval, false otherwise.
+     */
+    bool intersect_closest(Ray &ray, Intersection &hit) const;
+
+    /**
+     * @brief Tell if the source is visible from a point on the mesh.
+     * @param light considered light.
+     * @param point considered point.
+     *
+     * @return true if the light is visible from the point, false otherwise.
+     */
+    bool is_light_visible_from_point(const Light &light, const Vec3 &point) const override;
+
+    /**
+     * @brief Tell if the source is visible from an intersection point on the mesh.
+     * @param light considered light.
+     * @param intersection An intersection with this mesh.
+     *
+     * @return true if the light is visible from the point, false otherwise.
+     */
+    bool is_light_visible_from_point(const Light &light, const Intersection &intersection) const override;
+
+private:
+    Aabb mesh_bounds; ///< Bounds of the vertices (computed once).
+
+    /**
+     * @brief Index of the triangle containing the point (linear search).
+     * @return The triangle index, or triangle_count() if the point is not on the mesh.
+     */
+    std::uint32_t find_triangle(const Vec3 &point) const;
+};
+
+/**
+ * @brief Ray data precomputed once per mesh traversal for the watertight triangle test.
+ * @details Implements the shear/scale transformation of Woop, Benthin and Wald,
+ * "Watertight Ray/Triangle Intersection" (JCGT 2013): rays hitting a shared edge or
+ * vertex always hit one of the adjacent triangles.
+ */
+struct WatertightRay
+{
+    Vec3 origin; ///< Origin of the ray.
+    int kx;      ///< Permuted x axis.
+    int ky;      ///< Permuted y axis.
+    int kz;      ///< Axis along which the direction is the largest.
+    double sx;   ///< Shear along x.
+    double sy;   ///< Shear along y.
+    double sz;   ///< Scale along z.
+
+    /**
+     * @brief Constructor from a ray.
+     * @param ray The considered ray.
+     */
+    explicit WatertightRay(const Ray &ray);
+
+    /**
+     * @brief Intersect a triangle.
+     * @param a, b, c The triangle vertices.
+     * @param t_min, t_max Only hits in ]t_min, t_max[ are reported.
+     * @param t Distance of the hit (output).
+     * @param u Barycentric weight of a (output).
+     * @param v Barycentric weight of b (output).
+     *
+     * @return true if the triangle is hit, false otherwise.
+     */
+    bool intersect(const Vec3 &a, const Vec3 &b, const Vec3 &c, double t_min, double t_max, double &t, double &u, double &v) const;
+};
+
+#endif // MESH_HPP_
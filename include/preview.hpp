@@ -0,0 +1,102 @@
+// -*- lsst-c++ -*-
+/**
+ * @file preview.hpp
+ * @brief Declaration of the PreviewRenderer class (progressive render into a memory-mapped image).
+ *
+ * @details The preview renderer traces the screen in passes of decreasing pixel spacing
+ * (1/8, 1/4, 1/2 then full resolution). Each traced pixel paints the whole block it stands for,
+ * so a complete low-resolution image is available after the first pass, and the pixels of the
+ * coarser passes are reused: every pixel is traced exactly once. The image is written into a
+ * memory-mapped binary PPM file that an image viewer can reload while the render progresses.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef PREVIEW_HPP_
+#define PREVIEW_HPP_
+
+#include "color.hpp"
+#include "screen.hpp"
+#include "scene.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Binary (P6) Portable pixmap file mapped in memory.
+ */
+class MappedPpm
+{
+public:
+    const int width;  ///< Width of the image in pixels.
+    const int height; ///< Height of the image in pixels.
+
+    /**
+     * @brief Create (or overwrite) the file and map it.
+     * @param filename name (and path) of the file.
+     * @param width, height size of the image in pixels.
+     * @throws std::runtime_error if the file cannot be created or mapped.
+     */
+    MappedPpm(const std::string &filename, int width, int height);
+
+    /**
+     * @brief Destructor: unmaps and closes the file.
+     */
+    ~MappedPpm();
+
+    // delete the affectation operator and copy constructor.
+    MappedPpm(const MappedPpm &) = delete;
+
+    MappedPpm &operator=(const MappedPpm &) = delete;
+
+    /**
+     * @brief Paint a square block of pixels (clipped to the image).
+     * @param i, j upper-left pixel of the block.
+     * @param size side of the block in pixels.
+     * @param color color of the block (components in [0, 1]).
+     */
+    void fill(int i, int j, int size, const Color &color);
+
+    /**
+     * @brief Schedule the write-back of the mapping (readers of the file see the current image).
+     */
+    void flush();
+
+private:
+    int file;                  ///< File descriptor.
+    unsigned char *mapping;    ///< Mapped file.
+    std::size_t mapping_size;  ///< Size of the file in bytes.
+    std::size_t header_size;   ///< Size of the PPM header in bytes.
+};
+
+class PreviewRenderer
+{
+public:
+    static constexpr int coarsest_step = 8; ///< Pixel spacing of the first pass.
+
+    /**
+     * @brief Constructor.
+     * @param filename name (and path) of the memory-mapped preview image.
+     */
+    explicit PreviewRenderer(const std::string &filename);
+
+    /**
+     * @brief Color the screen progressively, updating the preview image after every pass.
+     * @details Produces the same screen pixels as the depth-first Screen::render_scene.
+     *
+     * @param screen considered screen.
+     * @param scene considered scene (its acceleration structures must be built).
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param pool threads running the passes.
+     * @throws std::runtime_error if the preview image cannot be created.
+     */
+    void render(Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit, ThreadPool &pool);
+
+private:
+    std::string filename; ///< Name of the preview image.
+};
+
+#endif // PREVIEW_HPP_
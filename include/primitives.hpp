@@ -0,0 +1,168 @@
+// -*- lsst-c++ -*-
+/**
+ * @file primitives.hpp
+ * @brief Declaration of the PrimitiveSet class template.
+ *
+ * @details A PrimitiveSet keeps one array per concrete primitive type (Sphere, ...) so that
+ * the intersection and shading kernels are instantiated for each type at compile time
+ * instead of going through the virtual Element interface. Next to each primitive, the set keeps
+ * the index given when it was added (its index in the scene), so a hit resolves it without a
+ * lookup.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef PRIMITIVES_HPP_
+#define PRIMITIVES_HPP_
+
+#include "elements.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename... Types>
+class PrimitiveSet
+{
+public:
+    static constexpr std::size_t type_count = sizeof...(Types); ///< Number of primitive types.
+
+    /**
+     * @brief Index of a primitive type in the set.
+     * @tparam T Considered primitive type.
+     *
+     * @return The index of T, or type_count if T does not belong to the set.
+     */
+    template <typename T>
+    static constexpr std::size_t type_index()
+    {
+        constexpr bool matches[] = {std::is_same<T, Types>::value...};
+        for (std::size_t i = 0; i < sizeof...(Types); ++i)
+        {
+            if (matches[i])
+            {
+                return i;
+            }
+        }
+        return sizeof...(Types);
+    }
+
+    /**
+     * @brief Add a primitive whose type is known at compile time.
+     * @param primitive Considered primitive (not owned).
+     * @param index Index of the primitive in its owner (e.g. Scene::elements).
+     */
+    template <typename T>
+    void add(const T *primitive, std::uint32_t index)
+    {
+        static_assert(type_index<T>() < type_count, "T is not a primitive type of this set");
+        std::get<std::vector<const T *>>(arrays).push_back(primitive);
+        indices[type_index<T>()].push_back(index);
+    }
+
+    /**
+     * @brief Add an element by resolving its dynamic type.
+     * @param element Considered element (not owned).
+     * @param index Index of the element in its owner (e.g. Scene::elements).
+     *
+     * @return true if the element type belongs to the set, false otherwise.
+     */
+    bool add_element(const Element *element, std::uint32_t index)
+    {
+        return (try_add<Types>(element, index) || ...);
+    }
+
+    /**
+     * @brief Get the array holding the primitives of type T.
+     * @return The primitives of type T.
+     */
+    template <typename T>
+    const std::vector<const T *> &get() const
+    {
+        return std::get<std::vector<const T *>>(arrays);
+    }
+
+    /**
+     * @brief Get the indices given to the primitives of a type, in the order of their array.
+     * @param type Index of the primitive type in the set.
+     * @return The index of every primitive of the type.
+     */
+    const std::vector<std::uint32_t> &get_indices(std::size_t type) const
+    {
+        return indices[type];
+    }
+
+    /**
+     * @brief Remove every primitive from the set.
+     */
+    void clear()
+    {
+        std::apply([](auto &...array)
+                   { (array.clear(), ...); },
+                   arrays);
+        for (auto &type_indices : indices)
+        {
+            type_indices.clear();
+        }
+    }
+
+    /**
+     * @brief Call function(std::integral_constant<std::size_t, I>, const std::vector<const T_I *> &) for each type.
+     * @param function Considered function (typically a generic lambda).
+     */
+    template <typename Function>
+    void for_each_type(Function &&function) const
+    {
+        for_each_type_impl(function, std::index_sequence_for<Types...>{});
+    }
+
+    /**
+     * @brief Call function(const T *) on an element whose type index is known.
+     * @param type Index of the element type in the set.
+     * @param element Considered element (must be of the type designated by `type`).
+     * @param function Considered function (typically a generic lambda).
+     *
+     * @return The value returned by the function.
+     */
+    template <std::size_t I = 0, typename Function>
+    static decltype(auto) visit(std::size_t type, const Element *element, Function &&function)
+    {
+        using T = std::tuple_element_t<I, std::tuple<Types...>>;
+        if constexpr (I + 1 < sizeof...(Types))
+        {
+            if (type != I)
+            {
+                return visit<I + 1>(type, element, std::forward<Function>(function));
+            }
+        }
+        return function(static_cast<const T *>(element));
+    }
+
+private:
+    std::tuple<std::vector<const Types *>...> arrays; ///< One array per primitive type.
+    std::array<std::vector<std::uint32_t>, sizeof...(Types)> indices; ///< Index given to each primitive, parallel to `arrays`.
+
+    template <typename T>
+    bool try_add(const Element *element, std::uint32_t index)
+    {
+        if (const T *primitive = dynamic_cast<const T *>(element))
+        {
+            add(primitive, index);
+            return true;
+        }
+        return false;
+    }
+
+    template <typename Function, std::size_t... I>
+    void for_each_type_impl(Function &function, std::index_sequence<I...>) const
+    {
+        (function(std::integral_constant<std::size_t, I>{}, std::get<I>(arrays)), ...);
+    }
+};
+
+#endif // PRIMITIVES_HPP_
@@ -0,0 +1,82 @@
+// -*- lsst-c++ -*-
+/**
+ * @file radix_sort.hpp
+ * @brief Declaration of a parallel, stable radix sort of 64-bit keys.
+ *
+ * @details Used by the acceleration structure builders, which sort (key, primitive) pairs packed
+ * in 64-bit integers: the key in the high half, the primitive index in the low half. The keys
+ * are often Morton codes, which interleave the bits of three coordinates (see spread_bits).
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef RADIX_SORT_HPP_
+#define RADIX_SORT_HPP_
+
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Scratch memory of radix_sort, kept by callers that sort repeatedly without allocating.
+ */
+struct RadixSortBuffers
+{
+    std::vector<std::uint64_t> values;     ///< Destination of every other pass.
+    std::vector<std::size_t> histograms;   ///< Digit counts, then cursors, of every chunk.
+
+    /**
+     * @brief Reserve the memory of a sort, so that sorting up to count values does not allocate.
+     * @details The values passed to radix_sort must be reserved to the same count: both vectors
+     * are swapped after every pass.
+     *
+     * @param count The largest number of values to sort.
+     */
+    void reserve(std::size_t count);
+};
+
+/**
+ * @brief Spread the 10 low bits of a value to every third bit.
+ * @details The Morton code of a point of a 1024³ grid is
+ * `spread_bits(x) << 2 | spread_bits(y) << 1 | spread_bits(z)`.
+ *
+ * @param value The value (bits above the 10th are ignored).
+ * @return The spread bits.
+ */
+inline std::uint32_t spread_bits(std::uint32_t value)
+{
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+/**
+ * @brief Sort integers on a range of their bits (least significant digit first, 8 bits per pass).
+ * @details The sort is stable: values with equal sort bits keep their order. The result does not
+ * depend on the number of threads of the pool.
+ *
+ * @param values The values to sort.
+ * @param first_bit Lowest bit of the sort key.
+ * @param bit_count Number of bits of the sort key (bits above first_bit + bit_count are ignored).
+ * @param pool Threads sharing the sort.
+ */
+void radix_sort(std::vector<std::uint64_t> &values, int first_bit, int bit_count, ThreadPool &pool);
+
+/**
+ * @brief Sort integers on a range of their bits, with caller-owned scratch memory (see radix_sort above).
+ * @details Once the buffers (and `values`) have grown to the largest sort, no memory is allocated.
+ *
+ * @param values The values to sort.
+ * @param first_bit Lowest bit of the sort key.
+ * @param bit_count Number of bits of the sort key.
+ * @param pool Threads sharing the sort.
+ * @param buffers Scratch memory (its content is overwritten).
+ */
+void radix_sort(std::vector<std::uint64_t> &values, int first_bit, int bit_count, ThreadPool &pool, RadixSortBuffers &buffers);
+
+#endif // RADIX_SORT_HPP_
@@ -14,16 +14,20 @@
 
 #include "vec3.hpp"
 
+#include <limits>
+
 class Ray
 {
 
 public:
-    const Vec3 source;    // source (S) of the ray
-    const Vec3 direction; // direction (u) of the ray
+    Vec3 source;    // source (S) of the ray
+    Vec3 direction; // direction (u) of the ray
+    double t_min;   // only hits with t in ]t_min, t_max[ are considered
+    double t_max;   // (t_max is infinite for an unbounded ray, closest-hit queries shrink it)
 
     /**
      * @brief Default constructor.
-     * @details Initializes the ray with source = (0,0,0) and direction = (0,0,0).
+     * @details Initializes the ray with source = (0,0,0), direction = (0,0,0) and the interval ]0, +inf[.
      */
     Ray();
 
@@ -31,17 +35,31 @@ public:
      * @brief Constructor with source and direction.
      * @param source of the ray.
      * @param direction of the ray.
+     * @param t_min lower bound of the ray interval.
+     * @param t_max upper bound of the ray interval.
      */
-    Ray(const Vec3 &source, const Vec3 &direction);
+    Ray(const Vec3 &source, const Vec3 &direction, double t_min = 0.0, double t_max = std::numeric_limits<double>::infinity());
 
     /**
      * @brief Get the point M(t) = S + t * u of the ray.
      * @param t 'time' of propagation of the ray (must be positive).
+     * @throws std::invalid_argument if t <= 0 and the math is checked (otherwise the call is counted).
      * @return Vec3 the considered point.
      */
-    Vec3 at(float t) const;
+    Vec3 at(double t) const;
 };
 
 Ray create_ray_from_points(const Vec3 &A, const Vec3 &B);
 
+/**
+ * @brief Move a point off a surface so that a ray leaving it does not hit the surface again.
+ * @details The point is pushed along the normal by a distance relative to its magnitude, larger
+ * than the rounding error of a computed hit point.
+ *
+ * @param point Point on the surface.
+ * @param normal Unit normal of the surface, on the side the ray leaves to.
+ * @return The offset point.
+ */
+Vec3 offset_ray_origin(const Vec3 &point, const Vec3 &normal);
+
 #endif // RAY_HPP_
\ No newline at end of file
@@ -0,0 +1,42 @@
+// -*- lsst-c++ -*-
+/**
+ * @file render_settings.hpp
+ * @brief Declaration of the RenderSettings struct (options of Screen::render_scene).
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef RENDER_SETTINGS_HPP_
+#define RENDER_SETTINGS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Execution strategy of the renderer.
+ */
+enum class RenderMode
+{
+    DepthFirst, ///< Each pixel is traced to completion before the next one (rows are spread over the threads).
+    Wavefront,  ///< Pixels are processed in batches, one stage (generate, extend, shade, shadow) at a time.
+    Preview,    ///< Progressive passes from 1/8 to full resolution, written to a memory-mapped image.
+    Distributed ///< Tiles are handed out to worker processes and composited by the calling process.
+};
+
+struct RenderSettings
+{
+    RenderMode mode = RenderMode::DepthFirst;   ///< Execution strategy.
+    unsigned threads = 0;                       ///< Number of render threads (0 means one per hardware thread).
+    std::size_t wavefront_batch_size = 1 << 16; ///< Number of pixels in flight per wavefront batch.
+    bool wavefront_ray_sort = true;             ///< Sort the shadow rays of each wavefront batch (octant, then origin Morton code) before tracing them.
+    std::string preview_file = "../output/preview.ppm"; ///< Memory-mapped image updated by the preview mode.
+    unsigned processes = 0;                     ///< Number of worker processes of the distributed mode (0 means one per hardware thread).
+    int tile_size = 64;                         ///< Side of the tiles of the distributed mode, in pixels.
+    unsigned aovs = 0;                          ///< Auxiliary buffers to record in Screen::aovs (AovBuffers::Channel flags, depth-first and wavefront modes).
+    int samples_per_pixel = 1;                  ///< Jittered samples per pixel (1 traces the pixel center; more in the depth-first and distributed modes).
+    std::uint64_t seed = 0;                     ///< Seed of the pixel samples (the image only depends on it, not on the threads).
+};
+
+#endif // RENDER_SETTINGS_HPP_
@@ -0,0 +1,80 @@
+// -*- lsst-c++ -*-
+/**
+ * @file reproducibility.hpp
+ * @brief Declaration of the reproducibility check (same image whatever the number of threads).
+ *
+ * @details The check renders the scene twice from the same background, with two thread counts
+ * (and as many worker processes in the distributed mode), and compares the images bit by bit.
+ * Renders are expected to be identical: every pixel is computed by a single thread, from
+ * counter-based sample streams, with a fixed summation order. A difference points to state
+ * shared between pixels (e.g. a race) and is reported with its pixel.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef REPRODUCIBILITY_HPP_
+#define REPRODUCIBILITY_HPP_
+
+#include "screen.hpp"
+#include "scene.hpp"
+#include "render_settings.hpp"
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief Pixel whose color differs between the two renders.
+ */
+struct PixelMismatch
+{
+    int i;        ///< x-axis index of the pixel.
+    int j;        ///< y-axis index of the pixel.
+    Color first;  ///< Color of the first render.
+    Color second; ///< Color of the second render.
+};
+
+/**
+ * @brief Result of verify_reproducibility.
+ */
+struct ReproducibilityReport
+{
+    unsigned first_threads = 0;         ///< Threads (or worker processes) of the first render.
+    unsigned second_threads = 0;        ///< Threads (or worker processes) of the second render.
+    std::size_t differing_pixels = 0;   ///< Number of pixels whose color differs.
+    std::vector<PixelMismatch> mismatches; ///< First differing pixels, in row-major order.
+
+    /**
+     * @brief Tell if both renders are identical.
+     * @return true if no pixel differs, false otherwise.
+     */
+    bool reproducible() const { return differing_pixels == 0; }
+};
+
+/**
+ * @brief Render the scene twice with different thread counts and compare the images.
+ * @details The first render uses settings.threads (settings.processes in the distributed mode),
+ * the second one other_threads. The screen keeps the second image.
+ *
+ * @param screen considered screen (its current pixels are the background of both renders).
+ * @param scene considered scene.
+ * @param camera_position position of the camera.
+ * @param max_hit number of reflexions allowed.
+ * @param settings execution options of the first render.
+ * @param other_threads number of threads (or worker processes) of the second render.
+ * @param max_reported maximal number of mismatches kept in the report.
+ *
+ * @return The comparison of both renders.
+ * @throws std::invalid_argument if the screen has a memory budget (both frames are compared whole).
+ */
+ReproducibilityReport verify_reproducibility(Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit, const RenderSettings &settings, unsigned other_threads, std::size_t max_reported = 16);
+
+/**
+ * @brief Print a reproducibility report.
+ * @param report The report.
+ * @param stream The output stream.
+ */
+void print_reproducibility_report(const ReproducibilityReport &report, std::ostream &stream);
+
+#endif // REPRODUCIBILITY_HPP_
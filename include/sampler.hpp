@@ -0,0 +1,60 @@
+// -*- lsst-c++ -*-
+/**
+ * @file sampler.hpp
+ * @brief Declaration of the SampleStream class (random numbers of a pixel sample).
+ *
+ * @details The stream is counter-based: its numbers only depend on the render seed, the pixel
+ * and the sample index (hashed with the splitmix64 finalizer), never on the thread or process
+ * that draws them nor on the order in which the pixels are rendered. Together with the fixed
+ * summation order of the samples (see Screen::sample_pixel), a render gives the same image
+ * whatever the number of threads, worker processes or tiles.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef SAMPLER_HPP_
+#define SAMPLER_HPP_
+
+#include <cstdint>
+
+class SampleStream
+{
+public:
+    /**
+     * @brief Constructor: stream of one sample of one pixel.
+     * @param seed Seed of the render.
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     * @param sample Index of the sample within the pixel.
+     */
+    SampleStream(std::uint64_t seed, int i, int j, int sample)
+        : state(mix(mix(mix(seed) ^ (static_cast<std::uint64_t>(static_cast<std::uint32_t>(j)) << 32 | static_cast<std::uint32_t>(i))) ^ static_cast<std::uint32_t>(sample))) {}
+
+    /**
+     * @brief Next number of the stream.
+     * @return A number uniformly distributed in [0, 1) (24 random bits, exact in a float).
+     */
+    float next()
+    {
+        state += 0x9e3779b97f4a7c15ull;
+        return static_cast<float>(mix(state) >> 40) * (1.0f / 16777216.0f);
+    }
+
+private:
+    std::uint64_t state; ///< Counter of the stream.
+
+    /**
+     * @brief splitmix64 finalizer (bijective 64-bit hash).
+     * @param value The hashed value.
+     * @return The hash of the value.
+     */
+    static std::uint64_t mix(std::uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+};
+
+#endif // SAMPLER_HPP_
@@ -12,22 +12,46 @@
 
 #include "light.hpp"
 #include "elements.hpp"
+#include "mesh.hpp"
+#include "instance.hpp"
+#include "bvh.hpp"
+#include "bvh4.hpp"
+#include "grid.hpp"
 #include "ray.hpp"
 #include "intersection.hpp"
+#include "primitives.hpp"
+#include "arena.hpp"
 
+#include <array>
 #include <vector>
 #include <memory>
 
+/**
+ * @brief Primitive types known by the scene kernels (add new element types here).
+ */
+using ScenePrimitives = PrimitiveSet<Sphere, TriangleMesh, Instance>;
+
+/**
+ * @brief Top-level acceleration structure of a scene.
+ */
+enum class AccelerationStructure
+{
+    Bvh,     ///< Bounding volume hierarchy (any scene).
+    WideBvh, ///< 4-wide Bvh collapsed from the binary one (fewer, vectorised node tests).
+    Grid     ///< Uniform grid (dense sets of primitives of similar size, e.g. particles).
+};
+
 class Scene
 {
 public:
     std::vector<Light> lights;                      ///< List of the scene lights.
     std::vector<std::shared_ptr<Element>> elements; ///< List of the scene elements, handled thanks to unique pointers.
+    ScenePrimitives primitives;                     ///< Per-type view of the elements used by the intersection kernels.
 
     /**
      * @brief Default constructor for Scene.
      */
-    Scene() : lights(), elements() {}
+    Scene() : lights(), elements(), structure(AccelerationStructure::Bvh), bvh_method(BvhBuildMethod::BinnedSah), acceleration_dirty(false), acceleration_stale(false) {}
 
     // delete the affectation operator and copy constructor.
     Scene(const Scene &) = delete;
@@ -43,9 +67,51 @@ public:
     /**
      * @brief Add an element (sphere, box, ...) to the scene.
      * @param element Considered element (as a pointer).
+     * @throws std::invalid_argument if the element type is not part of ScenePrimitives.
      */
     void add_element(std::shared_ptr<Element> element);
 
+    /**
+     * @brief Move an element of the scene (see Element::set_transform).
+     * @details The acceleration structures are refitted, not rebuilt, before the next query.
+     *
+     * @param index Index of the element in `elements`.
+     * @param transform The transformation applied to the rest pose of the element.
+     */
+    void set_element_transform(std::size_t index, const Transform &transform);
+
+    /**
+     * @brief Choose the top-level acceleration structure (rebuilt before the next query).
+     * @param acceleration_structure The structure built over each primitive type.
+     */
+    void set_acceleration_structure(AccelerationStructure acceleration_structure);
+
+    /**
+     * @brief Top-level acceleration structure of the scene.
+     * @return The structure built over each primitive type.
+     */
+    AccelerationStructure acceleration_structure() const { return structure; }
+
+    /**
+     * @brief Choose how the top-level Bvh (and Bvh4) are built (rebuilt before the next query).
+     * @param method Split strategy (binned SAH by default, Morton for fast rebuilds).
+     */
+    void set_bvh_build_method(BvhBuildMethod method);
+
+    /**
+     * @brief Build the top-level acceleration structures (one Bvh, Bvh4 or UniformGrid per primitive type) if
+     * elements were added since the last build, or refit them if elements only moved.
+     * @details Called automatically by the first query following a change of the elements; call it
+     * explicitly before querying the scene from several threads.
+     */
+    void build_acceleration();
+
+    /**
+     * @brief Build the top-level acceleration structures with a pool of threads (see build_acceleration()).
+     * @param pool Threads sharing the build.
+     */
+    void build_acceleration(ThreadPool &pool);
+
     /**
      * @brief Throw the ray through the scene and return all the geometrical intersections of the ray.
      * @param ray The considered ray.
@@ -62,6 +128,24 @@ public:
      */
     Intersection find_first_intersection(const Ray &ray);
 
+    /**
+     * @brief Get the normal of the intersected element at the intersection point.
+     * @param intersection The considered (valid) intersection.
+     *
+     * @return The normal vector.
+     */
+    Vec3 get_normal(const Intersection &intersection) const;
+
+    /**
+     * @brief Get the geometric normal of the intersected element at the intersection point.
+     * @details Equal to get_normal, except on meshes with vertex normals: the normal of the hit
+     * triangle instead of the interpolated one. Shadow rays are offset along it.
+     *
+     * @param intersection The considered (valid) intersection.
+     * @return The geometric normal vector.
+     */
+    Vec3 get_geometric_normal(const Intersection &intersection) const;
+
     /**
      * @brief Propagate the ray throught the scene.
      * @param ray The considered ray.
@@ -71,6 +155,16 @@ public:
      */
     std::vector<Intersection> propagate_ray(const Ray &ray, const int max_hit);
 
+    /**
+     * @brief Propagate the ray throught the scene, storing the optical path in an arena.
+     * @param ray The considered ray.
+     * @param max_hit number of reflexions allowed.
+     * @param arena Arena of the calling thread (the path is valid until its next reset).
+     *
+     * @return Optical path.
+     */
+    ArenaVector<Intersection> propagate_ray(const Ray &ray, const int max_hit, Arena &arena);
+
     /**
      * @brief Tell if the light is visible from a point belonging to an element.
      * @param light Considered light.
@@ -79,7 +173,58 @@ public:
      *
      * @return true is the light is visible, false otherwise.
      */
-    bool light_is_visible_from_point_on_element(const Light &light, const Vec3 &point, const std::shared_ptr<const Element> &element);
+    bool light_is_visible_from_point_on_element(const Light &light, const Vec3 &point, const Element *element);
+
+    /**
+     * @brief Tell if the light is visible from an intersection point.
+     * @param light Considered light.
+     * @param intersection Considered (valid) intersection.
+     * @param normal Normal of the intersected element at the intersection point.
+     * @param geometric_normal Geometric normal at the intersection point (see get_geometric_normal).
+     *
+     * @return true is the light is visible, false otherwise.
+     */
+    bool light_is_visible_from_intersection(const Light &light, const Intersection &intersection, const Vec3 &normal, const Vec3 &geometric_normal);
+
+    /**
+     * @brief Tell if the light lies on the outer side of the intersected element.
+     * @param light Considered light.
+     * @param intersection Considered (valid) intersection.
+     * @param normal Normal of the intersected element at the intersection point.
+     *
+     * @return true if the element faces the light, false otherwise.
+     */
+    bool light_is_facing_intersection(const Light &light, const Intersection &intersection, const Vec3 &normal) const;
+
+    /**
+     * @brief Ray from a surface point to a light.
+     * @details The origin is offset along the geometric normal, turned to the side of the light,
+     * so that the ray does not hit the surface it leaves, and the ray interval stops at the light.
+     * An interpolated normal would not do: near silhouettes it can point below the surface.
+     *
+     * @param light Considered light.
+     * @param point Point on a surface.
+     * @param geometric_normal Geometric normal of the surface at the point (either side).
+     * @return The shadow ray.
+     */
+    Ray shadow_ray(const Light &light, const Vec3 &point, const Vec3 &geometric_normal) const;
+
+    /**
+     * @brief Tell if an element is hit by the ray within its interval ]t_min, t_max[.
+     * @param ray Considered ray.
+     *
+     * @return true if the ray is blocked, false otherwise.
+     */
+    bool is_occluded(const Ray &ray);
+
+private:
+    std::array<Bvh, ScenePrimitives::type_count> acceleration; ///< Top-level Bvh over the primitives of each type.
+    std::array<Bvh4, ScenePrimitives::type_count> wide_acceleration; ///< Top-level Bvh4 over the primitives of each type.
+    std::array<UniformGrid, ScenePrimitives::type_count> grids; ///< Top-level grid over the primitives of each type.
+    AccelerationStructure structure;                           ///< Structure used by the queries.
+    BvhBuildMethod bvh_method;                                 ///< Split strategy of the top-level Bvh.
+    bool acceleration_dirty;                                   ///< True if elements were added since the last build.
+    bool acceleration_stale;                                   ///< True if elements moved since the last build or refit.
 };
 
 #endif // SCENE_HPP_
\ No newline at end of file
@@ -17,12 +17,19 @@
 #include "ray.hpp"
 #include "scene.hpp"
 #include "intersection.hpp"
+#include "render_settings.hpp"
+#include "thread_pool.hpp"
+#include "arena.hpp"
+#include "framebuffer.hpp"
+#include "aov.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
 #include <iomanip>
 
+class ToneMapper;
+
 /**
  * @class Screen
  * @brief Represents a "real world" screen that projects a scene to an image.
@@ -36,7 +43,8 @@ public:
     const int height_resolution;            ///< Number of pixels per screen height.
     const float pixel_width;                ///< Width of a pixel in world units.
     const float pixel_height;               ///< Height of a pixel in world units.
-    std::vector<std::vector<Color>> pixels; ///< 2D array of Color objects representing the image.
+    Framebuffer pixels;                     ///< Tiled image, accessed as pixels(i, j).
+    AovBuffers aovs;                        ///< Auxiliary buffers of the last render (empty unless requested).
 
     /**
      * @brief Value constructor.
@@ -44,8 +52,9 @@ public:
      * @param h Height of the screen in world units.
      * @param w_res Number of pixels per screen width.
      * @param h_res Number of pixels per screen height.
+     * @param memory_budget bytes the image may keep in memory (0 for no limit), see Framebuffer.
      */
-    Screen(const float w, const float h, const int w_res, const int h_res);
+    Screen(const float w, const float h, const int w_res, const int h_res, std::size_t memory_budget = 0);
 
     /**
      * @brief Return if the considered pixel belongs to the screen.
@@ -74,6 +83,17 @@ public:
      */
     Vec3 get_pixel_center(int i, int j);
 
+    /**
+     * @brief Get a point of the considered pixel.
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     * @param u x-axis offset of the point in the pixel, in [0, 1) (0.5 for the center).
+     * @param v y-axis offset of the point in the pixel, in [0, 1) (0.5 for the center).
+     *
+     * @return the point.
+     */
+    Vec3 get_pixel_point(int i, int j, float u, float v);
+
     /**
      * @brief Get the ray coming from the camera to the pixel center.
      * @param i x-axis index of the pixel.
@@ -84,6 +104,18 @@ public:
      */
     Ray get_ray_passing_through_pixel(int i, int j, const Vec3 &camera_position);
 
+    /**
+     * @brief Get the ray coming from the camera to a point of the pixel.
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     * @param camera_position position of the camera (considered as a point).
+     * @param u x-axis offset of the point in the pixel, in [0, 1).
+     * @param v y-axis offset of the point in the pixel, in [0, 1).
+     *
+     * @return the ray.
+     */
+    Ray get_ray_passing_through_pixel(int i, int j, const Vec3 &camera_position, float u, float v);
+
     /**
      * @brief Color the considered pixel.
      * @param i x-axis index of the pixel.
@@ -97,12 +129,124 @@ public:
      */
     void save_image_as_ppm(const std::string &filename);
 
+    /**
+     * @brief Save the screen image as a Portable pixmap, through a tone mapping stage.
+     * @param filename name (and path) of the created Portable pixmap.
+     * @param tone_mapper conversion of the pixels to bytes.
+     * @param pool threads running the tone mapping (one row of tiles at a time).
+     */
+    void save_image_as_ppm(const std::string &filename, const ToneMapper &tone_mapper, ThreadPool &pool);
+
     /**
      * @brief Color the screen by ray tracing rays on the considered scene.
      * @param scene considered scene.
      * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
      */
     void render_scene(Scene &scene, const Vec3 &camera_position, int max_hit);
+
+    /**
+     * @brief Color the screen by ray tracing rays on the considered scene.
+     * @param scene considered scene.
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param settings execution options (mode, number of threads, ...).
+     */
+    void render_scene(Scene &scene, const Vec3 &camera_position, int max_hit, const RenderSettings &settings);
+
+    /**
+     * @brief Color the screen by ray tracing rays on the considered scene, reusing existing threads.
+     * @details Within a memory budget (see Framebuffer) the depth-first mode renders the tiles in
+     * waves of the tiles the budget holds instead of going row by row.
+     *
+     * @param scene considered scene.
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param settings execution options (settings.threads is ignored).
+     * @param pool threads running the render.
+     * @throws std::invalid_argument if auxiliary buffers are requested in another mode than depth-first or
+     * wavefront, the Cost buffer in another mode than depth-first, or several samples per pixel in another
+     * mode than depth-first or distributed; or if auxiliary buffers or the preview mode are requested
+     * within a memory budget (they hold whole frames).
+     */
+    void render_scene(Scene &scene, const Vec3 &camera_position, int max_hit, const RenderSettings &settings, ThreadPool &pool);
+
+    /**
+     * @brief Compute the color of one pixel (depth-first).
+     * @param scene considered scene (its acceleration structures must be built).
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     * @param arena arena of the calling thread, holding the optical path of the pixel.
+     * @param pixel_color computed color (output).
+     * @param aovs auxiliary buffers receiving the first hit of the pixel (nullptr to skip them).
+     *
+     * @return false if the ray hits nothing (the pixel keeps its background color), true otherwise.
+     */
+    bool trace_pixel(Scene &scene, const Vec3 &camera_position, int max_hit, int i, int j, Arena &arena, Color &pixel_color, AovBuffers *aovs = nullptr);
+
+    /**
+     * @brief Compute the color of one pixel as the mean of jittered samples (depth-first).
+     * @details Sample s goes through the point of the pixel drawn from SampleStream(seed, i, j, s);
+     * a sample that hits nothing counts as the background color. The samples are summed in
+     * increasing order, so the color does not depend on the thread or process computing it. A
+     * single sample goes through the pixel center (trace_pixel). The auxiliary buffers receive
+     * the first hit of the first sample, the shadow rays of every sample and the cycles spent
+     * on the whole pixel.
+     *
+     * @param scene considered scene (its acceleration structures must be built).
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param i x-axis index of the pixel.
+     * @param j y-axis index of the pixel.
+     * @param samples number of samples.
+     * @param seed seed of the render.
+     * @param arena arena of the calling thread, holding the optical path of the current sample.
+     * @param pixel_color computed color (output).
+     * @param aovs auxiliary buffers receiving the first hit of the pixel (nullptr to skip them).
+     *
+     * @return false if every sample hits nothing (the pixel keeps its background color), true otherwise.
+     */
+    bool sample_pixel(Scene &scene, const Vec3 &camera_position, int max_hit, int i, int j, int samples, std::uint64_t seed, Arena &arena, Color &pixel_color, AovBuffers *aovs = nullptr);
+
+private:
+    /**
+     * @brief Compute the color carried by a camera ray (depth-first).
+     * @param scene considered scene (its acceleration structures must be built).
+     * @param ray the camera ray.
+     * @param max_hit number of reflexions allowed.
+     * @param arena arena of the calling thread, holding the optical path of the ray.
+     * @param pixel_color computed color (output).
+     * @param first_hit receives the first intersection of the ray (nullptr to skip it).
+     * @param shadow_rays incremented by the number of shadow rays traced (nullptr to skip the count).
+     *
+     * @return false if the ray hits nothing, true otherwise.
+     */
+    bool trace_camera_ray(Scene &scene, const Ray &ray, int max_hit, Arena &arena, Color &pixel_color, Intersection *first_hit, std::uint32_t *shadow_rays);
+
+    /**
+     * @brief Color one row of the screen (depth-first).
+     * @param scene considered scene.
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param j y-axis index of the row.
+     * @param arena arena of the calling thread, holding the optical path of the current pixel.
+     * @param settings execution options (samples per pixel and seed).
+     * @param aovs auxiliary buffers to fill (nullptr to skip them).
+     */
+    void render_row(Scene &scene, const Vec3 &camera_position, int max_hit, int j, Arena &arena, const RenderSettings &settings, AovBuffers *aovs);
+
+    /**
+     * @brief Color one tile of the framebuffer (depth-first, used when the image is spilled).
+     * @param scene considered scene.
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param tile index of the tile (see Framebuffer::tile_rectangle).
+     * @param arena arena of the calling thread, holding the optical path of the current pixel.
+     * @param settings execution options (samples per pixel and seed).
+     */
+    void render_tile(Scene &scene, const Vec3 &camera_position, int max_hit, std::size_t tile, Arena &arena, const RenderSettings &settings);
 };
 
 #endif // SCREEN_HPP_
\ No newline at end of file
@@ -0,0 +1,101 @@
+// -*- lsst-c++ -*-
+/**
+ * @file sequence.hpp
+ * @brief Declaration of the SequenceRenderer class (animated sequence rendering).
+ *
+ * @details A SequenceRenderer renders successive frames of an animated scene. Between two frames
+ * only the moved elements are updated and the acceleration structures are refitted instead of
+ * rebuilt; the threads and render buffers are created once for the whole sequence, and each
+ * frame is written to disk by a background thread while the next one is rendered (within a memory
+ * budget, before it is rendered). The extension of the frame names gives their format, as for a
+ * still image (see save_image).
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef SEQUENCE_HPP_
+#define SEQUENCE_HPP_
+
+#include "screen.hpp"
+#include "scene.hpp"
+#include "hdr_output.hpp"
+#include "tone_mapping.hpp"
+#include "transform.hpp"
+#include "thread_pool.hpp"
+#include "wavefront.hpp"
+
+#include <cstddef>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Motion of the scene elements for one frame.
+ */
+struct SequenceFrame
+{
+    std::vector<std::pair<std::size_t, Transform>> transforms; ///< (element index, transformation of its rest pose).
+};
+
+class SequenceRenderer
+{
+public:
+    /**
+     * @brief Constructor.
+     * @details The current pixels of the screen are kept as the background of every frame.
+     *
+     * @param screen screen the frames are rendered on.
+     * @param settings execution options, shared by every frame.
+     * @param tone_mapper conversion of the pixels to bytes (PPM frames).
+     * @param compression compression of the scanlines (.half frames).
+     */
+    SequenceRenderer(Screen &screen, const RenderSettings &settings, const ToneMapper &tone_mapper = ToneMapper(), HalfCompression compression = HalfCompression::Rle);
+
+    /**
+     * @brief Destructor: waits for the last frame to be written.
+     */
+    ~SequenceRenderer();
+
+    // delete the affectation operator and copy constructor.
+    SequenceRenderer(const SequenceRenderer &) = delete;
+
+    SequenceRenderer &operator=(const SequenceRenderer &) = delete;
+
+    /**
+     * @brief Render and save every frame of the sequence.
+     * @param scene considered scene (animated through Scene::set_element_transform).
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param frames motion of the elements for each frame.
+     * @param filename_pattern name of the frames, with one printf-like integer field (e.g. "frame_%04d.ppm", or .pfm / .half for linear frames).
+     * @throws std::invalid_argument if the pattern has no integer field, or if several samples per
+     * pixel are requested in the wavefront mode.
+     * @throws std::runtime_error if a frame cannot be written.
+     */
+    void render(Scene &scene, const Vec3 &camera_position, int max_hit, const std::vector<SequenceFrame> &frames, const std::string &filename_pattern);
+
+    /**
+     * @brief Name of a frame.
+     * @param filename_pattern name of the frames, with one printf-like integer field ("%d" or "%0Nd").
+     * @param frame index of the frame.
+     * @throws std::invalid_argument if the pattern has no integer field.
+     * @return The name of the frame.
+     */
+    static std::string frame_filename(const std::string &filename_pattern, int frame);
+
+private:
+    Screen &screen;                                     ///< Screen the frames are rendered on.
+    RenderSettings settings;                            ///< Execution options.
+    ThreadPool pool;                                    ///< Render threads, shared by every frame.
+    WavefrontRenderer wavefront;                        ///< Wavefront queues, shared by every frame.
+    ToneMapper tone_mapper;                             ///< Conversion of the pixels to bytes (PPM frames).
+    HalfCompression compression;                        ///< Compression of the scanlines (.half frames).
+    ThreadPool writer_pool;                             ///< Writer thread (the render threads are busy with the next frame).
+    Screen encoding;                                    ///< Frame being written while the next one renders.
+    Framebuffer background;                             ///< Pixels every frame starts from.
+    std::future<void> pending_write;                    ///< Write of the previous frame.
+};
+
+#endif // SEQUENCE_HPP_
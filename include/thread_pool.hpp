@@ -0,0 +1,91 @@
+// -*- lsst-c++ -*-
+/**
+ * @file thread_pool.hpp
+ * @brief Declaration of the ThreadPool class.
+ *
+ * @details A ThreadPool owns a fixed set of worker threads, created once and reused by every
+ * parallel loop (render stages, post-processes, successive frames).
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param thread_count Total number of threads, including the calling thread (0 means one per hardware thread).
+     */
+    explicit ThreadPool(unsigned thread_count = 0);
+
+    /**
+     * @brief Destructor: joins the worker threads.
+     */
+    ~ThreadPool();
+
+    // delete the affectation operator and copy constructor.
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Number of threads running the loops (workers and calling thread).
+     * @return The number of threads; thread indices given to the tasks are in [0, size()).
+     */
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    /**
+     * @brief Run a loop over [0, count) in chunks of `grain` indices on every thread, then wait for it.
+     * @details The calling thread takes part in the loop as thread 0. Loops must not be nested.
+     *
+     * @param count Number of indices.
+     * @param grain Number of indices per chunk (at least 1).
+     * @param body Body of the loop, callable as `body(begin, end, thread)` on the indices [begin, end).
+     * @throws The first exception thrown by the body, once every thread has stopped.
+     */
+    template <typename Body>
+    void parallel_for(std::size_t count, std::size_t grain, const Body &body)
+    {
+        // The body is called through a plain function pointer: no std::function, no heap allocation
+        run_loop(count, grain, [](const void *context, std::size_t begin, std::size_t end, unsigned thread)
+                 { (*static_cast<const Body *>(context))(begin, end, thread); }, &body);
+    }
+
+private:
+    using Invoker = void (*)(const void *context, std::size_t begin, std::size_t end, unsigned thread);
+
+    std::vector<std::thread> workers;     ///< Worker threads (thread indices 1 to size() - 1).
+    std::mutex mutex;                     ///< Protects the loop description below.
+    std::condition_variable start_signal; ///< Signals the workers that a loop started (or the pool stops).
+    std::condition_variable done_signal;  ///< Signals the caller that a worker finished the loop.
+    Invoker task;                         ///< Calls the body of the current loop.
+    const void *task_context;             ///< Body of the current loop.
+    std::size_t task_count;               ///< Number of indices of the current loop.
+    std::size_t task_grain;               ///< Chunk size of the current loop.
+    std::atomic<std::size_t> next_index;  ///< First index of the next chunk to process.
+    std::uint64_t generation;             ///< Number of loops started (workers wait for it to change).
+    unsigned busy_workers;                ///< Number of workers still running the current loop.
+    bool stopping;                        ///< True when the pool is being destroyed.
+    std::exception_ptr error;             ///< First exception thrown by the current loop.
+
+    void run_loop(std::size_t count, std::size_t grain, Invoker invoke, const void *context);
+
+    void worker_loop(unsigned index);
+
+    void run_chunks(unsigned thread);
+};
+
+#endif // THREAD_POOL_HPP_
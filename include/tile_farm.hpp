@@ -0,0 +1,69 @@
+// -*- lsst-c++ -*-
+/**
+ * @file tile_farm.hpp
+ * @brief Declaration of the TileFarm class (render distributed over worker processes).
+ *
+ * @details The coordinator splits the screen into square tiles and hands them out, one at a
+ * time, to worker processes connected through Unix socket pairs; each finished tile is sent
+ * back and composited into the screen while the worker gets the next one. The workers are
+ * forked once the scene and its acceleration structures are built, so they all share the
+ * coordinator's copy of the scene (copy-on-write) instead of loading it again.
+ *
+ * When the image is spilled (see Framebuffer) the tiles are cut along the framebuffer tiles and
+ * handed out in their order, to at most as many workers as the memory budget holds tiles.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef TILE_FARM_HPP_
+#define TILE_FARM_HPP_
+
+#include "screen.hpp"
+#include "scene.hpp"
+
+#include <cstdint>
+
+/**
+ * @brief Rectangle of pixels rendered by a worker (also the message sent to the workers).
+ */
+struct Tile
+{
+    std::int32_t x;      ///< x-axis index of the first pixel.
+    std::int32_t y;      ///< y-axis index of the first pixel.
+    std::int32_t width;  ///< Width in pixels (0 tells the worker to stop).
+    std::int32_t height; ///< Height in pixels.
+};
+
+class TileFarm
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param processes Number of worker processes (0 means one per hardware thread).
+     * @param tile_size Side of the tiles in pixels.
+     * @param samples_per_pixel Number of jittered samples per pixel (see Screen::sample_pixel).
+     * @param seed Seed of the pixel samples.
+     */
+    TileFarm(unsigned processes, int tile_size, int samples_per_pixel = 1, std::uint64_t seed = 0);
+
+    /**
+     * @brief Color the screen with the worker processes.
+     * @details Produces the same image as the depth-first Screen::render_scene.
+     *
+     * @param screen considered screen.
+     * @param scene considered scene (its acceleration structures must be built).
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @throws std::runtime_error if a worker cannot be started or dies before the end of the render.
+     */
+    void render(Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit);
+
+private:
+    unsigned processes; ///< Number of worker processes.
+    int tile_size;      ///< Side of the tiles in pixels.
+    int samples_per_pixel; ///< Number of samples per pixel.
+    std::uint64_t seed;    ///< Seed of the pixel samples.
+};
+
+#endif // TILE_FARM_HPP_
@@ -0,0 +1,94 @@
+// -*- lsst-c++ -*-
+/**
+ * @file tone_mapping.hpp
+ * @brief Declaration of the ToneMapper class (linear radiance to 8-bit pixels).
+ *
+ * @details The post-process runs in parallel over rows of the screen: exposure, tone map
+ * operator, transfer function (sRGB through a lookup table) and quantization, optionally
+ * with ordered dithering, into an interleaved RGB byte buffer that writers use as is. The
+ * default settings give the bytes of Color::as_bytes.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef TONE_MAPPING_HPP_
+#define TONE_MAPPING_HPP_
+
+#include "screen.hpp"
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Curve compressing the radiance into [0, 1].
+ */
+enum class ToneMapOperator
+{
+    Clamp,    ///< Values above 1 are clipped (Color::as_bytes).
+    Reinhard, ///< c / (1 + c) per channel.
+    Aces      ///< Narkowicz's fit of the ACES filmic curve.
+};
+
+/**
+ * @brief Encoding of the tone mapped values.
+ */
+enum class TransferFunction
+{
+    Linear, ///< Values are quantized as they are (Color::as_bytes).
+    Srgb    ///< sRGB transfer curve.
+};
+
+struct ToneMapSettings
+{
+    double exposure = 0.0;                           ///< Exposure in stops (the radiance is scaled by 2^exposure).
+    ToneMapOperator tone_map = ToneMapOperator::Clamp; ///< Tone map operator.
+    TransferFunction transfer = TransferFunction::Linear; ///< Transfer function.
+    bool dither = false;                             ///< Ordered (8x8 Bayer) dithering before quantization.
+};
+
+class ToneMapper
+{
+public:
+    static constexpr int table_size = 4096; ///< Number of intervals of the sRGB lookup table.
+
+    /**
+     * @brief Constructor.
+     * @param settings The considered settings.
+     */
+    explicit ToneMapper(const ToneMapSettings &settings = ToneMapSettings());
+
+    /**
+     * @brief Tone map rows of the screen.
+     * @param screen The considered screen.
+     * @param first_row First row to convert.
+     * @param row_count Number of rows.
+     * @param rgb Output: row_count * width * 3 bytes, interleaved RGB in row-major order.
+     * @param pool threads converting the rows.
+     */
+    void apply(const Screen &screen, int first_row, int row_count, std::uint8_t *rgb, ThreadPool &pool) const;
+
+    /**
+     * @brief Tone map the whole screen.
+     * @param screen The considered screen.
+     * @param pool threads converting the rows.
+     * @return width * height * 3 bytes, interleaved RGB in row-major order.
+     */
+    std::vector<std::uint8_t> apply(const Screen &screen, ThreadPool &pool) const;
+
+private:
+    ToneMapSettings settings;       ///< Settings of the post-process.
+    double exposure_scale;          ///< 2^exposure.
+    std::vector<double> srgb_table; ///< 255 * sRGB(k / table_size) for k in [0, table_size].
+
+    /**
+     * @brief Tone map one row of the screen.
+     * @param screen The considered screen.
+     * @param j y-axis index of the row.
+     * @param rgb Output: width * 3 bytes.
+     */
+    void map_row(const Screen &screen, int j, std::uint8_t *rgb) const;
+};
+
+#endif // TONE_MAPPING_HPP_
@@ -0,0 +1,138 @@
+// -*- lsst-c++ -*-
+/**
+ * @file transform.hpp
+ * @brief Declaration of the Transform class (affine transformation of the space).
+ *
+ * @details A Transform stores a 3x4 affine matrix together with its inverse, so that points,
+ * vectors and normals can be moved between world and object spaces without inverting
+ * anything during rendering.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef TRANSFORM_HPP_
+#define TRANSFORM_HPP_
+
+#include "vec3.hpp"
+#include "aabb.hpp"
+#include "ray.hpp"
+
+#include <array>
+
+class Transform
+{
+public:
+    using Matrix = std::array<std::array<double, 4>, 3>; ///< Rows of a 3x4 affine matrix.
+
+    /**
+     * @brief Default constructor.
+     * @details Initializes the identity transformation.
+     */
+    Transform();
+
+    /**
+     * @brief Constructor from an affine matrix.
+     * @param m The 3x4 matrix (the last column is the translation).
+     * @throws std::invalid_argument if the linear part of the matrix is singular.
+     */
+    explicit Transform(const Matrix &m);
+
+    /**
+     * @brief Translation by a vector.
+     * @param offset The translation vector.
+     * @return The transformation.
+     */
+    static Transform translation(const Vec3 &offset);
+
+    /**
+     * @brief Scaling along the axes.
+     * @param factors The scale factor along each axis (must be non-zero).
+     * @return The transformation.
+     */
+    static Transform scaling(const Vec3 &factors);
+
+    /**
+     * @brief Rotation around an axis passing through the origin.
+     * @param axis The rotation axis (does not need to be normalized).
+     * @param angle The rotation angle in radians (counter-clockwise around the axis).
+     * @return The transformation.
+     */
+    static Transform rotation(const Vec3 &axis, double angle);
+
+    /**
+     * @brief Composition 'this ∘ other' (other is applied first).
+     * @param other The transformation applied first.
+     * @return The composed transformation.
+     */
+    Transform operator*(const Transform &other) const;
+
+    /**
+     * @brief Inverse transformation.
+     * @return The inverse.
+     */
+    Transform inverse() const;
+
+    /**
+     * @brief Apply the transformation to a point.
+     * @param p The considered point.
+     * @return The transformed point.
+     */
+    Vec3 transform_point(const Vec3 &p) const;
+
+    /**
+     * @brief Apply the linear part of the transformation to a vector.
+     * @param v The considered vector.
+     * @return The transformed vector.
+     */
+    Vec3 transform_vector(const Vec3 &v) const;
+
+    /**
+     * @brief Transform a normal (inverse transpose of the linear part, not normalized).
+     * @param n The considered normal.
+     * @return The transformed normal.
+     */
+    Vec3 transform_normal(const Vec3 &n) const;
+
+    /**
+     * @brief Transform a ray (the direction is not renormalized, so distances t and the ray interval are preserved).
+     * @param ray The considered ray.
+     * @return The transformed ray.
+     */
+    Ray transform_ray(const Ray &ray) const;
+
+    /**
+     * @brief Apply the inverse transformation to a point.
+     * @param p The considered point.
+     * @return The transformed point.
+     */
+    Vec3 inverse_transform_point(const Vec3 &p) const;
+
+    /**
+     * @brief Apply the inverse transformation to a ray (distances t and the ray interval are preserved).
+     * @param ray The considered ray.
+     * @return The transformed ray.
+     */
+    Ray inverse_transform_ray(const Ray &ray) const;
+
+    /**
+     * @brief Bounds of a transformed box.
+     * @param box The considered box.
+     * @return The bounds of the 8 transformed corners.
+     */
+    Aabb transform_bounds(const Aabb &box) const;
+
+    /**
+     * @brief Get the matrix of the transformation.
+     * @return The 3x4 matrix.
+     */
+    const Matrix &matrix() const { return m; }
+
+private:
+    Matrix m;     ///< Matrix of the transformation.
+    Matrix m_inv; ///< Matrix of the inverse transformation.
+
+    Transform(const Matrix &m, const Matrix &m_inv) : m(m), m_inv(m_inv) {}
+};
+
+#endif // TRANSFORM_HPP_
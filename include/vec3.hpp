@@ -101,7 +101,7 @@ public:
     /**
      * @brief Element-wise division 'v = (1/a) * v'.
      * @param a Scalar value to divide by.
-     * @throws std::runtime_error if 'a' is zero (division by zero).
+     * @throws std::runtime_error if 'a' is zero and the math is checked (otherwise the division is counted).
      * @return Vec3& The modified current instance ('v').
      */
     Vec3 &operator/=(const double &a);
@@ -130,7 +130,7 @@ public:
     /**
      * @brief Scalar division 'v / a' (non-modifying).
      * @param a Scalar value to divide by.
-     * @throws std::runtime_error if 'a' is zero (division by zero).
+     * @throws std::runtime_error if 'a' is zero and the math is checked (otherwise the division is counted).
      * @return Vec3 A new vector that is the result of dividing 'v' by 'a'.
      */
     Vec3 operator/(const double &a) const;
@@ -150,6 +150,7 @@ public:
 
     /**
      * @brief Normalize the Vec3 vector.
+     * @throws std::runtime_error if the vector is zero and the math is checked (otherwise it is counted).
      *
      * @return The normalized vector.
      */
@@ -0,0 +1,127 @@
+// -*- lsst-c++ -*-
+/**
+ * @file wavefront.hpp
+ * @brief Declaration of the WavefrontRenderer class (queue-based ray scheduler).
+ *
+ * @details Instead of tracing every pixel to completion, the wavefront renderer processes a
+ * batch of pixels one stage at a time: all primary rays are generated, then extended to
+ * their closest hit, misses are dropped, the hits are shaded (emitting one shadow ray per
+ * light), the shadow rays are sorted and traced and the pixel colors are finally accumulated.
+ * Each stage is a parallel loop over a structure-of-arrays queue, so a thread runs the same
+ * kernel over contiguous data instead of interleaving unrelated work.
+ *
+ * Camera rays are coherent by construction (neighbouring pixels), the secondary (shadow) rays are
+ * not: before they are traced, they are ordered by direction octant, then by the Morton code of
+ * their origin within the batch, so that consecutive rays walk the same acceleration nodes.
+ *
+ * The batches follow the render order of the framebuffer: row by row, or tile by tile when the
+ * image is spilled, a batch then ending with the last tile the memory budget holds.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+#ifndef WAVEFRONT_HPP_
+#define WAVEFRONT_HPP_
+
+#include "screen.hpp"
+#include "scene.hpp"
+#include "thread_pool.hpp"
+#include "radix_sort.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Structure-of-arrays queue of rays.
+ */
+struct RayQueue
+{
+    std::vector<double> origin[3];      ///< Ray origins, one array per axis.
+    std::vector<double> direction[3];   ///< Ray directions, one array per axis.
+    std::vector<double> t_min;          ///< Lower bounds of the ray intervals.
+    std::vector<double> t_max;          ///< Upper bounds of the ray intervals.
+    std::vector<std::uint32_t> pixel;   ///< Index of the pixel (j * width + i) each ray contributes to.
+
+    /**
+     * @brief Number of rays in the queue.
+     * @return The queue size.
+     */
+    std::size_t size() const { return pixel.size(); }
+
+    /**
+     * @brief Resize every array of the queue (the capacity is kept between batches).
+     * @param count The new number of rays.
+     */
+    void resize(std::size_t count);
+
+    /**
+     * @brief Reserve every array of the queue, so that resizing up to count does not allocate.
+     * @param count The number of rays to make room for.
+     */
+    void reserve(std::size_t count);
+
+    /**
+     * @brief Store a ray.
+     * @param index Slot of the ray.
+     * @param ray The ray.
+     * @param pixel_index Index of the pixel the ray contributes to.
+     */
+    void set(std::size_t index, const Ray &ray, std::uint32_t pixel_index);
+
+    /**
+     * @brief Load a ray.
+     * @param index Slot of the ray.
+     * @return The ray.
+     */
+    Ray get(std::size_t index) const;
+};
+
+class WavefrontRenderer
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param batch_size Number of pixels in flight per batch (bounds the queue memory).
+     * @param sort_rays Sort the shadow rays before tracing them (the image does not depend on it).
+     */
+    explicit WavefrontRenderer(std::size_t batch_size = 1 << 16, bool sort_rays = true);
+
+    /**
+     * @brief Color the screen by ray tracing the scene, one stage at a time.
+     * @details Produces the same image as the depth-first Screen::render_scene.
+     *
+     * @param screen considered screen.
+     * @param scene considered scene (its acceleration structures must be built).
+     * @param camera_position position of the camera.
+     * @param max_hit number of reflexions allowed.
+     * @param pool threads running the stages.
+     * @param aovs auxiliary buffers receiving the first hit of every pixel (nullptr to skip them).
+     */
+    void render(Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit, ThreadPool &pool, AovBuffers *aovs = nullptr);
+
+private:
+    std::size_t batch_size;                 ///< Number of pixels in flight per batch.
+    bool sort_rays;                         ///< True if the shadow rays are sorted before being traced.
+    RayQueue primary;                       ///< Generate stage output: camera rays.
+    std::vector<Intersection> hits;         ///< Extend stage output: closest hit of each camera ray.
+    std::vector<std::uint32_t> active;      ///< Slots of the camera rays that hit something.
+    RayQueue shadow;                        ///< Shade stage output: one shadow ray per (active ray, light).
+    std::vector<double> contribution[3];    ///< Lambert contribution of each shadow ray, if the light is visible.
+    std::vector<std::uint8_t> light_visible; ///< Shadow stage output: 1 if the light is visible.
+    std::vector<Aabb> origin_bounds;        ///< Sort stage: bounds of the shadow ray origins, one per thread.
+    std::vector<std::uint64_t> shadow_order; ///< Sort stage output: (octant, Morton code) key and slot of every shadow ray, in tracing order.
+    RadixSortBuffers sort_buffers;          ///< Scratch memory of the sort stage.
+
+    void generate(Screen &screen, const Vec3 &camera_position, std::size_t first_pixel, std::size_t count, ThreadPool &pool);
+    void extend(Scene &scene, ThreadPool &pool);
+    void compact_misses();
+    void shade(Scene &scene, ThreadPool &pool);
+    void sort_shadows(ThreadPool &pool);
+    void trace_shadows(Scene &scene, ThreadPool &pool);
+    void accumulate(Screen &screen, Scene &scene, int max_hit, ThreadPool &pool);
+    void record_aovs(Scene &scene, AovBuffers &aovs, bool traced_shadows, ThreadPool &pool);
+};
+
+#endif // WAVEFRONT_HPP_
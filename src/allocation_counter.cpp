@@ -0,0 +1,87 @@
+// -*- lsst-c++ -*-
+/**
+ * @file allocation_counter.cpp
+ * @brief Implementation of the heap allocation counter.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "allocation_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef PATH_TRACING_COUNT_ALLOCATIONS
+
+namespace
+{
+    thread_local std::size_t allocation_count = 0;
+
+    void *counted_allocation(std::size_t size)
+    {
+        ++allocation_count;
+        void *memory = std::malloc(size == 0 ? 1 : size);
+        if (memory == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+}
+
+// Replacements of the global allocation functions (the aligned versions are not counted).
+void *operator new(std::size_t size)
+{
+    return counted_allocation(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return counted_allocation(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+bool allocation_counting_enabled()
+{
+    return true;
+};
+
+std::size_t thread_allocation_count()
+{
+    return allocation_count;
+};
+
+#else
+
+bool allocation_counting_enabled()
+{
+    return false;
+};
+
+std::size_t thread_allocation_count()
+{
+    return 0;
+};
+
+#endif
@@ -0,0 +1,118 @@
+// -*- lsst-c++ -*-
+/**
+ * @file aov.cpp
+ * @brief Implementation of the AovBuffers struct.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "aov.hpp"
+#include "hdr_output.hpp"
+#include "scene.hpp"
+
+// Allocate the requested channels (every pixel is a miss) and free the others.
+void AovBuffers::resize(int width, int height, unsigned channels)
+{
+    this->width = width;
+    this->height = height;
+    this->channels = channels;
+    const std::size_t size = static_cast<std::size_t>(width) * height;
+    auto allocate = [&](auto &buffer, Channel channel, auto miss)
+    {
+        if (channels & channel)
+        {
+            buffer.assign(size, miss);
+        }
+        else
+        {
+            buffer.clear();
+            buffer.shrink_to_fit();
+        }
+    };
+    allocate(depth, Depth, 0.0f);
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        allocate(normal[channel], Normal, 0.0f);
+        allocate(albedo[channel], Albedo, 0.0f);
+    }
+    allocate(element_id, ElementId, no_element);
+    allocate(shadow_rays, ShadowRays, std::uint32_t(0));
+    allocate(cost, Cost, std::uint64_t(0));
+};
+
+// Record the first hit of the ray of a pixel.
+void AovBuffers::record(int i, int j, const Scene &scene, const Intersection &hit, std::uint32_t shadow_ray_count)
+{
+    const std::size_t pixel = static_cast<std::size_t>(j) * width + i;
+    const bool valid = hit.valid;
+    if (channels & Depth)
+    {
+        depth[pixel] = valid ? static_cast<float>(hit.t) : 0.0f;
+    }
+    if (channels & Normal)
+    {
+        const Vec3 hit_normal = valid ? scene.get_normal(hit) : Vec3();
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            normal[channel][pixel] = static_cast<float>(hit_normal[channel]);
+        }
+    }
+    if (channels & Albedo)
+    {
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            albedo[channel][pixel] = valid ? static_cast<float>(hit.element->material.albedo[channel]) : 0.0f;
+        }
+    }
+    if (channels & ElementId)
+    {
+        element_id[pixel] = valid ? hit.element_index : no_element;
+    }
+    if (channels & ShadowRays)
+    {
+        shadow_rays[pixel] = shadow_ray_count;
+    }
+};
+
+// Save every allocated channel as a Portable float map.
+void AovBuffers::save_as_pfm(const std::string &prefix) const
+{
+    auto as_float = [](const auto &values)
+    {
+        return std::vector<float>(values.begin(), values.end());
+    };
+
+    if (channels & Depth)
+    {
+        save_planes_as_pfm(prefix + "_depth.pfm", width, height, {depth.data()});
+    }
+    if (channels & Normal)
+    {
+        save_planes_as_pfm(prefix + "_normal.pfm", width, height, {normal[0].data(), normal[1].data(), normal[2].data()});
+    }
+    if (channels & Albedo)
+    {
+        save_planes_as_pfm(prefix + "_albedo.pfm", width, height, {albedo[0].data(), albedo[1].data(), albedo[2].data()});
+    }
+    if (channels & ElementId)
+    {
+        std::vector<float> ids = as_float(element_id);
+        for (std::size_t k = 0; k < ids.size(); ++k)
+        {
+            ids[k] = element_id[k] == no_element ? -1.0f : ids[k]; // -1 marks the misses
+        }
+        save_planes_as_pfm(prefix + "_element_id.pfm", width, height, {ids.data()});
+    }
+    if (channels & ShadowRays)
+    {
+        std::vector<float> counts = as_float(shadow_rays);
+        save_planes_as_pfm(prefix + "_shadow_rays.pfm", width, height, {counts.data()});
+    }
+    if (channels & Cost)
+    {
+        std::vector<float> cycles = as_float(cost);
+        save_planes_as_pfm(prefix + "_cost.pfm", width, height, {cycles.data()});
+    }
+};
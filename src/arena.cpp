@@ -0,0 +1,45 @@
+// -*- lsst-c++ -*-
+/**
+ * @file arena.cpp
+ * @brief Implementation of the Arena class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "arena.hpp"
+
+#include <algorithm>
+
+Arena::Arena(std::size_t block_size) : block_size(std::max<std::size_t>(block_size, 64)) {}
+
+// Move to the next block that fits the allocation, growing the arena if none does.
+void *Arena::allocate_slow(std::size_t size, std::size_t alignment)
+{
+    if (current < blocks.size())
+    {
+        ++current;
+    }
+    while (current < blocks.size() && blocks[current].size < size + alignment)
+    {
+        ++current;
+    }
+    if (current == blocks.size())
+    {
+        std::size_t new_size = std::max(block_size, size + alignment);
+        blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[new_size]), new_size});
+    }
+    offset = 0;
+    return allocate(size, alignment);
+};
+
+std::size_t Arena::capacity() const
+{
+    std::size_t total = 0;
+    for (const Block &block : blocks)
+    {
+        total += block.size;
+    }
+    return total;
+};
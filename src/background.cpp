@@ -26,6 +26,7 @@ void apply_gradient_background(Screen &screen, const Color &top_color, const Col
         {
             screen.color_pixel(i, j, blended_color);
         }
+        screen.pixels.release_rows(j / Framebuffer::tile_size * Framebuffer::tile_size, j + 1);
     }
 };
 
@@ -38,6 +39,7 @@ void apply_solid_background(Screen &screen, const Color &color)
         {
             screen.color_pixel(i, j, color);
         }
+        screen.pixels.release_rows(j / Framebuffer::tile_size * Framebuffer::tile_size, j + 1);
     }
 };
 
@@ -51,5 +53,6 @@ void apply_checkerboard_background(Screen &screen, const Color &color1, const Co
             bool is_color1 = ((i / square_size) % 2 == (j / square_size) % 2);
             screen.color_pixel(i, j, is_color1 ? color1 : color2);
         }
+        screen.pixels.release_rows(j / Framebuffer::tile_size * Framebuffer::tile_size, j + 1);
     }
 };
\ No newline at end of file
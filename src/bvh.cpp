@@ -0,0 +1,647 @@
+// -*- lsst-c++ -*-
+/**
+ * @file bvh.cpp
+ * @brief Implementation of the Bvh class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "bvh.hpp"
+#include "radix_sort.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // Round a double down / up to the closest float so that node bounds stay conservative.
+    float round_down(double value)
+    {
+        float f = static_cast<float>(value);
+        return (static_cast<double>(f) > value) ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    float round_up(double value)
+    {
+        float f = static_cast<float>(value);
+        return (static_cast<double>(f) < value) ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    void set_node_bounds(BvhNode &node, const Aabb &box)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            node.lower[axis] = round_down(box.min[axis]);
+            node.upper[axis] = round_up(box.max[axis]);
+        }
+    }
+
+    // Union of the bounds of two nodes (exact: the rounding commutes with min and max).
+    void merge_node_bounds(BvhNode &node, const BvhNode &a, const BvhNode &b)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            node.lower[axis] = std::min(a.lower[axis], b.lower[axis]);
+            node.upper[axis] = std::max(a.upper[axis], b.upper[axis]);
+        }
+    }
+
+    constexpr std::size_t chunk_size = 1 << 12; ///< Primitives per chunk of the parallel loops.
+    constexpr int bin_count = 16;               ///< Bins of the SAH builder.
+    constexpr int max_sah_depth = 48;           ///< Deeper SAH nodes are split at the median (bounds the tree depth).
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+
+    // Split of a range of primitives into [begin, middle) and [middle, end).
+    struct Split
+    {
+        std::uint32_t middle; ///< First primitive of the second child.
+        int axis;             ///< Split axis.
+    };
+
+    // Bounds of a primitive in single precision, moved by the SAH partitions instead of an index (32 bytes).
+    struct SahPrimitive
+    {
+        float lower[3];         ///< Lower corner (rounded down).
+        float upper[3];         ///< Upper corner (rounded up).
+        std::uint32_t index;    ///< Index of the primitive.
+        std::uint32_t padding;  ///< Keeps the record 32 bytes long.
+
+        float centroid(int axis) const { return 0.5f * (lower[axis] + upper[axis]); }
+    };
+
+    // Box in single precision (empty by default).
+    struct FloatBox
+    {
+        float lower[3] = {infinity, infinity, infinity};
+        float upper[3] = {-infinity, -infinity, -infinity};
+
+        void expand(const float other_lower[3], const float other_upper[3])
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                lower[axis] = std::min(lower[axis], other_lower[axis]);
+                upper[axis] = std::max(upper[axis], other_upper[axis]);
+            }
+        }
+
+        void expand(const FloatBox &box) { expand(box.lower, box.upper); }
+
+        double surface_area() const
+        {
+            const double dx = upper[0] - lower[0], dy = upper[1] - lower[1], dz = upper[2] - lower[2];
+            return 2.0 * (dx * dy + dy * dz + dz * dx);
+        }
+    };
+
+    // SAH bins along the split axis.
+    struct Bins
+    {
+        FloatBox boxes[bin_count];            ///< Bounds of the primitives of every bin.
+        std::uint32_t counts[bin_count] = {}; ///< Number of primitives of every bin.
+
+        void merge(const Bins &other)
+        {
+            for (int bin = 0; bin < bin_count; ++bin)
+            {
+                boxes[bin].expand(other.boxes[bin]);
+                counts[bin] += other.counts[bin];
+            }
+        }
+    };
+
+    // Reduce a range: fill(state, first, last) on chunks (one state per thread), then merge the states.
+    // The reductions used (bounds, counts) are exact, so the result does not depend on the schedule.
+    template <typename State, typename Fill, typename Merge>
+    State reduce_range(std::uint32_t begin, std::uint32_t end, ThreadPool *pool, const Fill &fill, const Merge &merge)
+    {
+        State state;
+        if (pool == nullptr || end - begin <= chunk_size)
+        {
+            fill(state, begin, end);
+            return state;
+        }
+        std::vector<State> partial_states(pool->size());
+        pool->parallel_for(end - begin, chunk_size, [&](std::size_t first, std::size_t last, unsigned thread)
+                           { fill(partial_states[thread], begin + static_cast<std::uint32_t>(first), begin + static_cast<std::uint32_t>(last)); });
+        for (const State &partial : partial_states)
+        {
+            merge(state, partial);
+        }
+        return state;
+    }
+
+    // Stable partition of a range through a scratch buffer (the same result with or without a pool).
+    template <typename T, typename Predicate>
+    std::uint32_t stable_partition(std::vector<T> &items, std::vector<T> &scratch, std::uint32_t begin, std::uint32_t end, const Predicate &goes_left, ThreadPool *pool)
+    {
+        const std::size_t count = end - begin;
+        if (pool == nullptr || count <= chunk_size)
+        {
+            std::uint32_t left = begin;
+            std::uint32_t right = begin;
+            for (std::uint32_t i = begin; i < end; ++i)
+            {
+                if (goes_left(items[i]))
+                {
+                    items[left++] = items[i];
+                }
+                else
+                {
+                    scratch[right++] = items[i];
+                }
+            }
+            std::copy(scratch.begin() + begin, scratch.begin() + right, items.begin() + left);
+            return left - begin;
+        }
+
+        // Count the left items of every chunk, then scatter the chunks to their places
+        const std::size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+        std::vector<std::uint32_t> left_offsets(chunk_count + 1, 0);
+        pool->parallel_for(chunk_count, 1, [&](std::size_t first, std::size_t last, unsigned)
+                           {
+            for (std::size_t chunk = first; chunk < last; ++chunk)
+            {
+                std::uint32_t lefts = 0;
+                for (std::size_t i = begin + chunk * chunk_size; i < std::min<std::size_t>(end, begin + (chunk + 1) * chunk_size); ++i)
+                {
+                    lefts += goes_left(items[i]) ? 1 : 0;
+                }
+                left_offsets[chunk + 1] = lefts;
+            } });
+        for (std::size_t chunk = 0; chunk < chunk_count; ++chunk)
+        {
+            left_offsets[chunk + 1] += left_offsets[chunk];
+        }
+        const std::uint32_t left_count = left_offsets[chunk_count];
+        pool->parallel_for(chunk_count, 1, [&](std::size_t first, std::size_t last, unsigned)
+                           {
+            for (std::size_t chunk = first; chunk < last; ++chunk)
+            {
+                std::size_t left = begin + left_offsets[chunk];
+                std::size_t right = begin + left_count + chunk * chunk_size - left_offsets[chunk];
+                for (std::size_t i = begin + chunk * chunk_size; i < std::min<std::size_t>(end, begin + (chunk + 1) * chunk_size); ++i)
+                {
+                    scratch[goes_left(items[i]) ? left++ : right++] = items[i];
+                }
+            } });
+        pool->parallel_for(count, chunk_size, [&](std::size_t first, std::size_t last, unsigned)
+                           { std::copy(scratch.begin() + begin + first, scratch.begin() + begin + last, items.begin() + begin + first); });
+        return left_count;
+    }
+
+    // State shared by the tasks of a build.
+    struct BuildContext
+    {
+        const std::vector<Aabb> &bounds;       ///< Bounds of the primitives.
+        std::vector<std::uint32_t> &indices;   ///< Primitive indices, reordered by the splits.
+        BvhBuildMethod method;                 ///< Split strategy.
+        std::vector<Vec3> centroids;           ///< Centroid of every primitive (median and Morton builders).
+        std::vector<std::uint32_t> codes;      ///< Morton code of indices[k] (Morton builder).
+        std::vector<SahPrimitive> primitives;  ///< Primitives in their current order (SAH builder, copied to indices at the leaves).
+        std::vector<SahPrimitive> scratch;     ///< Partition buffer (SAH builder).
+
+        // Initial order and per-primitive data of the split strategy.
+        void prepare(ThreadPool &pool)
+        {
+            const std::size_t count = bounds.size();
+            if (method == BvhBuildMethod::BinnedSah)
+            {
+                primitives.resize(count);
+                scratch.resize(count);
+                pool.parallel_for(count, chunk_size, [&](std::size_t begin, std::size_t end, unsigned)
+                                  {
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        SahPrimitive &primitive = primitives[i];
+                        for (int axis = 0; axis < 3; ++axis)
+                        {
+                            primitive.lower[axis] = round_down(bounds[i].min[axis]);
+                            primitive.upper[axis] = round_up(bounds[i].max[axis]);
+                        }
+                        primitive.index = static_cast<std::uint32_t>(i);
+                        primitive.padding = 0;
+                    } });
+                return;
+            }
+
+            centroids.resize(count);
+            pool.parallel_for(count, chunk_size, [&](std::size_t begin, std::size_t end, unsigned)
+                              {
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    centroids[i] = bounds[i].centroid();
+                    indices[i] = static_cast<std::uint32_t>(i);
+                } });
+
+            if (method == BvhBuildMethod::Morton)
+            {
+                // 10 bits per axis over the centroid bounds, sorted with the primitive index in the low half
+                const Aabb box = centroid_bounds(0, static_cast<std::uint32_t>(count), &pool);
+                const Vec3 extent = box.extent();
+                std::vector<std::uint64_t> pairs(count);
+                pool.parallel_for(count, chunk_size, [&](std::size_t begin, std::size_t end, unsigned)
+                                  {
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        std::uint32_t code = 0;
+                        for (int axis = 0; axis < 3; ++axis)
+                        {
+                            const double x = extent[axis] > 0.0 ? (centroids[i][axis] - box.min[axis]) / extent[axis] : 0.0;
+                            code = (code << 1) | spread_bits(static_cast<std::uint32_t>(std::min(1023.0, x * 1024.0)));
+                        }
+                        pairs[i] = static_cast<std::uint64_t>(code) << 32 | i;
+                    } });
+                radix_sort(pairs, 32, 30, pool);
+                codes.resize(count);
+                pool.parallel_for(count, chunk_size, [&](std::size_t begin, std::size_t end, unsigned)
+                                  {
+                    for (std::size_t k = begin; k < end; ++k)
+                    {
+                        indices[k] = static_cast<std::uint32_t>(pairs[k]);
+                        codes[k] = static_cast<std::uint32_t>(pairs[k] >> 32);
+                    } });
+            }
+        }
+
+        // Write the final primitive order of a leaf.
+        void finish_leaf(std::uint32_t begin, std::uint32_t end)
+        {
+            if (method == BvhBuildMethod::BinnedSah)
+            {
+                for (std::uint32_t i = begin; i < end; ++i)
+                {
+                    indices[i] = primitives[i].index;
+                }
+            }
+        }
+
+        // Bounds of the centroids of a range (on the pool if given).
+        Aabb centroid_bounds(std::uint32_t begin, std::uint32_t end, ThreadPool *pool) const
+        {
+            return reduce_range<Aabb>(
+                begin, end, pool, [&](Aabb &box, std::uint32_t first, std::uint32_t last)
+                {
+                    for (std::uint32_t i = first; i < last; ++i)
+                    {
+                        box.expand(centroids[indices[i]]);
+                    } },
+                [](Aabb &box, const Aabb &partial)
+                { box.expand(partial); });
+        }
+
+        // Split a range with the strategy of the build (on the pool if given).
+        Split split(std::uint32_t begin, std::uint32_t end, int depth, ThreadPool *pool)
+        {
+            switch (method)
+            {
+            case BvhBuildMethod::BinnedSah:
+                return split_sah(begin, end, depth, pool);
+            case BvhBuildMethod::Morton:
+                return split_morton(begin, end);
+            default:
+                return split_median(begin, end);
+            }
+        }
+
+        // Median split along the largest axis of the centroid bounds
+        // (when every centroid coincides, the current order is split in half).
+        Split split_median(std::uint32_t begin, std::uint32_t end)
+        {
+            const Aabb box = centroid_bounds(begin, end, nullptr);
+            const int axis = box.largest_axis();
+            const std::uint32_t middle = begin + (end - begin) / 2;
+            if (box.extent()[axis] > 0.0)
+            {
+                std::nth_element(indices.begin() + begin, indices.begin() + middle, indices.begin() + end,
+                                 [&](std::uint32_t a, std::uint32_t b)
+                                 { return centroids[a][axis] < centroids[b][axis]; });
+            }
+            return {middle, axis};
+        }
+
+        // Binned SAH split: the bin boundary minimising area(left) * count(left) + area(right) * count(right).
+        Split split_sah(std::uint32_t begin, std::uint32_t end, int depth, ThreadPool *pool)
+        {
+            const FloatBox box = reduce_range<FloatBox>(
+                begin, end, pool, [&](FloatBox &centroid_box, std::uint32_t first, std::uint32_t last)
+                {
+                    for (std::uint32_t i = first; i < last; ++i)
+                    {
+                        const float centroid[3] = {primitives[i].centroid(0), primitives[i].centroid(1), primitives[i].centroid(2)};
+                        centroid_box.expand(centroid, centroid);
+                    } },
+                [](FloatBox &centroid_box, const FloatBox &partial)
+                { centroid_box.expand(partial); });
+            int axis = 0;
+            for (int k = 1; k < 3; ++k)
+            {
+                axis = box.upper[k] - box.lower[k] > box.upper[axis] - box.lower[axis] ? k : axis;
+            }
+            const float extent = box.upper[axis] - box.lower[axis];
+            const std::uint32_t middle = begin + (end - begin) / 2;
+            if (!(extent > 0.0f))
+            {
+                return {middle, axis}; // every centroid coincides
+            }
+
+            // Too deep: median split, which halves the range
+            if (depth >= max_sah_depth)
+            {
+                std::nth_element(primitives.begin() + begin, primitives.begin() + middle, primitives.begin() + end,
+                                 [axis](const SahPrimitive &a, const SahPrimitive &b)
+                                 { return a.centroid(axis) < b.centroid(axis); });
+                return {middle, axis};
+            }
+
+            // Bins along the largest axis of the centroid bounds only (three times less work than every axis)
+            const float scale = bin_count / extent;
+            auto bin_of = [&](const SahPrimitive &primitive)
+            {
+                return std::min(bin_count - 1, static_cast<int>((primitive.centroid(axis) - box.lower[axis]) * scale));
+            };
+            const Bins bins = reduce_range<Bins>(
+                begin, end, pool, [&](Bins &partial, std::uint32_t first, std::uint32_t last)
+                {
+                    for (std::uint32_t i = first; i < last; ++i)
+                    {
+                        const int bin = bin_of(primitives[i]);
+                        partial.boxes[bin].expand(primitives[i].lower, primitives[i].upper);
+                        ++partial.counts[bin];
+                    } },
+                [](Bins &total, const Bins &partial)
+                { total.merge(partial); });
+
+            // Sweep the bin boundaries
+            double right_area[bin_count];
+            std::uint32_t right_count[bin_count];
+            FloatBox right;
+            std::uint32_t count = 0;
+            for (int bin = bin_count - 1; bin > 0; --bin)
+            {
+                right.expand(bins.boxes[bin]);
+                count += bins.counts[bin];
+                right_area[bin] = count > 0 ? right.surface_area() : 0.0;
+                right_count[bin] = count;
+            }
+            double best_cost = std::numeric_limits<double>::infinity();
+            int best_bin = 0;
+            FloatBox left;
+            count = 0;
+            for (int bin = 1; bin < bin_count; ++bin)
+            {
+                left.expand(bins.boxes[bin - 1]);
+                count += bins.counts[bin - 1];
+                if (count == 0 || right_count[bin] == 0)
+                {
+                    continue;
+                }
+                const double cost = count * left.surface_area() + right_count[bin] * right_area[bin];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_bin = bin;
+                }
+            }
+
+            const std::uint32_t left_count = stable_partition(primitives, scratch, begin, end, [&](const SahPrimitive &primitive)
+                                                              { return bin_of(primitive) < best_bin; },
+                                                              pool);
+            return {begin + left_count, axis};
+        }
+
+        // Morton split: first primitive whose code has the highest differing bit of the range set.
+        Split split_morton(std::uint32_t begin, std::uint32_t end) const
+        {
+            const std::uint32_t difference = codes[begin] ^ codes[end - 1];
+            if (difference == 0)
+            {
+                return {begin + (end - begin) / 2, 0}; // identical codes
+            }
+            int bit = 31;
+            while (((difference >> bit) & 1) == 0)
+            {
+                --bit;
+            }
+            auto middle = std::partition_point(codes.begin() + begin, codes.begin() + end, [bit](std::uint32_t code)
+                                               { return ((code >> bit) & 1) == 0; });
+            return {static_cast<std::uint32_t>(middle - codes.begin()), 2 - bit % 3}; // x owns the bits 3k + 2
+        }
+    };
+
+    // Build a subtree on the calling thread (child offsets relative to the start of `nodes`).
+    std::uint32_t build_subtree(BuildContext &context, std::vector<BvhNode> &nodes, std::uint32_t begin, std::uint32_t end, int depth)
+    {
+        const std::uint32_t node_index = static_cast<std::uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        const std::uint32_t count = end - begin;
+        if (count <= static_cast<std::uint32_t>(Bvh::max_leaf_size))
+        {
+            context.finish_leaf(begin, end);
+            Aabb box;
+            for (std::uint32_t i = begin; i < end; ++i)
+            {
+                box.expand(context.bounds[context.indices[i]]);
+            }
+            set_node_bounds(nodes[node_index], box);
+            nodes[node_index].offset = begin;
+            nodes[node_index].count = static_cast<std::uint16_t>(count);
+            nodes[node_index].axis = 0;
+            return node_index;
+        }
+
+        const Split split = context.split(begin, end, depth, nullptr);
+        build_subtree(context, nodes, begin, split.middle, depth + 1);
+        const std::uint32_t second_child = build_subtree(context, nodes, split.middle, end, depth + 1);
+
+        merge_node_bounds(nodes[node_index], nodes[node_index + 1], nodes[second_child]);
+        nodes[node_index].offset = second_child;
+        nodes[node_index].count = 0;
+        nodes[node_index].axis = static_cast<std::uint16_t>(split.axis);
+        return node_index;
+    }
+
+    // Node of the top of the tree, split on the whole pool.
+    struct TopNode
+    {
+        std::uint32_t begin;    ///< First primitive of the node.
+        std::uint32_t end;      ///< End of the primitives of the node.
+        int axis = 0;           ///< Split axis.
+        int left = -1;          ///< First child in the top nodes.
+        int right = -1;         ///< Second child in the top nodes.
+        int subtree = -1;       ///< Subtree rooted at this node (-1 for a split node).
+        BvhNode node{};         ///< Bounds of the node.
+        std::uint32_t size = 0; ///< Number of nodes of the tree rooted at this node.
+    };
+
+    // Subtree built by a single task.
+    struct Subtree
+    {
+        std::uint32_t begin;         ///< First primitive of the subtree.
+        std::uint32_t end;           ///< End of the primitives of the subtree.
+        int depth;                   ///< Depth of its root.
+        std::vector<BvhNode> nodes;  ///< Nodes, offsets relative to the root.
+        std::uint32_t position = 0;  ///< Position of the root in the final array.
+    };
+
+    // Split the top of the tree until the ranges are small enough for a task.
+    int build_top(BuildContext &context, std::vector<TopNode> &top, std::vector<Subtree> &subtrees, std::uint32_t begin, std::uint32_t end, int depth, ThreadPool &pool)
+    {
+        const int id = static_cast<int>(top.size());
+        top.push_back(TopNode{begin, end});
+        if (end - begin <= Bvh::subtree_size)
+        {
+            top[id].subtree = static_cast<int>(subtrees.size());
+            subtrees.push_back(Subtree{begin, end, depth, {}});
+            return id;
+        }
+
+        const Split split = context.split(begin, end, depth, &pool);
+        const int left = build_top(context, top, subtrees, begin, split.middle, depth + 1, pool);
+        const int right = build_top(context, top, subtrees, split.middle, end, depth + 1, pool);
+        top[id].axis = split.axis;
+        top[id].left = left;
+        top[id].right = right;
+        return id;
+    }
+
+    // Sizes and bounds of the top nodes, once the subtrees are built.
+    void finish_top(std::vector<TopNode> &top, const std::vector<Subtree> &subtrees, int id)
+    {
+        TopNode &node = top[id];
+        if (node.subtree >= 0)
+        {
+            node.size = static_cast<std::uint32_t>(subtrees[node.subtree].nodes.size());
+            node.node = subtrees[node.subtree].nodes[0];
+            return;
+        }
+        finish_top(top, subtrees, node.left);
+        finish_top(top, subtrees, node.right);
+        node.size = 1 + top[node.left].size + top[node.right].size;
+        merge_node_bounds(node.node, top[node.left].node, top[node.right].node);
+        node.node.count = 0;
+        node.node.axis = static_cast<std::uint16_t>(node.axis);
+    }
+
+    // Write the top nodes at their depth-first positions and record the positions of the subtrees.
+    void place_top(const std::vector<TopNode> &top, std::vector<Subtree> &subtrees, int id, std::uint32_t position, std::vector<BvhNode> &nodes)
+    {
+        const TopNode &node = top[id];
+        if (node.subtree >= 0)
+        {
+            subtrees[node.subtree].position = position;
+            return;
+        }
+        nodes[position] = node.node;
+        nodes[position].offset = position + 1 + top[node.left].size;
+        place_top(top, subtrees, node.left, position + 1, nodes);
+        place_top(top, subtrees, node.right, nodes[position].offset, nodes);
+    }
+}
+
+BvhRay::BvhRay(const Ray &ray) : t_min(ray.t_min)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        origin[axis] = ray.source[axis];
+        inv_direction[axis] = 1.0 / ray.direction[axis];
+        negative[axis] = ray.direction[axis] < 0.0;
+    }
+};
+
+// Build the hierarchy over a list of primitive bounds, on the calling thread.
+void Bvh::build(const std::vector<Aabb> &bounds)
+{
+    ThreadPool pool(1); // the calling thread only
+    build(bounds, pool, BvhBuildMethod::Median);
+};
+
+// Build the hierarchy over a list of primitive bounds with a pool of threads.
+void Bvh::build(const std::vector<Aabb> &bounds, ThreadPool &pool, BvhBuildMethod method)
+{
+    nodes.clear();
+    indices.resize(bounds.size());
+    if (bounds.empty())
+    {
+        return;
+    }
+
+    BuildContext context{bounds, indices, method, {}, {}, {}};
+    context.prepare(pool);
+
+    // Top of the tree on the whole pool, down to subtrees small enough for a single task
+    std::vector<TopNode> top;
+    std::vector<Subtree> subtrees;
+    build_top(context, top, subtrees, 0, static_cast<std::uint32_t>(bounds.size()), 0, pool);
+
+    pool.parallel_for(subtrees.size(), 1, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t k = begin; k < end; ++k)
+        {
+            Subtree &subtree = subtrees[k];
+            subtree.nodes.reserve(2 * (subtree.end - subtree.begin) / max_leaf_size + 1);
+            build_subtree(context, subtree.nodes, subtree.begin, subtree.end, subtree.depth);
+        } });
+
+    // Depth-first layout: place the top nodes and the subtrees, then copy the subtrees in parallel
+    finish_top(top, subtrees, 0);
+    nodes.resize(top[0].size);
+    place_top(top, subtrees, 0, 0, nodes);
+    pool.parallel_for(subtrees.size(), 1, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t k = begin; k < end; ++k)
+        {
+            const Subtree &subtree = subtrees[k];
+            for (std::size_t n = 0; n < subtree.nodes.size(); ++n)
+            {
+                BvhNode node = subtree.nodes[n];
+                if (node.count == 0)
+                {
+                    node.offset += subtree.position;
+                }
+                nodes[subtree.position + n] = node;
+            }
+        } });
+};
+
+// Update the node bounds after the primitives moved, keeping the topology.
+void Bvh::refit(const std::vector<Aabb> &bounds)
+{
+    // Children are stored after their parent: a reverse sweep visits them first
+    for (std::size_t n = nodes.size(); n-- > 0;)
+    {
+        BvhNode &node = nodes[n];
+        Aabb box;
+        if (node.count > 0)
+        {
+            for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                box.expand(bounds[indices[i]]);
+            }
+        }
+        else
+        {
+            for (std::uint32_t child : {static_cast<std::uint32_t>(n + 1), node.offset})
+            {
+                const BvhNode &c = nodes[child];
+                box.expand(Aabb(Vec3(c.lower[0], c.lower[1], c.lower[2]), Vec3(c.upper[0], c.upper[1], c.upper[2])));
+            }
+        }
+        set_node_bounds(node, box);
+    }
+};
+
+// Bounds of the whole hierarchy.
+Aabb Bvh::bounds() const
+{
+    if (nodes.empty())
+    {
+        return Aabb();
+    }
+    const BvhNode &root = nodes[0];
+    return Aabb(Vec3(root.lower[0], root.lower[1], root.lower[2]), Vec3(root.upper[0], root.upper[1], root.upper[2]));
+};
@@ -0,0 +1,110 @@
+// -*- lsst-c++ -*-
+/**
+ * @file bvh4.cpp
+ * @brief Implementation of the Bvh4 class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "bvh4.hpp"
+
+#include <limits>
+
+namespace
+{
+    /**
+     * @brief Surface area of the bounds of a binary node (collapse priority).
+     * @param node The considered node.
+     * @return Half the surface area of the node bounds.
+     */
+    float half_area(const BvhNode &node)
+    {
+        const float dx = node.upper[0] - node.lower[0];
+        const float dy = node.upper[1] - node.lower[1];
+        const float dz = node.upper[2] - node.lower[2];
+        return dx * dy + dy * dz + dz * dx;
+    };
+
+    /**
+     * @brief Collapse the binary subtree rooted at a node into wide nodes appended to `wide`.
+     * @param binary The binary nodes.
+     * @param root Index of the binary node to collapse (interior, or the root leaf of a one-leaf tree).
+     * @param wide The wide nodes (output).
+     * @return The index of the wide node.
+     */
+    std::uint32_t collapse(const std::vector<BvhNode> &binary, std::uint32_t root, std::vector<Bvh4Node> &wide)
+    {
+        // Children: the two of the binary node, then open the largest interior child until there are four
+        std::uint32_t children[Bvh4::width];
+        int child_count = 0;
+        if (binary[root].count > 0)
+        {
+            children[child_count++] = root;
+        }
+        else
+        {
+            children[child_count++] = root + 1;
+            children[child_count++] = binary[root].offset;
+        }
+        while (child_count < Bvh4::width)
+        {
+            int largest = -1;
+            for (int k = 0; k < child_count; ++k)
+            {
+                if (binary[children[k]].count == 0 && (largest < 0 || half_area(binary[children[k]]) > half_area(binary[children[largest]])))
+                {
+                    largest = k;
+                }
+            }
+            if (largest < 0)
+            {
+                break;
+            }
+            const std::uint32_t opened = children[largest];
+            children[largest] = opened + 1;
+            children[child_count++] = binary[opened].offset;
+        }
+
+        // The node is appended before its interior children (depth-first order)
+        const std::uint32_t index = static_cast<std::uint32_t>(wide.size());
+        wide.emplace_back();
+        Bvh4Node node{};
+        for (int k = 0; k < Bvh4::width; ++k)
+        {
+            if (k >= child_count)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    node.lower[axis][k] = std::numeric_limits<float>::infinity();
+                    node.upper[axis][k] = -std::numeric_limits<float>::infinity();
+                }
+                continue;
+            }
+            const BvhNode &child = binary[children[k]];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                node.lower[axis][k] = child.lower[axis];
+                node.upper[axis][k] = child.upper[axis];
+            }
+            node.count[k] = child.count;
+            node.child[k] = child.count > 0 ? child.offset : collapse(binary, children[k], wide);
+        }
+        wide[index] = node;
+        return index;
+    };
+}
+
+// Collapse a binary hierarchy into 4-wide nodes.
+void Bvh4::build(const Bvh &bvh)
+{
+    nodes.clear();
+    indices = bvh.indices;
+    if (bvh.empty())
+    {
+        return;
+    }
+    nodes.reserve(bvh.nodes.size() / 2 + 1);
+    collapse(bvh.nodes, 0, nodes);
+};
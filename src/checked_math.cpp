@@ -0,0 +1,46 @@
+// -*- lsst-c++ -*-
+/**
+ * @file checked_math.cpp
+ * @brief Implementation of the degenerate math counters.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "checked_math.hpp"
+
+#include <atomic>
+#include <iostream>
+
+namespace
+{
+    std::atomic<std::size_t> counters[static_cast<int>(DegenerateMath::Count)] = {};
+
+    const char *const names[static_cast<int>(DegenerateMath::Count)] = {
+        "divisions by zero",
+        "normalizations of a zero-length vector",
+        "ray evaluations at t <= 0"};
+}
+
+void report_degenerate_math(DegenerateMath kind)
+{
+    counters[static_cast<int>(kind)].fetch_add(1, std::memory_order_relaxed);
+};
+
+std::size_t degenerate_math_count(DegenerateMath kind)
+{
+    return counters[static_cast<int>(kind)].load(std::memory_order_relaxed);
+};
+
+void print_degenerate_math_report(std::ostream &os)
+{
+    for (int kind = 0; kind < static_cast<int>(DegenerateMath::Count); ++kind)
+    {
+        std::size_t count = counters[kind].load(std::memory_order_relaxed);
+        if (count > 0)
+        {
+            os << "Warning: " << count << " " << names[kind] << ".\n";
+        }
+    }
+};
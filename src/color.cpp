@@ -12,6 +12,8 @@
  */
 #include "color.hpp"
 
+#include <algorithm>
+
 Color Color::as_bytes() const
 {
     return Color(
@@ -0,0 +1,171 @@
+// -*- lsst-c++ -*-
+/**
+ * @file denoiser.cpp
+ * @brief Implementation of the Denoiser class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "denoiser.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    constexpr float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16}; ///< B3-spline taps.
+
+    using Planes = std::array<std::vector<float>, 3>;
+
+    /**
+     * @brief Inverse squared tolerances of one pass.
+     */
+    struct PassWeights
+    {
+        int step;           ///< Spacing of the taps in pixels.
+        float color;        ///< 1 / sigma_color².
+        float normal;       ///< 1 / sigma_normal².
+        float albedo;       ///< 1 / sigma_albedo².
+        float depth;        ///< 1 / (sigma_depth * step)².
+    };
+
+    // One à-trous pass over the pixels [x0, x1) x [y0, y1).
+    void filter_tile(const Planes &input, Planes &output, const AovBuffers &aovs, const PassWeights &weights, int x0, int y0, int x1, int y1)
+    {
+        const int width = aovs.width;
+        const int height = aovs.height;
+        for (int j = y0; j < y1; ++j)
+        {
+            for (int i = x0; i < x1; ++i)
+            {
+                const std::size_t p = static_cast<std::size_t>(j) * width + i;
+                const float depth_p = aovs.depth[p];
+                const float inverse_depth = 1.0f / std::max(depth_p, 1e-6f);
+
+                float sum[3] = {0.0f, 0.0f, 0.0f};
+                float weight_sum = 0.0f;
+                for (int dy = -2; dy <= 2; ++dy)
+                {
+                    const int y = j + dy * weights.step;
+                    if (y < 0 || y >= height)
+                    {
+                        continue;
+                    }
+                    for (int dx = -2; dx <= 2; ++dx)
+                    {
+                        const int x = i + dx * weights.step;
+                        if (x < 0 || x >= width)
+                        {
+                            continue;
+                        }
+                        const std::size_t q = static_cast<std::size_t>(y) * width + x;
+
+                        float color_distance = 0.0f, normal_distance = 0.0f, albedo_distance = 0.0f;
+                        for (int channel = 0; channel < 3; ++channel)
+                        {
+                            const float dc = input[channel][p] - input[channel][q];
+                            const float dn = aovs.normal[channel][p] - aovs.normal[channel][q];
+                            const float da = aovs.albedo[channel][p] - aovs.albedo[channel][q];
+                            color_distance += dc * dc;
+                            normal_distance += dn * dn;
+                            albedo_distance += da * da;
+                        }
+                        const float dz = (depth_p - aovs.depth[q]) * inverse_depth;
+
+                        const float weight = kernel[dy + 2] * kernel[dx + 2] *
+                                             std::exp(-(color_distance * weights.color + normal_distance * weights.normal +
+                                                        albedo_distance * weights.albedo + dz * dz * weights.depth));
+                        for (int channel = 0; channel < 3; ++channel)
+                        {
+                            sum[channel] += weight * input[channel][q];
+                        }
+                        weight_sum += weight;
+                    }
+                }
+                // The center tap has weight 3/8 * 3/8, the sum is never zero
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    output[channel][p] = sum[channel] / weight_sum;
+                }
+            }
+        }
+    }
+}
+
+Denoiser::Denoiser(const DenoiseSettings &settings) : settings(settings) {}
+
+// Denoise the pixels of the screen.
+void Denoiser::apply(Screen &screen, const AovBuffers &aovs, ThreadPool &pool) const
+{
+    if (aovs.width != screen.width_resolution || aovs.height != screen.height_resolution ||
+        !aovs.has(AovBuffers::Depth | AovBuffers::Normal | AovBuffers::Albedo))
+    {
+        throw std::invalid_argument("Denoiser: depth, normal and albedo buffers of the screen size are required.");
+    }
+    if (screen.pixels.memory_budget() != 0)
+    {
+        throw std::invalid_argument("Denoiser: the passes hold whole frames, they do not fit in a memory budget.");
+    }
+    const int width = screen.width_resolution;
+    const int height = screen.height_resolution;
+    const std::size_t size = static_cast<std::size_t>(width) * height;
+
+    Planes current, next;
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        current[channel].resize(size);
+        next[channel].resize(size);
+    }
+    pool.parallel_for(height, 16, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t j = begin; j < end; ++j)
+        {
+            for (int i = 0; i < width; ++i)
+            {
+                const Color &color = screen.pixels(i, static_cast<int>(j));
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    current[channel][j * width + i] = static_cast<float>(color[channel]);
+                }
+            }
+        } });
+
+    const int tile_size = Framebuffer::tile_size;
+    const int tiles_x = (width + tile_size - 1) / tile_size;
+    const int tiles_y = (height + tile_size - 1) / tile_size;
+    for (int iteration = 0; iteration < settings.iterations; ++iteration)
+    {
+        const int step = 1 << iteration;
+        const double sigma_color = settings.sigma_color / step;
+        const double sigma_depth = settings.sigma_depth * step;
+        const PassWeights weights = {step, static_cast<float>(1.0 / (sigma_color * sigma_color)),
+                                     static_cast<float>(1.0 / (settings.sigma_normal * settings.sigma_normal)),
+                                     static_cast<float>(1.0 / (settings.sigma_albedo * settings.sigma_albedo)),
+                                     static_cast<float>(1.0 / (sigma_depth * sigma_depth))};
+        pool.parallel_for(static_cast<std::size_t>(tiles_x) * tiles_y, 1, [&](std::size_t begin, std::size_t end, unsigned)
+                          {
+            for (std::size_t tile = begin; tile < end; ++tile)
+            {
+                const int x0 = static_cast<int>(tile % tiles_x) * tile_size;
+                const int y0 = static_cast<int>(tile / tiles_x) * tile_size;
+                filter_tile(current, next, aovs, weights, x0, y0, std::min(x0 + tile_size, width), std::min(y0 + tile_size, height));
+            } });
+        std::swap(current, next);
+    }
+
+    pool.parallel_for(height, 16, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t j = begin; j < end; ++j)
+        {
+            for (int i = 0; i < width; ++i)
+            {
+                const std::size_t p = j * width + i;
+                screen.pixels(i, static_cast<int>(j)) = Color(current[0][p], current[1][p], current[2][p]);
+            }
+        } });
+};
@@ -1,38 +1,35 @@
 #include "elements.hpp"
+#include "transform.hpp"
 
-Sphere::Sphere(const Vec3 &c, double r, const Material &mat) : Element(mat, c), radius(std::fmax(0, r)) {}
+void Element::set_transform(const Transform &)
+{
+    throw std::logic_error("Element::set_transform: this element type cannot be animated.");
+}
 
-Intersection Sphere::intersect(const Ray &ray) const
+Sphere::Sphere(const Vec3 &c, double r, const Material &mat) : Element(mat, c), radius(std::fmax(0, r)), rest_center(c), rest_radius(radius), radius_squared(radius * radius) {}
+
+void Sphere::set_transform(const Transform &transform)
 {
-    Vec3 oc = ray.source - center;
-    double a = ray.direction.dot(ray.direction);
-    double b = 2.0 * oc.dot(ray.direction);
-    double c = oc.dot(oc) - radius * radius;
-    double discriminant = b * b - 4 * a * c;
+    center = transform.transform_point(rest_center);
+    radius = rest_radius * transform.transform_vector(Vec3(1.0, 0.0, 0.0)).norm();
+    radius_squared = radius * radius;
+}
 
-    if (discriminant > 0)
+Intersection Sphere::intersect(const Ray &ray) const
+{
+    Ray interval_ray = ray;
+    Intersection hit;
+    if (intersect_closest(interval_ray, hit))
     {
-        double sqrtDiscriminant = std::sqrt(discriminant);
-        double t1 = (-b - sqrtDiscriminant) / (2.0 * a);
-        double t2 = (-b + sqrtDiscriminant) / (2.0 * a);
-
-        // Find the leastest positive solution
-        if (t1 > 0 && t2 > 0)
-        {
-            double t = std::min(t1, t2);
-            return Intersection(ray.at(t), t, shared_from_this());
-        }
-        else if (t1 > 0)
-        {
-            return Intersection(ray.at(t1), t1, shared_from_this());
-        }
-        else if (t2 > 0)
-        {
-            return Intersection(ray.at(t2), t2, shared_from_this());
-        }
+        hit.point = ray.at(hit.t);
     }
+    return hit;
+}
 
-    return Intersection();
+Aabb Sphere::bounds() const
+{
+    Vec3 extent(radius, radius, radius);
+    return Aabb(center - extent, center + extent);
 }
 
 Vec3 Sphere::get_normal(const Vec3 &point) const
@@ -0,0 +1,344 @@
+// -*- lsst-c++ -*-
+/**
+ * @file framebuffer.cpp
+ * @brief Implementation of the Framebuffer class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "framebuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+Framebuffer::Framebuffer(int width, int height, std::size_t memory_budget)
+    : image_width(width), image_height(height), budget(memory_budget),
+      tiles_x((width + tile_size - 1) / tile_size), tiles_y((height + tile_size - 1) / tile_size),
+      tile_stride(0), storage_size(0), storage(nullptr), file(-1)
+{
+    // Tiles start on page boundaries so that each one can be dropped on its own
+    const std::size_t unit = std::lcm(static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)), sizeof(Color));
+    const std::size_t tile_bytes = static_cast<std::size_t>(tile_size) * tile_size * sizeof(Color);
+    tile_stride = (tile_bytes + unit - 1) / unit * unit / sizeof(Color);
+    storage_size = static_cast<std::size_t>(tiles_x) * tiles_y * tile_stride * sizeof(Color);
+    if (storage_size == 0)
+    {
+        return;
+    }
+
+    void *memory = MAP_FAILED;
+    if (memory_budget == 0 || storage_size <= memory_budget)
+    {
+        memory = ::mmap(nullptr, storage_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    else
+    {
+        // Unlinked file: it disappears with the descriptor
+        std::string name = (std::filesystem::temp_directory_path() / "path_tracing_framebuffer_XXXXXX").string();
+        std::vector<char> path(name.begin(), name.end());
+        path.push_back('\0');
+        file = ::mkstemp(path.data());
+        if (file < 0)
+        {
+            throw std::runtime_error("Framebuffer: cannot create the spill file " + name);
+        }
+        ::unlink(path.data());
+        if (::ftruncate(file, static_cast<off_t>(storage_size)) == 0)
+        {
+            memory = ::mmap(nullptr, storage_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        }
+        completed.reset(new std::atomic<std::uint32_t>[static_cast<std::size_t>(tiles_x) * tiles_y]());
+    }
+    if (memory == MAP_FAILED)
+    {
+        if (file >= 0)
+        {
+            ::close(file);
+        }
+        throw std::runtime_error("Framebuffer: cannot map " + std::to_string(storage_size) + " bytes.");
+    }
+    storage = static_cast<Color *>(memory); // zero-filled: every pixel is black
+};
+
+Framebuffer::Framebuffer(const Framebuffer &other) : Framebuffer(other.image_width, other.image_height, other.budget)
+{
+    *this = other;
+};
+
+Framebuffer::Framebuffer(Framebuffer &&other) noexcept
+    : image_width(other.image_width), image_height(other.image_height), budget(other.budget),
+      tiles_x(other.tiles_x), tiles_y(other.tiles_y), tile_stride(other.tile_stride), storage_size(other.storage_size),
+      storage(std::exchange(other.storage, nullptr)), file(std::exchange(other.file, -1)), completed(std::move(other.completed)) {}
+
+Framebuffer &Framebuffer::operator=(const Framebuffer &other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+    if (image_width != other.image_width || image_height != other.image_height)
+    {
+        return *this = Framebuffer(other);
+    }
+
+    // Tile by tile, so that spilled images never become resident as a whole
+    const std::size_t tile_count = static_cast<std::size_t>(tiles_x) * tiles_y;
+    for (std::size_t tile = 0; tile < tile_count; ++tile)
+    {
+        std::memcpy(static_cast<void *>(storage + tile * tile_stride), other.storage + tile * tile_stride, tile_stride * sizeof(Color));
+        if (is_spilled())
+        {
+            completed[tile].store(0, std::memory_order_relaxed);
+            spill(tile);
+        }
+        if (other.is_spilled())
+        {
+            other.spill(tile);
+        }
+    }
+    return *this;
+};
+
+Framebuffer &Framebuffer::operator=(Framebuffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        image_width = other.image_width;
+        image_height = other.image_height;
+        budget = other.budget;
+        tiles_x = other.tiles_x;
+        tiles_y = other.tiles_y;
+        tile_stride = other.tile_stride;
+        storage_size = other.storage_size;
+        storage = std::exchange(other.storage, nullptr);
+        file = std::exchange(other.file, -1);
+        completed = std::move(other.completed);
+    }
+    return *this;
+};
+
+Framebuffer::~Framebuffer()
+{
+    unmap();
+};
+
+// Tell that a rectangle of pixels holds its final color.
+void Framebuffer::complete(int x, int y, int w, int h)
+{
+    if (!is_spilled() || w <= 0 || h <= 0)
+    {
+        return;
+    }
+    for (int tile_y = y / tile_size; tile_y <= (y + h - 1) / tile_size; ++tile_y)
+    {
+        const int rows = std::min(y + h, (tile_y + 1) * tile_size) - std::max(y, tile_y * tile_size);
+        for (int tile_x = x / tile_size; tile_x <= (x + w - 1) / tile_size; ++tile_x)
+        {
+            const int columns = std::min(x + w, (tile_x + 1) * tile_size) - std::max(x, tile_x * tile_size);
+            const std::size_t tile = static_cast<std::size_t>(tile_y) * tiles_x + tile_x;
+            const std::uint32_t area = static_cast<std::uint32_t>(rows * columns);
+            if (completed[tile].fetch_add(area, std::memory_order_acq_rel) + area == tile_area(tile_x, tile_y))
+            {
+                spill(tile);
+            }
+        }
+    }
+};
+
+// Tell that a range of pixels, in render order, holds its final color.
+void Framebuffer::complete_range(std::size_t first_pixel, std::size_t count)
+{
+    while (is_spilled() && count > 0)
+    {
+        // One row of a tile at a time
+        int i, j;
+        render_order_pixel(first_pixel, i, j);
+        const int tile_end = std::min(image_width, (i / tile_size + 1) * tile_size);
+        const int columns = static_cast<int>(std::min<std::size_t>(tile_end - i, count));
+        complete(i, j, columns, 1);
+        first_pixel += columns;
+        count -= columns;
+    }
+};
+
+// Number of tiles a renderer may have in flight at once.
+std::size_t Framebuffer::tiles_in_flight() const
+{
+    if (!is_spilled())
+    {
+        return tile_count();
+    }
+    return std::max<std::size_t>(1, budget / (tile_stride * sizeof(Color)));
+};
+
+// Number of rows a row-major writer should go through at a time.
+int Framebuffer::band_height() const
+{
+    int rows = tile_size;
+    while (is_spilled() && rows > 1 && static_cast<std::size_t>(rows) * image_width * 16 > budget)
+    {
+        rows /= 2;
+    }
+    return rows;
+};
+
+// Rectangle of pixels of a tile.
+void Framebuffer::tile_rectangle(std::size_t tile, int &x, int &y, int &w, int &h) const
+{
+    const int tile_x = static_cast<int>(tile % tiles_x);
+    const int tile_y = static_cast<int>(tile / tiles_x);
+    x = tile_x * tile_size;
+    y = tile_y * tile_size;
+    w = std::min(tile_size, image_width - x);
+    h = std::min(tile_size, image_height - y);
+};
+
+// Position of a pixel in render order.
+void Framebuffer::render_order_pixel(std::size_t pixel, int &i, int &j) const
+{
+    if (!is_spilled())
+    {
+        i = static_cast<int>(pixel % image_width);
+        j = static_cast<int>(pixel / image_width);
+        return;
+    }
+    // Every row of tiles but the last one holds tile_size rows of the image
+    const std::size_t row_of_tiles = static_cast<std::size_t>(tile_size) * image_width;
+    const int tile_y = static_cast<int>(pixel / row_of_tiles);
+    const int rows = std::min(tile_size, image_height - tile_y * tile_size);
+    const std::size_t offset = pixel - tile_y * row_of_tiles;
+    const int tile_x = static_cast<int>(offset / (static_cast<std::size_t>(tile_size) * rows));
+    const int in_tile = static_cast<int>(offset - static_cast<std::size_t>(tile_x) * tile_size * rows);
+    const int columns = std::min(tile_size, image_width - tile_x * tile_size);
+    i = tile_x * tile_size + in_tile % columns;
+    j = tile_y * tile_size + in_tile / columns;
+};
+
+// Number of pixels that can be rendered, in render order, within the tiles in flight.
+std::size_t Framebuffer::render_order_limit(std::size_t first_pixel) const
+{
+    const std::size_t pixel_count = static_cast<std::size_t>(image_width) * image_height;
+    if (!is_spilled() || first_pixel >= pixel_count)
+    {
+        return pixel_count - std::min(first_pixel, pixel_count);
+    }
+    int i, j;
+    render_order_pixel(first_pixel, i, j);
+    const std::size_t tile = static_cast<std::size_t>(j / tile_size) * tiles_x + i / tile_size;
+    return tile_start(std::min(tile + tiles_in_flight(), tile_count())) - first_pixel;
+};
+
+// Copy pixels of a row, one tile at a time.
+void Framebuffer::read_row(int x, int j, int count, Color *colors) const
+{
+    while (count > 0)
+    {
+        const int columns = std::min(count, (x / tile_size + 1) * tile_size - x);
+        const std::size_t bytes = static_cast<std::size_t>(columns) * sizeof(Color);
+        if (!is_spilled())
+        {
+            std::memcpy(static_cast<void *>(colors), storage + index(x, j), bytes);
+        }
+        else
+        {
+            char *output = reinterpret_cast<char *>(colors);
+            off_t offset = static_cast<off_t>(index(x, j) * sizeof(Color));
+            for (std::size_t done = 0; done < bytes;)
+            {
+                const ssize_t received = ::pread(file, output + done, bytes - done, offset + static_cast<off_t>(done));
+                if (received <= 0)
+                {
+                    throw std::runtime_error("Framebuffer: cannot read the spill file.");
+                }
+                done += static_cast<std::size_t>(received);
+            }
+        }
+        x += columns;
+        colors += columns;
+        count -= columns;
+    }
+};
+
+// Spill the pages holding only rows a writer is done with.
+void Framebuffer::release_rows(int begin_row, int end_row) const
+{
+    if (!is_spilled() || begin_row >= end_row)
+    {
+        return;
+    }
+    const int tile_y = begin_row / tile_size;
+    const int top = tile_y * tile_size;
+    const int bottom = std::min(image_height, top + tile_size);
+
+    // Byte range of the rows in each tile, shrunk to whole pages (the ends of the tile are page aligned)
+    const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t row_bytes = static_cast<std::size_t>(tile_size) * sizeof(Color);
+    const std::size_t first = begin_row == top ? 0 : ((begin_row - top) * row_bytes + page - 1) / page * page;
+    const std::size_t last = end_row >= bottom ? tile_stride * sizeof(Color) : (end_row - top) * row_bytes / page * page;
+    if (last <= first)
+    {
+        return;
+    }
+    for (int tile_x = 0; tile_x < tiles_x; ++tile_x)
+    {
+        const std::size_t tile = static_cast<std::size_t>(tile_y) * tiles_x + tile_x;
+        ::madvise(reinterpret_cast<char *>(storage + tile * tile_stride) + first, last - first, MADV_DONTNEED);
+    }
+};
+
+std::size_t Framebuffer::tile_start(std::size_t tile) const
+{
+    if (tile >= tile_count())
+    {
+        return static_cast<std::size_t>(image_width) * image_height;
+    }
+    int x, y, w, h;
+    tile_rectangle(tile, x, y, w, h);
+    return static_cast<std::size_t>(y) * image_width + static_cast<std::size_t>(x) * h;
+};
+
+std::uint32_t Framebuffer::tile_area(int tile_x, int tile_y) const
+{
+    const int columns = std::min(tile_size, image_width - tile_x * tile_size);
+    const int rows = std::min(tile_size, image_height - tile_y * tile_size);
+    return static_cast<std::uint32_t>(rows * columns);
+};
+
+// Drop the pages of a tile: the shared file mapping keeps their content. A read fault also maps
+// the pages around it (fault-around, 64 KiB by default), possibly at the end of the previous tile:
+// they are dropped too (the pages mapped in the next tile are dropped when it is spilled).
+void Framebuffer::spill(std::size_t tile) const
+{
+    constexpr std::size_t fault_around = 64 * 1024;
+    char *const begin = reinterpret_cast<char *>(storage);
+    const std::size_t tile_bytes = tile_stride * sizeof(Color);
+    const std::size_t first = tile * tile_bytes - std::min(tile * tile_bytes, fault_around);
+    const std::size_t last = (tile + 1) * tile_bytes;
+    ::madvise(begin + first, last - first, MADV_DONTNEED);
+};
+
+void Framebuffer::unmap()
+{
+    if (storage != nullptr)
+    {
+        ::munmap(static_cast<void *>(storage), storage_size);
+        storage = nullptr;
+    }
+    if (file >= 0)
+    {
+        ::close(file);
+        file = -1;
+    }
+};
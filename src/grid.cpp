@@ -0,0 +1,223 @@
+// -*- lsst-c++ -*-
+/**
+ * @file grid.cpp
+ * @brief Implementation of the UniformGrid class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "grid.hpp"
+#include "radix_sort.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    constexpr std::size_t primitive_grain = 1 << 12; ///< Primitives per chunk of the parallel loops.
+    constexpr std::size_t pair_grain = 1 << 16;      ///< (cell, primitive) pairs per chunk of the parallel loops.
+}
+
+// Build the grid over a list of primitive bounds.
+void UniformGrid::build(const std::vector<Aabb> &bounds, ThreadPool &pool)
+{
+    cell_offsets.clear();
+    indices.clear();
+    if (bounds.empty())
+    {
+        resolution[0] = resolution[1] = resolution[2] = 0;
+        box = Aabb();
+        return;
+    }
+
+    // Bounds of the grid and mean size of the primitives: one partial result per thread
+    std::vector<Aabb> partial_boxes(pool.size());
+    std::vector<Vec3> partial_extents(pool.size(), Vec3(0.0, 0.0, 0.0));
+    pool.parallel_for(bounds.size(), primitive_grain, [&](std::size_t begin, std::size_t end, unsigned thread)
+                      {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            partial_boxes[thread].expand(bounds[i]);
+            partial_extents[thread] += bounds[i].extent();
+        } });
+    box = Aabb();
+    Vec3 mean_extent(0.0, 0.0, 0.0);
+    for (unsigned thread = 0; thread < pool.size(); ++thread)
+    {
+        box.expand(partial_boxes[thread]);
+        mean_extent += partial_extents[thread];
+    }
+    mean_extent /= static_cast<double>(bounds.size());
+
+    // About `density` cells per primitive, as cubic as possible (flat axes get a single cell), but
+    // no smaller than half a primitive: large primitives would otherwise be referenced by many cells
+    const Vec3 extent = box.extent();
+    double volume = 1.0;
+    int dimensions = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (extent[axis] > 0.0)
+        {
+            volume *= extent[axis];
+            ++dimensions;
+        }
+    }
+    const double cells_per_unit = dimensions > 0 ? std::pow(density * bounds.size() / volume, 1.0 / dimensions) : 0.0;
+    std::size_t cell_count = 1;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double cells = std::min(extent[axis] * cells_per_unit, 2.0 * extent[axis] / mean_extent[axis]);
+        resolution[axis] = extent[axis] > 0.0 ? std::clamp(static_cast<int>(std::lround(cells)), 1, max_resolution) : 1;
+        cell_size[axis] = extent[axis] > 0.0 ? extent[axis] / resolution[axis] : 1.0;
+        cell_count *= static_cast<std::size_t>(resolution[axis]);
+    }
+
+    // Cells overlapped by a primitive: [lower, upper] along each axis
+    auto cell_range = [&](const Aabb &primitive_box, int lower[3], int upper[3])
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            lower[axis] = std::clamp(static_cast<int>(std::floor((primitive_box.min[axis] - box.min[axis]) / cell_size[axis])), 0, resolution[axis] - 1);
+            upper[axis] = std::clamp(static_cast<int>(std::floor((primitive_box.max[axis] - box.min[axis]) / cell_size[axis])), 0, resolution[axis] - 1);
+        }
+    };
+    auto for_each_cell = [&](std::size_t primitive, auto &&function)
+    {
+        int lower[3], upper[3], cell[3];
+        cell_range(bounds[primitive], lower, upper);
+        for (cell[2] = lower[2]; cell[2] <= upper[2]; ++cell[2])
+        {
+            for (cell[1] = lower[1]; cell[1] <= upper[1]; ++cell[1])
+            {
+                for (cell[0] = lower[0]; cell[0] <= upper[0]; ++cell[0])
+                {
+                    function(cell_index(cell));
+                }
+            }
+        }
+    };
+
+    // Number of cells of every primitive, then first reference of every primitive (prefix sum by chunks)
+    const std::size_t primitive_chunks = (bounds.size() + primitive_grain - 1) / primitive_grain;
+    std::vector<std::uint64_t> chunk_references(primitive_chunks + 1, 0);
+    pool.parallel_for(primitive_chunks, 1, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t chunk = begin; chunk < end; ++chunk)
+        {
+            std::uint64_t count = 0;
+            for (std::size_t i = chunk * primitive_grain; i < std::min(bounds.size(), (chunk + 1) * primitive_grain); ++i)
+            {
+                int lower[3], upper[3];
+                cell_range(bounds[i], lower, upper);
+                count += static_cast<std::uint64_t>(upper[0] - lower[0] + 1) * (upper[1] - lower[1] + 1) * (upper[2] - lower[2] + 1);
+            }
+            chunk_references[chunk + 1] = count;
+        } });
+    for (std::size_t chunk = 0; chunk < primitive_chunks; ++chunk)
+    {
+        chunk_references[chunk + 1] += chunk_references[chunk];
+    }
+    const std::uint64_t reference_count = chunk_references[primitive_chunks];
+    if (reference_count > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::length_error("UniformGrid::build: too many primitive references for 32-bit cell offsets.");
+    }
+
+    // (cell, primitive) pairs, written sequentially in primitive order
+    std::vector<std::uint64_t> pairs(reference_count);
+    pool.parallel_for(primitive_chunks, 1, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t chunk = begin; chunk < end; ++chunk)
+        {
+            std::uint64_t k = chunk_references[chunk];
+            for (std::size_t i = chunk * primitive_grain; i < std::min(bounds.size(), (chunk + 1) * primitive_grain); ++i)
+            {
+                for_each_cell(i, [&](std::size_t c)
+                              { pairs[k++] = static_cast<std::uint64_t>(c) << 32 | i; });
+            }
+        } });
+
+    // Stable radix sort on the cell: primitives stay in increasing order within a cell
+    int cell_bits = 0;
+    while ((std::uint64_t(1) << cell_bits) < cell_count)
+    {
+        ++cell_bits;
+    }
+    radix_sort(pairs, 32, cell_bits, pool);
+
+    // Cell offsets (where the cell changes in the sorted pairs) and primitive indices
+    auto cell_of = [&](std::size_t k)
+    { return static_cast<std::size_t>(pairs[k] >> 32); };
+    cell_offsets.resize(cell_count + 1);
+    indices.resize(reference_count);
+    pool.parallel_for(reference_count, pair_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t k = begin; k < end; ++k)
+        {
+            indices[k] = static_cast<std::uint32_t>(pairs[k]);
+            const std::size_t first_cell = k == 0 ? 0 : cell_of(k - 1) + 1;
+            for (std::size_t c = first_cell; c <= cell_of(k); ++c)
+            {
+                cell_offsets[c] = static_cast<std::uint32_t>(k);
+            }
+        } });
+    for (std::size_t c = reference_count == 0 ? 0 : cell_of(reference_count - 1) + 1; c <= cell_count; ++c)
+    {
+        cell_offsets[c] = static_cast<std::uint32_t>(reference_count);
+    }
+};
+
+// Start the walk of a ray: clip it to the grid and find its first cell.
+bool UniformGrid::start_walk(const Ray &ray, Walk &walk) const
+{
+    double t_enter = ray.t_min;
+    double t_leave = ray.t_max;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double inv_direction = 1.0 / ray.direction[axis];
+        double t0 = (box.min[axis] - ray.source[axis]) * inv_direction;
+        double t1 = (box.max[axis] - ray.source[axis]) * inv_direction;
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        t_enter = t0 > t_enter ? t0 : t_enter; // NaN (ray in a slab plane) keeps the previous bound
+        t_leave = t1 < t_leave ? t1 : t_leave;
+    }
+    if (!(t_enter <= t_leave))
+    {
+        return false;
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double direction = ray.direction[axis];
+        const double position = ray.source[axis] + t_enter * direction;
+        const int cell = std::clamp(static_cast<int>(std::floor((position - box.min[axis]) / cell_size[axis])), 0, resolution[axis] - 1);
+        walk.cell[axis] = cell;
+        if (direction > 0.0)
+        {
+            walk.step[axis] = 1;
+            walk.stop[axis] = resolution[axis];
+            walk.t_next[axis] = (box.min[axis] + (cell + 1) * cell_size[axis] - ray.source[axis]) / direction;
+            walk.t_delta[axis] = cell_size[axis] / direction;
+        }
+        else if (direction < 0.0)
+        {
+            walk.step[axis] = -1;
+            walk.stop[axis] = -1;
+            walk.t_next[axis] = (box.min[axis] + cell * cell_size[axis] - ray.source[axis]) / direction;
+            walk.t_delta[axis] = -cell_size[axis] / direction;
+        }
+        else
+        {
+            walk.step[axis] = 1;
+            walk.stop[axis] = resolution[axis];
+            walk.t_next[axis] = std::numeric_limits<double>::infinity();
+            walk.t_delta[axis] = std::numeric_limits<double>::infinity();
+        }
+    }
+    return true;
+};
@@ -0,0 +1,533 @@
+// -*- lsst-c++ -*-
+/**
+ * @file hdr_output.cpp
+ * @brief Implementation of the linear HDR writers.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "hdr_output.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+    constexpr std::size_t max_run = 127; ///< Longest RLE run or literal sequence (as in OpenEXR).
+
+    // Append little-endian integers to a buffer.
+    void put_u32(std::vector<unsigned char> &buffer, std::uint32_t value)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            buffer.push_back(static_cast<unsigned char>(value >> (8 * k)));
+        }
+    }
+
+    void put_u64(std::vector<unsigned char> &buffer, std::uint64_t value)
+    {
+        for (int k = 0; k < 8; ++k)
+        {
+            buffer.push_back(static_cast<unsigned char>(value >> (8 * k)));
+        }
+    }
+
+    // Read little-endian integers from a buffer.
+    std::uint64_t get_le(const unsigned char *data, int bytes)
+    {
+        std::uint64_t value = 0;
+        for (int k = bytes - 1; k >= 0; --k)
+        {
+            value = (value << 8) | data[k];
+        }
+        return value;
+    }
+
+    bool is_little_endian()
+    {
+        const std::uint16_t one = 1;
+        unsigned char first;
+        std::memcpy(&first, &one, 1);
+        return first == 1;
+    }
+
+    /**
+     * @brief Scratch buffers of a thread encoding tiles.
+     */
+    struct TileEncoder
+    {
+        std::vector<unsigned char> line;       ///< Raw scanline (R, G then B halves).
+        std::vector<unsigned char> compressed; ///< RLE-compressed scanline.
+    };
+
+    // Encode one tile: every scanline is stored raw or compressed, whichever is smaller.
+    void encode_tile(const Screen &screen, int tile_x, int tile_y, HalfCompression compression, TileEncoder &encoder, std::vector<unsigned char> &chunk)
+    {
+        const int x0 = tile_x * Framebuffer::tile_size;
+        const int y0 = tile_y * Framebuffer::tile_size;
+        const int width = std::min(Framebuffer::tile_size, screen.width_resolution - x0);
+        const int height = std::min(Framebuffer::tile_size, screen.height_resolution - y0);
+        chunk.clear();
+        for (int j = y0; j < y0 + height; ++j)
+        {
+            encoder.line.resize(static_cast<std::size_t>(width) * 6);
+            Color colors[Framebuffer::tile_size];
+            screen.pixels.read_row(x0, j, width, colors);
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                unsigned char *out = encoder.line.data() + static_cast<std::size_t>(channel) * width * 2;
+                for (int i = 0; i < width; ++i, out += 2)
+                {
+                    const std::uint16_t half = float_to_half(static_cast<float>(colors[i][channel]));
+                    out[0] = static_cast<unsigned char>(half);
+                    out[1] = static_cast<unsigned char>(half >> 8);
+                }
+            }
+
+            const std::vector<unsigned char> *stored = &encoder.line;
+            if (compression == HalfCompression::Rle)
+            {
+                rle_compress(encoder.line.data(), encoder.line.size(), encoder.compressed);
+                if (encoder.compressed.size() < encoder.line.size())
+                {
+                    stored = &encoder.compressed;
+                }
+            }
+            put_u32(chunk, static_cast<std::uint32_t>(stored->size()));
+            chunk.insert(chunk.end(), stored->begin(), stored->end());
+        }
+    }
+}
+
+// Convert a float to a half, rounding to nearest even.
+std::uint16_t float_to_half(float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const std::uint32_t sign = (bits >> 16) & 0x8000u;
+    const int exponent = static_cast<int>((bits >> 23) & 0xffu);
+    std::uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent == 0xff)
+    {
+        return static_cast<std::uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u)); // infinity or NaN
+    }
+    const int half_exponent = exponent - 127 + 15;
+    if (half_exponent >= 0x1f)
+    {
+        return static_cast<std::uint16_t>(sign | 0x7c00u); // overflow
+    }
+    if (half_exponent <= 0)
+    {
+        // Subnormal half (or zero): the implicit bit becomes explicit
+        if (half_exponent < -10)
+        {
+            return static_cast<std::uint16_t>(sign);
+        }
+        mantissa |= 0x800000u;
+        const int shift = 14 - half_exponent;
+        std::uint32_t half = mantissa >> shift;
+        const std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const std::uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u)))
+        {
+            ++half;
+        }
+        return static_cast<std::uint16_t>(sign | half);
+    }
+
+    std::uint32_t half = sign | (static_cast<std::uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    const std::uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+    {
+        ++half; // a carry into the exponent is still the correctly rounded value
+    }
+    return static_cast<std::uint16_t>(half);
+};
+
+// Convert a half to a float.
+float half_to_float(std::uint16_t half)
+{
+    const std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000u) << 16;
+    const int exponent = (half >> 10) & 0x1f;
+    std::uint32_t mantissa = half & 0x3ffu;
+    std::uint32_t bits;
+    if (exponent == 0x1f)
+    {
+        bits = sign | 0x7f800000u | (mantissa << 13); // infinity or NaN
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | (static_cast<std::uint32_t>(exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        bits = sign; // zero
+    }
+    else
+    {
+        // Subnormal half: normalise the mantissa
+        int float_exponent = 127 - 15 + 1;
+        while ((mantissa & 0x400u) == 0)
+        {
+            mantissa <<= 1;
+            --float_exponent;
+        }
+        bits = sign | (static_cast<std::uint32_t>(float_exponent) << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+};
+
+// RLE-compress a buffer like OpenEXR.
+void rle_compress(const unsigned char *data, std::size_t size, std::vector<unsigned char> &output)
+{
+    // Low bytes first, then high bytes, stored as differences to the previous byte
+    std::vector<unsigned char> bytes(size);
+    const std::size_t half_size = (size + 1) / 2;
+    for (std::size_t k = 0; k < size; ++k)
+    {
+        bytes[k % 2 == 0 ? k / 2 : half_size + k / 2] = data[k];
+    }
+    unsigned char previous = size > 0 ? bytes[0] : 0;
+    for (std::size_t k = 1; k < size; ++k)
+    {
+        const unsigned char current = bytes[k];
+        bytes[k] = static_cast<unsigned char>(current - previous + 128);
+        previous = current;
+    }
+
+    // Runs: a count c >= 0 repeats the next byte c + 1 times, a count -n copies the next n bytes
+    output.clear();
+    std::size_t start = 0;
+    while (start < size)
+    {
+        std::size_t end = start + 1;
+        while (end < size && bytes[end] == bytes[start] && end - start <= max_run)
+        {
+            ++end;
+        }
+        if (end - start >= 3)
+        {
+            output.push_back(static_cast<unsigned char>(end - start - 1));
+            output.push_back(bytes[start]);
+            start = end;
+            continue;
+        }
+
+        end = start;
+        while (end < size && end - start < max_run && !(end + 2 < size && bytes[end] == bytes[end + 1] && bytes[end] == bytes[end + 2]))
+        {
+            ++end;
+        }
+        output.push_back(static_cast<unsigned char>(-static_cast<int>(end - start)));
+        output.insert(output.end(), bytes.begin() + start, bytes.begin() + end);
+        start = end;
+    }
+};
+
+// Decompress a buffer compressed by rle_compress.
+void rle_decompress(const unsigned char *data, std::size_t size, std::size_t raw_size, std::vector<unsigned char> &output)
+{
+    // Runs, then the delta predictor, then the low and high bytes are interleaved again
+    std::vector<unsigned char> bytes;
+    bytes.reserve(raw_size);
+    std::size_t k = 0;
+    while (k < size)
+    {
+        const int count = static_cast<signed char>(data[k++]);
+        const std::size_t length = count >= 0 ? static_cast<std::size_t>(count) + 1 : static_cast<std::size_t>(-count);
+        const std::size_t stored = count >= 0 ? 1 : length;
+        if (k + stored > size || bytes.size() + length > raw_size)
+        {
+            throw std::runtime_error("rle_decompress: corrupted data.");
+        }
+        if (count >= 0)
+        {
+            bytes.insert(bytes.end(), length, data[k]);
+        }
+        else
+        {
+            bytes.insert(bytes.end(), data + k, data + k + length);
+        }
+        k += stored;
+    }
+    if (bytes.size() != raw_size)
+    {
+        throw std::runtime_error("rle_decompress: corrupted data.");
+    }
+    for (std::size_t m = 1; m < raw_size; ++m)
+    {
+        bytes[m] = static_cast<unsigned char>(bytes[m - 1] + bytes[m] - 128);
+    }
+
+    output.resize(raw_size);
+    const std::size_t half_size = (raw_size + 1) / 2;
+    for (std::size_t m = 0; m < raw_size; ++m)
+    {
+        output[m] = bytes[m % 2 == 0 ? m / 2 : half_size + m / 2];
+    }
+};
+
+// Save the screen image as a Portable float map.
+void save_image_as_pfm(const Screen &screen, const std::string &filename, ThreadPool &pool)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+
+    // Native floats: the sign of the scale gives their byte order
+    const int width = screen.width_resolution;
+    const int height = screen.height_resolution;
+    file << "PF\n"
+         << width << " " << height << "\n"
+         << (is_little_endian() ? "-1.0" : "1.0") << "\n";
+
+    // Rows go from the bottom to the top, one band of rows at a time (a row of tiles unless the image is spilled)
+    const int band_height = screen.pixels.band_height();
+    std::vector<float> band(static_cast<std::size_t>(band_height) * width * 3);
+    const int bands = (height + band_height - 1) / band_height;
+    for (int b = bands - 1; b >= 0; --b)
+    {
+        const int y0 = b * band_height;
+        const int y1 = std::min(height, y0 + band_height);
+        pool.parallel_for(y1 - y0, 1, [&](std::size_t begin, std::size_t end, unsigned)
+                          {
+            for (std::size_t row = begin; row < end; ++row)
+            {
+                float *out = band.data() + row * width * 3;
+                Color colors[Framebuffer::tile_size];
+                for (int x0 = 0; x0 < width; x0 += Framebuffer::tile_size)
+                {
+                    const int count = std::min(Framebuffer::tile_size, width - x0);
+                    screen.pixels.read_row(x0, y0 + static_cast<int>(row), count, colors);
+                    for (int i = 0; i < count; ++i)
+                    {
+                        *out++ = static_cast<float>(colors[i][0]);
+                        *out++ = static_cast<float>(colors[i][1]);
+                        *out++ = static_cast<float>(colors[i][2]);
+                    }
+                }
+            } });
+        for (int row = y1 - y0 - 1; row >= 0; --row)
+        {
+            file.write(reinterpret_cast<const char *>(band.data() + static_cast<std::size_t>(row) * width * 3), static_cast<std::streamsize>(width) * 3 * sizeof(float));
+        }
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+};
+
+// Save planar float buffers as a Portable float map.
+void save_planes_as_pfm(const std::string &filename, int width, int height, const std::vector<const float *> &planes)
+{
+    if (planes.size() != 1 && planes.size() != 3)
+    {
+        throw std::invalid_argument("save_planes_as_pfm: expected 1 or 3 planes.");
+    }
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+    file << (planes.size() == 3 ? "PF\n" : "Pf\n")
+         << width << " " << height << "\n"
+         << (is_little_endian() ? "-1.0" : "1.0") << "\n";
+
+    // Rows go from the bottom to the top, channels are interleaved
+    std::vector<float> row(static_cast<std::size_t>(width) * planes.size());
+    for (int j = height - 1; j >= 0; --j)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            for (std::size_t channel = 0; channel < planes.size(); ++channel)
+            {
+                row[i * planes.size() + channel] = planes[channel][static_cast<std::size_t>(j) * width + i];
+            }
+        }
+        file.write(reinterpret_cast<const char *>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(float)));
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+};
+
+// Save the screen image as a tiled half-float image.
+void save_image_as_half(const Screen &screen, const std::string &filename, HalfCompression compression, ThreadPool &pool)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+
+    const int tiles_x = (screen.width_resolution + Framebuffer::tile_size - 1) / Framebuffer::tile_size;
+    const int tiles_y = (screen.height_resolution + Framebuffer::tile_size - 1) / Framebuffer::tile_size;
+    std::vector<unsigned char> header = {'P', 'T', 'H', 'F'};
+    put_u32(header, 1);
+    put_u32(header, static_cast<std::uint32_t>(screen.width_resolution));
+    put_u32(header, static_cast<std::uint32_t>(screen.height_resolution));
+    put_u32(header, static_cast<std::uint32_t>(Framebuffer::tile_size));
+    put_u32(header, 3);
+    put_u32(header, compression == HalfCompression::Rle ? 1 : 0);
+    file.write(reinterpret_cast<const char *>(header.data()), static_cast<std::streamsize>(header.size()));
+
+    // The offset table is written once the tiles are placed
+    const std::streamoff table_position = file.tellp();
+    std::vector<std::uint64_t> offsets(static_cast<std::size_t>(tiles_x) * tiles_y, 0);
+    std::vector<unsigned char> table;
+    for (std::uint64_t offset : offsets)
+    {
+        put_u64(table, offset);
+    }
+    file.write(reinterpret_cast<const char *>(table.data()), static_cast<std::streamsize>(table.size()));
+
+    // The tiles are encoded in parallel, a row of them (or the tiles the memory budget holds) at a
+    // time, then written in order
+    const std::size_t tile_count = offsets.size();
+    const std::size_t group = std::min<std::size_t>(tiles_x, screen.pixels.tiles_in_flight());
+    std::vector<TileEncoder> encoders(pool.size());
+    std::vector<std::vector<unsigned char>> chunks(group);
+    for (std::size_t first = 0; first < tile_count; first += group)
+    {
+        const std::size_t count = std::min(group, tile_count - first);
+        pool.parallel_for(count, 1, [&](std::size_t begin, std::size_t end, unsigned thread)
+                          {
+            for (std::size_t k = begin; k < end; ++k)
+            {
+                const std::size_t tile = first + k;
+                encode_tile(screen, static_cast<int>(tile % tiles_x), static_cast<int>(tile / tiles_x), compression, encoders[thread], chunks[k]);
+            } });
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            offsets[first + k] = static_cast<std::uint64_t>(file.tellp());
+            file.write(reinterpret_cast<const char *>(chunks[k].data()), static_cast<std::streamsize>(chunks[k].size()));
+        }
+    }
+
+    table.clear();
+    for (std::uint64_t offset : offsets)
+    {
+        put_u64(table, offset);
+    }
+    file.seekp(table_position);
+    file.write(reinterpret_cast<const char *>(table.data()), static_cast<std::streamsize>(table.size()));
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+};
+
+// Load a tiled half-float image.
+Image load_half_image(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for reading: " + filename);
+    }
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto invalid = [&](const std::string &reason)
+    {
+        return std::runtime_error("Invalid half-float image (" + reason + "): " + filename);
+    };
+
+    const std::size_t header_size = 28;
+    if (data.size() < header_size || std::memcmp(data.data(), "PTHF", 4) != 0)
+    {
+        throw invalid("no PTHF header");
+    }
+    const std::uint64_t version = get_le(data.data() + 4, 4);
+    const std::uint64_t width = get_le(data.data() + 8, 4);
+    const std::uint64_t height = get_le(data.data() + 12, 4);
+    const std::uint64_t tile_size = get_le(data.data() + 16, 4);
+    const std::uint64_t channels = get_le(data.data() + 20, 4);
+    if (version != 1 || channels != 3 || width == 0 || height == 0 || width * height > (1u << 30) || tile_size == 0)
+    {
+        throw invalid("unsupported header");
+    }
+    const std::uint64_t tiles_x = (width + tile_size - 1) / tile_size;
+    const std::uint64_t tiles_y = (height + tile_size - 1) / tile_size;
+    if (data.size() < header_size + tiles_x * tiles_y * 8)
+    {
+        throw invalid("truncated offset table");
+    }
+
+    Image image(static_cast<int>(width), static_cast<int>(height));
+    std::vector<unsigned char> line;
+    for (std::uint64_t tile = 0; tile < tiles_x * tiles_y; ++tile)
+    {
+        const std::uint64_t x0 = tile % tiles_x * tile_size;
+        const std::uint64_t y0 = tile / tiles_x * tile_size;
+        const std::uint64_t tile_width = std::min(tile_size, width - x0);
+        const std::uint64_t tile_height = std::min(tile_size, height - y0);
+        const std::size_t raw_size = static_cast<std::size_t>(tile_width) * 6;
+        std::uint64_t offset = get_le(data.data() + header_size + tile * 8, 8);
+        for (std::uint64_t j = y0; j < y0 + tile_height; ++j)
+        {
+            if (offset + 4 > data.size())
+            {
+                throw invalid("truncated tile");
+            }
+            const std::uint64_t stored = get_le(data.data() + offset, 4);
+            offset += 4;
+            if (stored > raw_size || offset + stored > data.size())
+            {
+                throw invalid("truncated tile");
+            }
+
+            // A scanline stored with its raw size is not compressed
+            const unsigned char *halves = data.data() + offset;
+            if (stored < raw_size)
+            {
+                rle_decompress(halves, static_cast<std::size_t>(stored), raw_size, line);
+                halves = line.data();
+            }
+            offset += stored;
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                const unsigned char *in = halves + static_cast<std::size_t>(channel) * tile_width * 2;
+                for (std::uint64_t i = 0; i < tile_width; ++i, in += 2)
+                {
+                    image(static_cast<int>(x0 + i), static_cast<int>(j))[channel] = half_to_float(static_cast<std::uint16_t>(in[0] | in[1] << 8));
+                }
+            }
+        }
+    }
+    return image;
+};
+
+// Save the screen image in the format given by the extension of its name.
+void save_image(Screen &screen, const std::string &filename, const ToneMapper &tone_mapper, HalfCompression compression, ThreadPool &pool)
+{
+    auto has_extension = [&](const std::string &extension)
+    {
+        return filename.size() >= extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+    };
+    if (has_extension(".pfm"))
+    {
+        save_image_as_pfm(screen, filename, pool);
+    }
+    else if (has_extension(".half"))
+    {
+        save_image_as_half(screen, filename, compression, pool);
+    }
+    else
+    {
+        screen.save_image_as_ppm(filename, tone_mapper, pool);
+    }
+};
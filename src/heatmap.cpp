@@ -0,0 +1,127 @@
+// -*- lsst-c++ -*-
+/**
+ * @file heatmap.cpp
+ * @brief Implementation of the per-pixel cost outputs.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "heatmap.hpp"
+#include "framebuffer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    // Throw if the cost of the pixels was not recorded.
+    void check_cost(const AovBuffers &aovs, const char *function)
+    {
+        if (!aovs.has(AovBuffers::Cost))
+        {
+            throw std::invalid_argument(std::string(function) + ": the Cost channel was not recorded.");
+        }
+    }
+}
+
+// Colour of a normalised value (0 blue, 0.25 cyan, 0.5 green, 0.75 yellow, 1 red).
+std::array<unsigned char, 3> false_colour(double x)
+{
+    static const double stops[5][3] = {{0, 0, 1}, {0, 1, 1}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}};
+    x = std::clamp(x, 0.0, 1.0) * 4;
+    const int k = std::min(static_cast<int>(x), 3);
+    const double f = x - k;
+    std::array<unsigned char, 3> rgb;
+    for (int c = 0; c < 3; ++c)
+    {
+        rgb[c] = static_cast<unsigned char>(255 * (stops[k][c] + f * (stops[k + 1][c] - stops[k][c])) + 0.5);
+    }
+    return rgb;
+};
+
+// Save the cost of the pixels as a false-colour binary PPM.
+void save_cost_heatmap(const AovBuffers &aovs, const std::string &filename)
+{
+    check_cost(aovs, "save_cost_heatmap");
+
+    // 99th percentile of the costs
+    std::vector<std::uint64_t> sorted(aovs.cost);
+    double scale = 0.0;
+    if (!sorted.empty())
+    {
+        auto percentile = sorted.begin() + static_cast<std::ptrdiff_t>((sorted.size() - 1) * 99 / 100);
+        std::nth_element(sorted.begin(), percentile, sorted.end());
+        scale = *percentile > 0 ? 1.0 / static_cast<double>(*percentile) : 0.0;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+    file << "P6\n"
+         << aovs.width << " " << aovs.height << "\n255\n";
+
+    std::vector<unsigned char> row(static_cast<std::size_t>(aovs.width) * 3);
+    for (int j = 0; j < aovs.height; ++j)
+    {
+        for (int i = 0; i < aovs.width; ++i)
+        {
+            const std::array<unsigned char, 3> rgb = false_colour(aovs.cost[static_cast<std::size_t>(j) * aovs.width + i] * scale);
+            std::copy(rgb.begin(), rgb.end(), row.begin() + 3 * i);
+        }
+        file.write(reinterpret_cast<const char *>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+};
+
+// Save the cost of the tiles of the image as a CSV table.
+void save_cost_csv(const AovBuffers &aovs, const std::string &filename)
+{
+    check_cost(aovs, "save_cost_csv");
+
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+    file << "tile_x,tile_y,x,y,width,height,pixels,total_cycles,mean_cycles,max_cycles\n";
+
+    const int tile = Framebuffer::tile_size;
+    for (int y = 0; y < aovs.height; y += tile)
+    {
+        for (int x = 0; x < aovs.width; x += tile)
+        {
+            const int width = std::min(tile, aovs.width - x);
+            const int height = std::min(tile, aovs.height - y);
+            std::uint64_t total = 0;
+            std::uint64_t maximum = 0;
+            for (int j = y; j < y + height; ++j)
+            {
+                for (int i = x; i < x + width; ++i)
+                {
+                    const std::uint64_t cycles = aovs.cost[static_cast<std::size_t>(j) * aovs.width + i];
+                    total += cycles;
+                    maximum = std::max(maximum, cycles);
+                }
+            }
+            const int pixels = width * height;
+            file << x / tile << "," << y / tile << "," << x << "," << y << "," << width << "," << height << ","
+                 << pixels << "," << total << "," << static_cast<double>(total) / pixels << "," << maximum << "\n";
+        }
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+};
@@ -12,16 +12,172 @@
  */
 
 #include "image.hpp"
+#include "hdr_output.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
 // #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    // Next token of a Netpbm / PFM header (comments start with '#' and run to the end of the line).
+    std::string read_header_token(std::istream &file, const std::string &filename)
+    {
+        std::string token;
+        while (file >> token)
+        {
+            if (token[0] != '#')
+            {
+                return token;
+            }
+            std::getline(file, token);
+        }
+        throw std::runtime_error("Truncated image header: " + filename);
+    }
+
+    // Parse a number of a header.
+    double parse_header_number(const std::string &token, const std::string &filename)
+    {
+        try
+        {
+            return std::stod(token);
+        }
+        catch (const std::exception &)
+        {
+            throw std::runtime_error("Invalid value '" + token + "' in the image header: " + filename);
+        }
+    }
+
+    bool is_little_endian()
+    {
+        const std::uint16_t one = 1;
+        unsigned char first;
+        std::memcpy(&first, &one, 1);
+        return first == 1;
+    }
+}
 
 // Constructor that initializes the image with a specific width and height.
 // All pixels are set to black by default (Color(0, 0, 0)).
-Image::Image(int w, int h) : width(w), height(h), pixels(h, std::vector<Color>(w, Color(0.0, 0.0, 0.0))) {}
+Image::Image(int w, int h) : width(w), height(h), pixels(static_cast<std::size_t>(w) * h, Color(0.0, 0.0, 0.0)) {}
+
+// Load an image from a Portable pixmap (P3 or P6), a Portable float map (PF or Pf) or a tiled half-float image.
+Image Image::load(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for reading: " + filename);
+    }
+
+    // Half-float images have a binary header
+    char signature[4] = {};
+    if (file.read(signature, sizeof(signature)) && std::memcmp(signature, "PTHF", sizeof(signature)) == 0)
+    {
+        return load_half_image(filename);
+    }
+    file.clear();
+    file.seekg(0);
+
+    const std::string magic = read_header_token(file, filename);
+    if (magic != "P3" && magic != "P6" && magic != "PF" && magic != "Pf")
+    {
+        throw std::runtime_error("Unsupported image format '" + magic + "' (expected P3, P6, PF, Pf or PTHF): " + filename);
+    }
+    const double w = parse_header_number(read_header_token(file, filename), filename);
+    const double h = parse_header_number(read_header_token(file, filename), filename);
+    if (!(w >= 1 && h >= 1 && w * h <= 1 << 30))
+    {
+        throw std::runtime_error("Invalid image size in " + filename);
+    }
+    Image image(static_cast<int>(w), static_cast<int>(h));
+
+    if (magic == "PF" || magic == "Pf")
+    {
+        // Float map: the sign of the scale gives the byte order, rows go from the bottom to the top
+        const double scale = parse_header_number(read_header_token(file, filename), filename);
+        file.get(); // single whitespace ending the header
+        const int channels = magic == "PF" ? 3 : 1;
+        const bool swap_bytes = (scale < 0) != is_little_endian();
+        std::vector<float> row(static_cast<std::size_t>(image.width) * channels);
+        for (int y = image.height - 1; y >= 0; --y)
+        {
+            if (!file.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(float))))
+            {
+                throw std::runtime_error("Truncated float map: " + filename);
+            }
+            for (float &value : row)
+            {
+                if (swap_bytes)
+                {
+                    unsigned char bytes[sizeof(float)];
+                    std::memcpy(bytes, &value, sizeof(float));
+                    std::reverse(bytes, bytes + sizeof(float));
+                    std::memcpy(&value, bytes, sizeof(float));
+                }
+            }
+            for (int x = 0; x < image.width; ++x)
+            {
+                const float *pixel = row.data() + static_cast<std::size_t>(x) * channels;
+                image(x, y) = channels == 3 ? Vec3(pixel[0], pixel[1], pixel[2]) : Vec3(pixel[0], pixel[0], pixel[0]);
+            }
+        }
+        return image;
+    }
+
+    // Pixmap: values divided by the maximal value (binary samples of two bytes are big-endian)
+    const double max_value = parse_header_number(read_header_token(file, filename), filename);
+    if (!(max_value >= 1 && max_value <= 65535))
+    {
+        throw std::runtime_error("Invalid maximal value in " + filename);
+    }
+    if (magic == "P3")
+    {
+        for (int y = 0; y < image.height; ++y)
+        {
+            for (int x = 0; x < image.width; ++x)
+            {
+                double rgb[3];
+                for (double &value : rgb)
+                {
+                    if (!(file >> value))
+                    {
+                        throw std::runtime_error("Truncated pixmap: " + filename);
+                    }
+                    value /= max_value;
+                }
+                image(x, y) = Vec3(rgb[0], rgb[1], rgb[2]);
+            }
+        }
+        return image;
+    }
+    file.get(); // single whitespace ending the header
+    const int sample_size = max_value < 256 ? 1 : 2;
+    std::vector<unsigned char> row(static_cast<std::size_t>(image.width) * 3 * sample_size);
+    for (int y = 0; y < image.height; ++y)
+    {
+        if (!file.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size())))
+        {
+            throw std::runtime_error("Truncated pixmap: " + filename);
+        }
+        for (int x = 0; x < image.width; ++x)
+        {
+            double rgb[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                const unsigned char *sample = row.data() + (static_cast<std::size_t>(x) * 3 + c) * sample_size;
+                rgb[c] = (sample_size == 1 ? sample[0] : sample[0] << 8 | sample[1]) / max_value;
+            }
+            image(x, y) = Vec3(rgb[0], rgb[1], rgb[2]);
+        }
+    }
+    return image;
+}
 
 // Method to check if the given (x, y) coordinates are valid for the image.
 bool Image::valid_pixel(int x, int y) const
@@ -34,7 +190,7 @@ void Image::set_pixel(int x, int y, const Color &color)
 {
     if (valid_pixel(x, y))
     {
-        pixels[y][x] = color; // Access the pixel at (x, y) and set it to the new color.
+        (*this)(x, y) = color; // Access the pixel at (x, y) and set it to the new color.
     }
     else
     {
@@ -47,7 +203,7 @@ Color Image::get_pixel(int x, int y) const
 {
     if (valid_pixel(x, y))
     {
-        return pixels[y][x]; // Return the color of the pixel at (x, y).
+        return (*this)(x, y); // Return the color of the pixel at (x, y).
     }
     else
     {
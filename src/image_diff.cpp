@@ -0,0 +1,137 @@
+// -*- lsst-c++ -*-
+/**
+ * @file image_diff.cpp
+ * @brief Command line tool comparing two rendered images (quality gate of the regression checks).
+ *
+ * @details Loads two PPM (P3 or P6), PFM or half-float (.half) images, prints their differences
+ * (see image_metrics.hpp) and optionally writes the FLIP-like error map. The exit status is 0
+ * if every given threshold holds, 1 if one is exceeded and 2 on an error (e.g. unreadable image).
+ *
+ * Usage: image_diff REFERENCE TEST [--diff PATH] [--threads N] [--max-rmse X] [--min-psnr DB]
+ * [--max-flip X] [--max-abs X]
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "image.hpp"
+#include "image_metrics.hpp"
+#include "thread_pool.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    /**
+     * @brief Command line options of the tool.
+     */
+    struct DiffOptions
+    {
+        std::string reference;   ///< Path of the reference image.
+        std::string test;        ///< Path of the compared image.
+        std::string diff;        ///< Path of the error map (empty for none).
+        unsigned threads = 0;    ///< Number of threads (0 means one per hardware thread).
+        double max_rmse = std::numeric_limits<double>::infinity(); ///< Largest accepted RMSE.
+        double min_psnr = -std::numeric_limits<double>::infinity(); ///< Smallest accepted PSNR, in dB.
+        double max_flip = std::numeric_limits<double>::infinity(); ///< Largest accepted mean FLIP-like error.
+        double max_abs = std::numeric_limits<double>::infinity();  ///< Largest accepted channel difference.
+    };
+
+    // Parse the command line.
+    DiffOptions parse_options(int argc, char *argv[])
+    {
+        DiffOptions options;
+        int positional = 0;
+        for (int k = 1; k < argc; ++k)
+        {
+            std::string option = argv[k];
+            if (option.rfind("--", 0) != 0)
+            {
+                (positional++ == 0 ? options.reference : options.test) = option;
+                continue;
+            }
+            if (k + 1 >= argc)
+            {
+                throw std::invalid_argument("Missing value for option " + option);
+            }
+            std::string value = argv[++k];
+            if (option == "--diff")
+            {
+                options.diff = value;
+            }
+            else if (option == "--threads")
+            {
+                options.threads = static_cast<unsigned>(std::stoul(value));
+            }
+            else if (option == "--max-rmse")
+            {
+                options.max_rmse = std::stod(value);
+            }
+            else if (option == "--min-psnr")
+            {
+                options.min_psnr = std::stod(value);
+            }
+            else if (option == "--max-flip")
+            {
+                options.max_flip = std::stod(value);
+            }
+            else if (option == "--max-abs")
+            {
+                options.max_abs = std::stod(value);
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown option: " + option);
+            }
+        }
+        if (positional != 2)
+        {
+            throw std::invalid_argument("Expected two images, got " + std::to_string(positional));
+        }
+        return options;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        const DiffOptions options = parse_options(argc, argv);
+        const Image reference = Image::load(options.reference);
+        const Image test = Image::load(options.test);
+
+        ThreadPool pool(options.threads);
+        Image error_map(1, 1);
+        const ImageDifference difference = compare_images(reference, test, pool, options.diff.empty() ? nullptr : &error_map);
+        if (!options.diff.empty())
+        {
+            error_map.save_as_ppm(options.diff);
+        }
+
+        std::cout << std::setprecision(6)
+                  << "RMSE:             " << difference.rmse << "\n"
+                  << "PSNR:             " << difference.psnr << " dB\n"
+                  << "FLIP (mean/max):  " << difference.flip << " / " << difference.max_flip << "\n"
+                  << "Max abs diff:     " << difference.max_abs_difference << "\n"
+                  << "Differing pixels: " << difference.differing_pixels << " / " << static_cast<std::size_t>(reference.get_width()) * reference.get_height() << "\n";
+
+        const bool passed = difference.rmse <= options.max_rmse && difference.psnr >= options.min_psnr &&
+                            difference.flip <= options.max_flip && difference.max_abs_difference <= options.max_abs;
+        if (!passed)
+        {
+            std::cerr << "Quality threshold exceeded.\n";
+        }
+        return passed ? 0 : 1;
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << "\n"
+                  << "Usage: " << argv[0] << " REFERENCE TEST [--diff PATH] [--threads N] [--max-rmse X] [--min-psnr DB] [--max-flip X] [--max-abs X]\n";
+        return 2;
+    }
+}
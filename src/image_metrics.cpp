@@ -0,0 +1,229 @@
+// -*- lsst-c++ -*-
+/**
+ * @file image_metrics.cpp
+ * @brief Implementation of the image comparison metrics.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "image_metrics.hpp"
+#include "heatmap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    constexpr std::size_t row_grain = 4;       ///< Rows per chunk of the parallel loops.
+    constexpr double lightness_sigma = 1.0;    ///< Blur of the lightness, in pixels (contrast sensitivity).
+    constexpr double chrominance_sigma = 2.0;  ///< Blur of the chrominance, in pixels (lower acuity for colours).
+    constexpr double max_hyab = 308.0;         ///< HyAB distance between sRGB green and blue, the largest between displayable colours.
+    constexpr double colour_exponent = 0.7;    ///< Compression of the colour error (as in FLIP).
+    constexpr double feature_exponent = 0.5;   ///< Compression of the edge error (as in FLIP).
+
+    /**
+     * @brief CIELAB planes of an image (lightness, a, b), row by row.
+     */
+    using LabPlanes = std::array<std::vector<float>, 3>;
+
+    // Linear value of a displayed channel (clamped to [0, 1], sRGB transfer function).
+    double displayed_to_linear(double value)
+    {
+        value = std::clamp(value, 0.0, 1.0);
+        return value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+    };
+
+    // CIELAB companding function.
+    double lab_f(double t)
+    {
+        constexpr double delta = 6.0 / 29.0;
+        return t > delta * delta * delta ? std::cbrt(t) : t / (3 * delta * delta) + 4.0 / 29.0;
+    };
+
+    // CIELAB (D65 white) planes of an image as displayed.
+    void to_lab(const Image &image, LabPlanes &lab, ThreadPool &pool)
+    {
+        const std::size_t count = static_cast<std::size_t>(image.get_width()) * image.get_height();
+        for (auto &plane : lab)
+        {
+            plane.resize(count);
+        }
+        pool.parallel_for(image.get_height(), row_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                          {
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                for (int x = 0; x < image.get_width(); ++x)
+                {
+                    const Color &color = image(x, static_cast<int>(y));
+                    const double r = displayed_to_linear(color[0]);
+                    const double g = displayed_to_linear(color[1]);
+                    const double b = displayed_to_linear(color[2]);
+                    const double fx = lab_f((0.4124 * r + 0.3576 * g + 0.1805 * b) / 0.95047);
+                    const double fy = lab_f(0.2126 * r + 0.7152 * g + 0.0722 * b);
+                    const double fz = lab_f((0.0193 * r + 0.1192 * g + 0.9505 * b) / 1.08883);
+                    const std::size_t k = y * image.get_width() + x;
+                    lab[0][k] = static_cast<float>(116 * fy - 16);
+                    lab[1][k] = static_cast<float>(500 * (fx - fy));
+                    lab[2][k] = static_cast<float>(200 * (fy - fz));
+                }
+            } });
+    };
+
+    // Separable Gaussian blur of a plane (edges clamped), through a scratch plane.
+    void blur(std::vector<float> &plane, int width, int height, double sigma, std::vector<float> &scratch, ThreadPool &pool)
+    {
+        const int radius = static_cast<int>(std::ceil(3 * sigma));
+        std::vector<float> weights(2 * radius + 1);
+        double total = 0.0;
+        for (int k = -radius; k <= radius; ++k)
+        {
+            total += weights[k + radius] = static_cast<float>(std::exp(-0.5 * k * k / (sigma * sigma)));
+        }
+        for (float &weight : weights)
+        {
+            weight = static_cast<float>(weight / total);
+        }
+        scratch.resize(plane.size());
+
+        // Horizontal pass into the scratch plane, then vertical pass back
+        pool.parallel_for(height, row_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                          {
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                const float *row = plane.data() + y * width;
+                for (int x = 0; x < width; ++x)
+                {
+                    float sum = 0.0f;
+                    for (int k = -radius; k <= radius; ++k)
+                    {
+                        sum += weights[k + radius] * row[std::clamp(x + k, 0, width - 1)];
+                    }
+                    scratch[y * width + x] = sum;
+                }
+            } });
+        pool.parallel_for(height, row_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                          {
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    float sum = 0.0f;
+                    for (int k = -radius; k <= radius; ++k)
+                    {
+                        const std::size_t row = static_cast<std::size_t>(std::clamp(static_cast<int>(y) + k, 0, height - 1));
+                        sum += weights[k + radius] * scratch[row * width + x];
+                    }
+                    plane[y * width + x] = sum;
+                }
+            } });
+    };
+
+    // Edge strength of the lightness at a pixel (Sobel gradient of L / 100, edges clamped).
+    double edge_strength(const std::vector<float> &lightness, int width, int height, int x, int y)
+    {
+        auto at = [&](int dx, int dy)
+        {
+            const std::size_t row = static_cast<std::size_t>(std::clamp(y + dy, 0, height - 1));
+            return lightness[row * width + std::clamp(x + dx, 0, width - 1)] / 100.0;
+        };
+        const double gx = (at(1, -1) + 2 * at(1, 0) + at(1, 1) - at(-1, -1) - 2 * at(-1, 0) - at(-1, 1)) / 4;
+        const double gy = (at(-1, 1) + 2 * at(0, 1) + at(1, 1) - at(-1, -1) - 2 * at(0, -1) - at(1, -1)) / 4;
+        return std::sqrt(gx * gx + gy * gy);
+    };
+}
+
+// Compare two images.
+ImageDifference compare_images(const Image &reference, const Image &test, ThreadPool &pool, Image *error_map)
+{
+    const int width = reference.get_width();
+    const int height = reference.get_height();
+    if (test.get_width() != width || test.get_height() != height)
+    {
+        throw std::invalid_argument("compare_images: the images do not have the same size.");
+    }
+    if (error_map != nullptr)
+    {
+        *error_map = Image(width, height);
+    }
+
+    // Edge error, from the lightness before the blur
+    LabPlanes reference_lab, test_lab;
+    to_lab(reference, reference_lab, pool);
+    to_lab(test, test_lab, pool);
+    std::vector<float> feature_error(reference_lab[0].size());
+    pool.parallel_for(height, row_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t y = begin; y < end; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const double difference = std::abs(edge_strength(reference_lab[0], width, height, x, static_cast<int>(y)) - edge_strength(test_lab[0], width, height, x, static_cast<int>(y)));
+                feature_error[y * width + x] = static_cast<float>(std::pow(std::min(1.0, difference / std::sqrt(2.0)), feature_exponent));
+            }
+        } });
+
+    // Colour error, after the contrast sensitivity blur
+    std::vector<float> scratch;
+    for (LabPlanes *lab : {&reference_lab, &test_lab})
+    {
+        blur((*lab)[0], width, height, lightness_sigma, scratch, pool);
+        blur((*lab)[1], width, height, chrominance_sigma, scratch, pool);
+        blur((*lab)[2], width, height, chrominance_sigma, scratch, pool);
+    }
+
+    // Per-row sums, added in row order afterwards (independent of the number of threads)
+    std::vector<double> row_squared(height, 0.0), row_flip(height, 0.0), row_max_flip(height, 0.0), row_max_difference(height, 0.0);
+    std::vector<std::size_t> row_differing(height, 0);
+    pool.parallel_for(height, row_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t y = begin; y < end; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const Color &a = reference(x, static_cast<int>(y));
+                const Color &b = test(x, static_cast<int>(y));
+                bool differs = false;
+                for (int c = 0; c < 3; ++c)
+                {
+                    const double difference = a[c] - b[c];
+                    row_squared[y] += difference * difference;
+                    row_max_difference[y] = std::max(row_max_difference[y], std::abs(difference));
+                    differs = differs || a[c] != b[c];
+                }
+                row_differing[y] += differs ? 1 : 0;
+
+                const std::size_t k = y * width + x;
+                const double hyab = std::abs(reference_lab[0][k] - test_lab[0][k]) + std::hypot(reference_lab[1][k] - test_lab[1][k], reference_lab[2][k] - test_lab[2][k]);
+                const double colour_error = std::pow(std::min(1.0, hyab / max_hyab), colour_exponent);
+                const double error = std::pow(colour_error, 1.0 - feature_error[k]);
+                row_flip[y] += error;
+                row_max_flip[y] = std::max(row_max_flip[y], error);
+                if (error_map != nullptr)
+                {
+                    const std::array<unsigned char, 3> rgb = false_colour(error);
+                    (*error_map)(x, static_cast<int>(y)) = Vec3(rgb[0] / 255.0, rgb[1] / 255.0, rgb[2] / 255.0);
+                }
+            }
+        } });
+
+    ImageDifference result;
+    double squared = 0.0, flip = 0.0;
+    for (int y = 0; y < height; ++y)
+    {
+        squared += row_squared[y];
+        flip += row_flip[y];
+        result.max_flip = std::max(result.max_flip, row_max_flip[y]);
+        result.max_abs_difference = std::max(result.max_abs_difference, row_max_difference[y]);
+        result.differing_pixels += row_differing[y];
+    }
+    const double pixel_count = static_cast<double>(width) * height;
+    result.rmse = std::sqrt(squared / (3 * pixel_count));
+    result.psnr = result.rmse > 0.0 ? -20.0 * std::log10(result.rmse) : std::numeric_limits<double>::infinity();
+    result.flip = flip / pixel_count;
+    return result;
+};
@@ -0,0 +1,103 @@
+// -*- lsst-c++ -*-
+/**
+ * @file instance.cpp
+ * @brief Implementation of the Instance class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "instance.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+Instance::Instance(std::shared_ptr<const TriangleMesh> mesh, const Transform &transform, const Material &mat)
+    : Element(mat, Vec3()), mesh(std::move(mesh)), object_to_world(transform), rest_transform(transform)
+{
+    if (!this->mesh)
+    {
+        throw std::invalid_argument("Instance: the mesh must not be null.");
+    }
+    center = object_to_world.transform_point(this->mesh->center);
+};
+
+Instance::Instance(std::shared_ptr<const TriangleMesh> mesh, const Transform &transform)
+    : Instance(mesh, transform, mesh ? mesh->material : Material()) {}
+
+void Instance::set_transform(const Transform &transform)
+{
+    object_to_world = transform * rest_transform;
+    center = object_to_world.transform_point(mesh->center);
+};
+
+Aabb Instance::bounds() const
+{
+    return object_to_world.transform_bounds(mesh->bounds());
+};
+
+bool Instance::contains(const Vec3 &point) const
+{
+    return mesh->contains(object_to_world.inverse_transform_point(point));
+};
+
+bool Instance::is_on_border(const Vec3 &point) const
+{
+    return mesh->is_on_border(object_to_world.inverse_transform_point(point));
+};
+
+Vec3 Instance::get_normal(const Vec3 &point) const
+{
+    return object_to_world.transform_normal(mesh->get_normal(object_to_world.inverse_transform_point(point))).normalize();
+};
+
+Vec3 Instance::get_normal(const Intersection &intersection) const
+{
+    // The mesh normal only depends on the triangle and barycentric coordinates
+    return object_to_world.transform_normal(mesh->get_normal(intersection)).normalize();
+};
+
+Vec3 Instance::get_geometric_normal(const Intersection &intersection) const
+{
+    return object_to_world.transform_normal(mesh->triangle_normal(intersection.primitive)).normalize();
+};
+
+Intersection Instance::intersect(const Ray &ray) const
+{
+    Ray interval_ray = ray;
+    Intersection hit;
+    if (intersect_closest(interval_ray, hit))
+    {
+        hit.point = ray.at(hit.t);
+    }
+    return hit;
+};
+
+// Closest-hit kernel: traversal of the mesh in object space.
+bool Instance::intersect_closest(Ray &ray, Intersection &hit) const
+{
+    // The object-space ray keeps the world-space parametrisation, so t and the interval are unchanged
+    Ray object_ray = object_to_world.inverse_transform_ray(ray);
+    if (!mesh->intersect_closest(object_ray, hit))
+    {
+        return false;
+    }
+    hit.element = this;
+    ray.t_max = object_ray.t_max;
+    return true;
+};
+
+bool Instance::is_light_visible_from_point(const Light &light, const Vec3 &point) const
+{
+    if (!is_on_border(point))
+    {
+        return false;
+    }
+    return get_normal(point).dot((light.position - point).normalize()) >= 0;
+};
+
+bool Instance::is_light_visible_from_point(const Light &light, const Intersection &intersection) const
+{
+    return get_normal(intersection).dot((light.position - intersection.point).normalize()) >= 0;
+};
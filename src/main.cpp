@@ -8,18 +8,345 @@
 #include "background.hpp"
 #include "intersection.hpp"
 #include "light.hpp"
+#include "render_settings.hpp"
+#include "sequence.hpp"
+#include "checked_math.hpp"
+#include "hdr_output.hpp"
+#include "tone_mapping.hpp"
+#include "denoiser.hpp"
+#include "heatmap.hpp"
+#include "reproducibility.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 using namespace std;
 
+/**
+ * @brief Command line options of the program.
+ */
+struct Options
+{
+    RenderSettings settings;                        ///< Options of the renderer.
+    AccelerationStructure acceleration = AccelerationStructure::Bvh; ///< Top-level acceleration structure of the scene.
+    BvhBuildMethod bvh_builder = BvhBuildMethod::BinnedSah;          ///< Split strategy of the top-level Bvh.
+    std::string output = "../output/first_try.ppm"; ///< Path of the rendered image.
+    int frames = 0;                                 ///< Number of frames of the animation (0 for a still image).
+    std::string frame_pattern = "../output/frame_%04d.ppm"; ///< Name of the animation frames.
+    std::size_t memory_budget = 0;                  ///< Bytes the image may keep in memory (0 for no limit).
+    HalfCompression compression = HalfCompression::Rle; ///< Compression of the half-float images.
+    ToneMapSettings tone_mapping;                   ///< Conversion of the radiance to bytes (PPM output).
+    bool denoise = false;                           ///< Denoise the image (records the auxiliary buffers it needs).
+    unsigned aovs = 0;                              ///< Auxiliary buffers saved next to the image (AovBuffers::Channel flags).
+    std::string aov_prefix = "../output/aov";       ///< Path and beginning of the names of the auxiliary buffer files.
+    std::string heatmap;                            ///< Path and beginning of the names of the cost outputs (empty for none).
+    unsigned verify_threads = 0;                    ///< Threads of a second render compared with the first one (0 for no check).
+};
+
+/**
+ * @brief Parse the command line.
+ * @details Recognised options: --mode depth|wavefront|preview|distributed, --acceleration bvh|bvh4|grid,
+ * --bvh-builder median|sah|morton, --threads N, --batch N, --ray-sort on|off, --samples N, --seed S, --verify-threads N,
+ * --workers N, --tile N, --memory-budget MIB, --output PATH (.ppm, .pfm or .half), --compression none|rle,
+ * --exposure EV, --tone-map clamp|reinhard|aces, --transfer linear|srgb, --dither on|off, --denoise on|off,
+ * --aovs depth,normal,albedo,id,shadows,cost|all, --aov-prefix PATH, --heatmap PATH, --preview-file PATH, --frames N,
+ * --frame-pattern PATTERN.
+ *
+ * @throws std::invalid_argument on an unknown option or a missing value.
+ * @return The parsed options.
+ */
+Options parse_options(int argc, char *argv[])
+{
+    Options options;
+    bool output_given = false;
+    for (int k = 1; k < argc; ++k)
+    {
+        std::string option = argv[k];
+        if (k + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for option " + option);
+        }
+        std::string value = argv[++k];
+        if (option == "--mode")
+        {
+            if (value == "depth")
+            {
+                options.settings.mode = RenderMode::DepthFirst;
+            }
+            else if (value == "wavefront")
+            {
+                options.settings.mode = RenderMode::Wavefront;
+            }
+            else if (value == "preview")
+            {
+                options.settings.mode = RenderMode::Preview;
+            }
+            else if (value == "distributed")
+            {
+                options.settings.mode = RenderMode::Distributed;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown render mode: " + value);
+            }
+        }
+        else if (option == "--acceleration")
+        {
+            if (value == "bvh")
+            {
+                options.acceleration = AccelerationStructure::Bvh;
+            }
+            else if (value == "bvh4")
+            {
+                options.acceleration = AccelerationStructure::WideBvh;
+            }
+            else if (value == "grid")
+            {
+                options.acceleration = AccelerationStructure::Grid;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown acceleration structure: " + value);
+            }
+        }
+        else if (option == "--bvh-builder")
+        {
+            if (value == "median")
+            {
+                options.bvh_builder = BvhBuildMethod::Median;
+            }
+            else if (value == "sah")
+            {
+                options.bvh_builder = BvhBuildMethod::BinnedSah;
+            }
+            else if (value == "morton")
+            {
+                options.bvh_builder = BvhBuildMethod::Morton;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown BVH builder: " + value);
+            }
+        }
+        else if (option == "--threads")
+        {
+            options.settings.threads = static_cast<unsigned>(std::stoul(value));
+        }
+        else if (option == "--batch")
+        {
+            options.settings.wavefront_batch_size = std::stoul(value);
+        }
+        else if (option == "--ray-sort")
+        {
+            if (value != "on" && value != "off")
+            {
+                throw std::invalid_argument("--ray-sort expects on or off, got " + value);
+            }
+            options.settings.wavefront_ray_sort = value == "on";
+        }
+        else if (option == "--samples")
+        {
+            options.settings.samples_per_pixel = std::stoi(value);
+        }
+        else if (option == "--seed")
+        {
+            options.settings.seed = std::stoull(value);
+        }
+        else if (option == "--verify-threads")
+        {
+            options.verify_threads = static_cast<unsigned>(std::stoul(value));
+        }
+        else if (option == "--workers")
+        {
+            options.settings.processes = static_cast<unsigned>(std::stoul(value));
+        }
+        else if (option == "--tile")
+        {
+            options.settings.tile_size = std::stoi(value);
+        }
+        else if (option == "--memory-budget")
+        {
+            options.memory_budget = std::stoul(value) << 20; // given in MiB
+        }
+        else if (option == "--compression")
+        {
+            if (value == "none")
+            {
+                options.compression = HalfCompression::None;
+            }
+            else if (value == "rle")
+            {
+                options.compression = HalfCompression::Rle;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown compression: " + value);
+            }
+        }
+        else if (option == "--exposure")
+        {
+            options.tone_mapping.exposure = std::stod(value);
+        }
+        else if (option == "--tone-map")
+        {
+            if (value == "clamp")
+            {
+                options.tone_mapping.tone_map = ToneMapOperator::Clamp;
+            }
+            else if (value == "reinhard")
+            {
+                options.tone_mapping.tone_map = ToneMapOperator::Reinhard;
+            }
+            else if (value == "aces")
+            {
+                options.tone_mapping.tone_map = ToneMapOperator::Aces;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown tone map operator: " + value);
+            }
+        }
+        else if (option == "--transfer")
+        {
+            if (value == "linear")
+            {
+                options.tone_mapping.transfer = TransferFunction::Linear;
+            }
+            else if (value == "srgb")
+            {
+                options.tone_mapping.transfer = TransferFunction::Srgb;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown transfer function: " + value);
+            }
+        }
+        else if (option == "--dither")
+        {
+            if (value != "on" && value != "off")
+            {
+                throw std::invalid_argument("--dither expects on or off, got " + value);
+            }
+            options.tone_mapping.dither = value == "on";
+        }
+        else if (option == "--denoise")
+        {
+            if (value != "on" && value != "off")
+            {
+                throw std::invalid_argument("--denoise expects on or off, got " + value);
+            }
+            options.denoise = value == "on";
+        }
+        else if (option == "--aovs")
+        {
+            options.aovs = 0;
+            std::size_t start = 0;
+            while (start <= value.size())
+            {
+                std::size_t end = std::min(value.find(',', start), value.size());
+                std::string channel = value.substr(start, end - start);
+                if (channel == "depth")
+                {
+                    options.aovs |= AovBuffers::Depth;
+                }
+                else if (channel == "normal")
+                {
+                    options.aovs |= AovBuffers::Normal;
+                }
+                else if (channel == "albedo")
+                {
+                    options.aovs |= AovBuffers::Albedo;
+                }
+                else if (channel == "id")
+                {
+                    options.aovs |= AovBuffers::ElementId;
+                }
+                else if (channel == "shadows")
+                {
+                    options.aovs |= AovBuffers::ShadowRays;
+                }
+                else if (channel == "cost")
+                {
+                    options.aovs |= AovBuffers::Cost;
+                }
+                else if (channel == "all")
+                {
+                    options.aovs |= AovBuffers::All & ~AovBuffers::Cost; // the cost is only measured in depth-first mode
+                }
+                else
+                {
+                    throw std::invalid_argument("Unknown auxiliary buffer: " + channel);
+                }
+                start = end + 1;
+            }
+        }
+        else if (option == "--aov-prefix")
+        {
+            options.aov_prefix = value;
+        }
+        else if (option == "--heatmap")
+        {
+            options.heatmap = value;
+        }
+        else if (option == "--output")
+        {
+            options.output = value;
+            output_given = true;
+        }
+        else if (option == "--preview-file")
+        {
+            options.settings.preview_file = value;
+        }
+        else if (option == "--frames")
+        {
+            options.frames = std::stoi(value);
+        }
+        else if (option == "--frame-pattern")
+        {
+            SequenceRenderer::frame_filename(value, 0); // throws on a pattern without integer field
+            options.frame_pattern = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option: " + option);
+        }
+    }
+
+    // Frames are named by --frame-pattern (whose extension gives their format) and saved as rendered
+    if (options.frames > 0 && (output_given || options.aovs != 0 || options.denoise || !options.heatmap.empty() || options.verify_threads > 0))
+    {
+        throw std::invalid_argument("--output, --aovs, --denoise, --heatmap and --verify-threads apply to a still image, not to --frames (name the frames with --frame-pattern).");
+    }
+    // These hold whole frames: they cannot be bounded by the memory budget
+    if (options.memory_budget != 0 && (options.aovs != 0 || options.denoise || !options.heatmap.empty() || options.verify_threads > 0 || options.settings.mode == RenderMode::Preview))
+    {
+        throw std::invalid_argument("--aovs, --denoise, --heatmap, --verify-threads and --mode preview hold whole frames, they cannot be used with --memory-budget.");
+    }
+    options.settings.aovs = options.aovs | (options.denoise ? AovBuffers::Depth | AovBuffers::Normal | AovBuffers::Albedo : 0u) | (options.heatmap.empty() ? 0u : AovBuffers::Cost);
+    return options;
+}
+
 /* pour compiler :
     - se mettre dans le dossier /build/
     - marquer "make"
     - l'exécutable est: "build/main"
     */
-int main()
+int main(int argc, char *argv[])
 {
+    Options options;
+    try
+    {
+        options = parse_options(argc, argv);
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << "\n"
+                  << "Usage: " << argv[0] << " [--mode depth|wavefront|preview|distributed] [--acceleration bvh|bvh4|grid] [--bvh-builder median|sah|morton] [--threads N] [--batch N] [--ray-sort on|off] [--samples N] [--seed S] [--verify-threads N] [--workers N] [--tile N] [--memory-budget MIB] [--output PATH] [--compression none|rle] [--exposure EV] [--tone-map clamp|reinhard|aces] [--transfer linear|srgb] [--dither on|off] [--denoise on|off] [--aovs LIST] [--aov-prefix PATH] [--heatmap PATH] [--preview-file PATH] [--frames N] [--frame-pattern PATTERN]\n";
+        return 1;
+    }
 
     /* -------------------------------------------------------------------------------------- */
     // const int WIDTH = 16;
@@ -53,6 +380,8 @@ int main()
     // }
     /* -------------------------------------------------------------------------------------- */
     Scene scene = Scene();
+    scene.set_acceleration_structure(options.acceleration);
+    scene.set_bvh_build_method(options.bvh_builder);
 
     Ray ray = Ray(Vec3(), Vec3(1, 0, 1));
     // Material mat = Material(Vec3(1, 1, 0));
@@ -78,7 +407,7 @@ int main()
     const float HEIGHT = 0.9 * 2;
     const int WIDTH_RESOLUTION = 160 * 20;
     const int HEIGHT_RESOLUTION = 90 * 20;
-    Screen screen = Screen(WIDTH, HEIGHT, WIDTH_RESOLUTION, HEIGHT_RESOLUTION);
+    Screen screen = Screen(WIDTH, HEIGHT, WIDTH_RESOLUTION, HEIGHT_RESOLUTION, options.memory_budget);
 
     // // Appliquer le fond en dégradé à l'aide de la fonction externe
     // Color top_color(0.0f, 0.0f, 8.0f);    // Bleu en haut
@@ -86,8 +415,52 @@ int main()
     // apply_gradient_background(screen, top_color, bottom_color);
     // // apply_checkerboard_background(screen, top_color, bottom_color, 10);
 
-    screen.render_scene(scene, Vec3(0, 0, 1), 5);
-    screen.save_image_as_ppm("../output/first_try.ppm");
+    if (options.frames > 0)
+    {
+        // Animation: the small sphere orbits around the middle one
+        const double pi = std::acos(-1.0);
+        std::vector<SequenceFrame> frames(options.frames);
+        for (int k = 0; k < options.frames; ++k)
+        {
+            double angle = 2 * pi * k / options.frames;
+            Vec3 rest = Vec3(0, 0, -5);
+            Vec3 pivot = Vec3(5, 0, -10);
+            Vec3 position = pivot + Transform::rotation(Vec3(0, 1, 0), angle).transform_vector(rest - pivot);
+            frames[k].transforms.push_back({0, Transform::translation(position - rest)});
+        }
+        SequenceRenderer sequence(screen, options.settings, ToneMapper(options.tone_mapping), options.compression);
+        sequence.render(scene, Vec3(0, 0, 1), 5, frames, options.frame_pattern);
+        print_degenerate_math_report(std::clog);
+        return 0;
+    }
+
+    ThreadPool pool(options.settings.threads);
+    bool reproducible = true;
+    if (options.verify_threads > 0)
+    {
+        ReproducibilityReport report = verify_reproducibility(screen, scene, Vec3(0, 0, 1), 5, options.settings, options.verify_threads);
+        print_reproducibility_report(report, std::clog);
+        reproducible = report.reproducible();
+    }
+    else
+    {
+        screen.render_scene(scene, Vec3(0, 0, 1), 5, options.settings, pool);
+    }
+    if (options.aovs != 0)
+    {
+        screen.aovs.save_as_pfm(options.aov_prefix);
+    }
+    if (!options.heatmap.empty())
+    {
+        save_cost_heatmap(screen.aovs, options.heatmap + ".ppm");
+        save_cost_csv(screen.aovs, options.heatmap + ".csv");
+    }
+    if (options.denoise)
+    {
+        Denoiser().apply(screen, screen.aovs, pool);
+    }
+    save_image(screen, options.output, ToneMapper(options.tone_mapping), options.compression, pool);
+    print_degenerate_math_report(std::clog);
     // std::vector<Intersection> intersections = scene.compute_intersections(ray);
 
     // for (const auto &intersection : intersections)
@@ -115,5 +488,5 @@ int main()
     // }
     // std::cout << "First Intersection at point: " << first_intersection.point << " at t = " << first_intersection.t << std::endl;
 
-    return 0;
+    return reproducible ? 0 : 1;
 }
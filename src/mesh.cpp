@@ -0,0 +1,372 @@
+// -*- lsst-c++ -*-
+/**
+ * @file mesh.cpp
+ * @brief Implementation of the TriangleMesh class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "mesh.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    // Tolerance used by the (slow) point-based queries.
+    const double tolerance = 1e-6;
+
+    // Parse the vertex index of an OBJ face token ("i", "i/j", "i//k" or "i/j/k").
+    std::uint32_t parse_obj_index(const std::string &token, std::size_t vertex_count, const std::string &filename)
+    {
+        long index = 0;
+        try
+        {
+            index = std::stol(token.substr(0, token.find('/')));
+        }
+        catch (const std::exception &)
+        {
+            throw std::runtime_error("Malformed face in OBJ file: " + filename);
+        }
+        // OBJ indices start at 1, negative indices are relative to the last vertex
+        long resolved = index > 0 ? index - 1 : static_cast<long>(vertex_count) + index;
+        if (index == 0 || resolved < 0 || resolved >= static_cast<long>(vertex_count))
+        {
+            throw std::runtime_error("Face index out of range in OBJ file: " + filename);
+        }
+        return static_cast<std::uint32_t>(resolved);
+    }
+}
+
+// Precompute the permutation and shear of the watertight triangle test.
+WatertightRay::WatertightRay(const Ray &ray) : origin(ray.source)
+{
+    const Vec3 &d = ray.direction;
+    kz = (std::fabs(d[0]) > std::fabs(d[1]))
+             ? (std::fabs(d[0]) > std::fabs(d[2]) ? 0 : 2)
+             : (std::fabs(d[1]) > std::fabs(d[2]) ? 1 : 2);
+    kx = (kz + 1) % 3;
+    ky = (kx + 1) % 3;
+    if (d[kz] < 0.0)
+    {
+        std::swap(kx, ky); // preserve the winding of the triangles
+    }
+    sx = d[kx] / d[kz];
+    sy = d[ky] / d[kz];
+    sz = 1.0 / d[kz];
+};
+
+// Watertight ray/triangle test.
+bool WatertightRay::intersect(const Vec3 &a, const Vec3 &b, const Vec3 &c, double t_min, double t_max, double &t, double &u, double &v) const
+{
+    const Vec3 A = a - origin;
+    const Vec3 B = b - origin;
+    const Vec3 C = c - origin;
+
+    // Shear the vertices so that the ray becomes the +z axis
+    const double ax = A[kx] - sx * A[kz];
+    const double ay = A[ky] - sy * A[kz];
+    const double bx = B[kx] - sx * B[kz];
+    const double by = B[ky] - sy * B[kz];
+    const double cx = C[kx] - sx * C[kz];
+    const double cy = C[ky] - sy * C[kz];
+
+    // Scaled barycentric coordinates (edge functions)
+    const double U = cx * by - cy * bx;
+    const double V = ax * cy - ay * cx;
+    const double W = bx * ay - by * ax;
+    if ((U < 0.0 || V < 0.0 || W < 0.0) && (U > 0.0 || V > 0.0 || W > 0.0))
+    {
+        return false;
+    }
+
+    const double det = U + V + W;
+    if (det == 0.0)
+    {
+        return false;
+    }
+
+    const double T = U * (sz * A[kz]) + V * (sz * B[kz]) + W * (sz * C[kz]);
+    const double inv_det = 1.0 / det;
+    const double hit_t = T * inv_det;
+    if (!(hit_t > t_min && hit_t < t_max))
+    {
+        return false;
+    }
+
+    t = hit_t;
+    u = U * inv_det;
+    v = V * inv_det;
+    return true;
+};
+
+TriangleMesh::TriangleMesh(std::vector<Vec3> vertices, std::vector<Triangle> indices, const Material &mat, std::vector<Vec3> normals)
+    : Element(mat, Vec3()), vertices(std::move(vertices)), normals(std::move(normals)), indices(std::move(indices))
+{
+    if (this->indices.empty())
+    {
+        throw std::invalid_argument("TriangleMesh: the mesh has no triangle.");
+    }
+    if (!this->normals.empty() && this->normals.size() != this->vertices.size())
+    {
+        throw std::invalid_argument("TriangleMesh: the normal buffer must match the vertex buffer.");
+    }
+    for (const Triangle &triangle : this->indices)
+    {
+        for (std::uint32_t index : triangle)
+        {
+            if (index >= this->vertices.size())
+            {
+                throw std::invalid_argument("TriangleMesh: vertex index out of range.");
+            }
+        }
+    }
+
+    std::vector<Aabb> bounds;
+    bounds.reserve(this->indices.size());
+    for (std::uint32_t i = 0; i < this->indices.size(); ++i)
+    {
+        bounds.push_back(triangle_bounds(i));
+    }
+    bvh.build(bounds);
+
+    for (const Vec3 &vertex : this->vertices)
+    {
+        mesh_bounds.expand(vertex);
+    }
+    center = mesh_bounds.centroid();
+};
+
+// Load a mesh from a Wavefront OBJ file.
+std::shared_ptr<TriangleMesh> TriangleMesh::load_obj(const std::string &filename, const Material &mat, bool smooth)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for reading: " + filename);
+    }
+
+    std::vector<Vec3> vertices;
+    std::vector<Triangle> indices;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+        if (keyword == "v")
+        {
+            double x, y, z;
+            if (!(stream >> x >> y >> z))
+            {
+                throw std::runtime_error("Malformed vertex in OBJ file: " + filename);
+            }
+            vertices.emplace_back(x, y, z);
+        }
+        else if (keyword == "f")
+        {
+            std::vector<std::uint32_t> polygon;
+            std::string token;
+            while (stream >> token)
+            {
+                polygon.push_back(parse_obj_index(token, vertices.size(), filename));
+            }
+            // Fan triangulation of the polygon
+            for (std::size_t i = 2; i < polygon.size(); ++i)
+            {
+                indices.push_back({polygon[0], polygon[i - 1], polygon[i]});
+            }
+        }
+    }
+    if (indices.empty())
+    {
+        throw std::invalid_argument("TriangleMesh: the mesh has no triangle (no face in OBJ file: " + filename + ").");
+    }
+
+    std::vector<Vec3> normals;
+    if (smooth)
+    {
+        // Area-weighted vertex normals (the cross product norm is twice the triangle area)
+        normals.assign(vertices.size(), Vec3());
+        for (const Triangle &triangle : indices)
+        {
+            Vec3 n = cross(vertices[triangle[1]] - vertices[triangle[0]], vertices[triangle[2]] - vertices[triangle[0]]);
+            for (std::uint32_t index : triangle)
+            {
+                normals[index] += n;
+            }
+        }
+        for (Vec3 &n : normals)
+        {
+            double length = n.norm();
+            n = length > 0.0 ? n / length : Vec3(0.0, 0.0, 1.0);
+        }
+    }
+
+    return std::make_shared<TriangleMesh>(std::move(vertices), std::move(indices), mat, std::move(normals));
+};
+
+Aabb TriangleMesh::triangle_bounds(std::uint32_t triangle) const
+{
+    Aabb box;
+    for (std::uint32_t index : indices[triangle])
+    {
+        box.expand(vertices[index]);
+    }
+    return box;
+};
+
+Aabb TriangleMesh::bounds() const
+{
+    return mesh_bounds;
+};
+
+Vec3 TriangleMesh::triangle_normal(std::uint32_t triangle) const
+{
+    const Triangle &t = indices[triangle];
+    return cross(vertices[t[1]] - vertices[t[0]], vertices[t[2]] - vertices[t[0]]).normalize();
+};
+
+Intersection TriangleMesh::intersect(const Ray &ray) const
+{
+    Ray interval_ray = ray;
+    Intersection hit;
+    if (intersect_closest(interval_ray, hit))
+    {
+        hit.point = ray.at(hit.t);
+    }
+    return hit;
+};
+
+// Closest-hit kernel: Bvh traversal with the watertight triangle test.
+bool TriangleMesh::intersect_closest(Ray &ray, Intersection &hit) const
+{
+    const WatertightRay watertight_ray(ray);
+    std::uint32_t closest = 0;
+    double closest_u = 0.0, closest_v = 0.0;
+
+    bool found = bvh.closest_hit(ray, [&](std::uint32_t triangle, Ray &r)
+                                 {
+        const Triangle &tri = indices[triangle];
+        double t, u, v;
+        if (!watertight_ray.intersect(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], r.t_min, r.t_max, t, u, v))
+        {
+            return false;
+        }
+        r.t_max = t;
+        closest = triangle;
+        closest_u = u;
+        closest_v = v;
+        return true; });
+
+    if (!found)
+    {
+        return false;
+    }
+
+    hit.t = ray.t_max;
+    hit.element = this;
+    hit.primitive = closest;
+    hit.u = closest_u;
+    hit.v = closest_v;
+    hit.valid = true;
+    return true;
+};
+
+Vec3 TriangleMesh::get_normal(const Intersection &intersection) const
+{
+    if (normals.empty())
+    {
+        return triangle_normal(intersection.primitive);
+    }
+    const Triangle &t = indices[intersection.primitive];
+    double w = 1.0 - intersection.u - intersection.v;
+    return (intersection.u * normals[t[0]] + intersection.v * normals[t[1]] + w * normals[t[2]]).normalize();
+};
+
+Vec3 TriangleMesh::get_geometric_normal(const Intersection &intersection) const
+{
+    return triangle_normal(intersection.primitive);
+};
+
+std::uint32_t TriangleMesh::find_triangle(const Vec3 &point) const
+{
+    for (std::uint32_t i = 0; i < indices.size(); ++i)
+    {
+        const Triangle &t = indices[i];
+        const Vec3 &a = vertices[t[0]];
+        Vec3 e1 = vertices[t[1]] - a;
+        Vec3 e2 = vertices[t[2]] - a;
+        Vec3 ap = point - a;
+        Vec3 n = cross(e1, e2);
+        double area = n.norm();
+        if (area == 0.0 || std::fabs(n.dot(ap)) / area > tolerance)
+        {
+            continue; // degenerate triangle or point outside of the triangle plane
+        }
+        double d11 = e1.dot(e1), d12 = e1.dot(e2), d22 = e2.dot(e2);
+        double dp1 = ap.dot(e1), dp2 = ap.dot(e2);
+        double denom = d11 * d22 - d12 * d12;
+        double b1 = (d22 * dp1 - d12 * dp2) / denom;
+        double b2 = (d11 * dp2 - d12 * dp1) / denom;
+        if (b1 >= -tolerance && b2 >= -tolerance && b1 + b2 <= 1.0 + tolerance)
+        {
+            return i;
+        }
+    }
+    return static_cast<std::uint32_t>(indices.size());
+};
+
+Vec3 TriangleMesh::get_normal(const Vec3 &point) const
+{
+    std::uint32_t triangle = find_triangle(point);
+    if (triangle == indices.size())
+    {
+        throw std::invalid_argument("TriangleMesh::get_normal: the point is not on the mesh.");
+    }
+    return triangle_normal(triangle);
+};
+
+bool TriangleMesh::contains(const Vec3 &point) const
+{
+    // Parity of the crossings along a direction unlikely to graze edges
+    const WatertightRay ray(Ray(point, Vec3(0.5773, 0.5774, 0.5775)));
+    const double infinity = std::numeric_limits<double>::infinity();
+    int crossings = 0;
+    for (const Triangle &t : indices)
+    {
+        double hit_t, u, v;
+        if (ray.intersect(vertices[t[0]], vertices[t[1]], vertices[t[2]], 0.0, infinity, hit_t, u, v))
+        {
+            ++crossings;
+        }
+    }
+    return crossings % 2 == 1;
+};
+
+bool TriangleMesh::is_on_border(const Vec3 &point) const
+{
+    return find_triangle(point) != indices.size();
+};
+
+bool TriangleMesh::is_light_visible_from_point(const Light &light, const Vec3 &point) const
+{
+    std::uint32_t triangle = find_triangle(point);
+    if (triangle == indices.size())
+    {
+        return false;
+    }
+    return triangle_normal(triangle).dot((light.position - point).normalize()) >= 0;
+};
+
+bool TriangleMesh::is_light_visible_from_point(const Light &light, const Intersection &intersection) const
+{
+    Vec3 normal = get_normal(intersection);
+    return normal.dot((light.position - intersection.point).normalize()) >= 0;
+};
@@ -0,0 +1,131 @@
+// -*- lsst-c++ -*-
+/**
+ * @file preview.cpp
+ * @brief Implementation of the MappedPpm and PreviewRenderer classes.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "preview.hpp"
+#include "arena.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+MappedPpm::MappedPpm(const std::string &filename, int width, int height)
+    : width(width), height(height), file(-1), mapping(nullptr), mapping_size(0), header_size(0)
+{
+    const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    header_size = header.size();
+    mapping_size = header_size + static_cast<std::size_t>(width) * height * 3;
+
+    file = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0)
+    {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+    if (::ftruncate(file, static_cast<off_t>(mapping_size)) != 0)
+    {
+        ::close(file);
+        throw std::runtime_error("Failed to resize file: " + filename);
+    }
+    void *memory = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (memory == MAP_FAILED)
+    {
+        ::close(file);
+        throw std::runtime_error("Failed to map file: " + filename);
+    }
+    mapping = static_cast<unsigned char *>(memory);
+    std::memcpy(mapping, header.data(), header_size);
+};
+
+MappedPpm::~MappedPpm()
+{
+    ::msync(mapping, mapping_size, MS_SYNC);
+    ::munmap(mapping, mapping_size);
+    ::close(file);
+};
+
+void MappedPpm::fill(int i, int j, int size, const Color &color)
+{
+    Color bytes = color.as_bytes();
+    const unsigned char rgb[3] = {static_cast<unsigned char>(bytes.r()), static_cast<unsigned char>(bytes.g()), static_cast<unsigned char>(bytes.b())};
+    const int i_end = std::min(i + size, width);
+    const int j_end = std::min(j + size, height);
+    for (int y = j; y < j_end; ++y)
+    {
+        unsigned char *row = mapping + header_size + (static_cast<std::size_t>(y) * width + i) * 3;
+        for (int x = i; x < i_end; ++x, row += 3)
+        {
+            std::memcpy(row, rgb, 3);
+        }
+    }
+};
+
+void MappedPpm::flush()
+{
+    ::msync(mapping, mapping_size, MS_ASYNC);
+};
+
+PreviewRenderer::PreviewRenderer(const std::string &filename) : filename(filename) {}
+
+// Color the screen in passes of decreasing pixel spacing.
+void PreviewRenderer::render(Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit, ThreadPool &pool)
+{
+    const auto start = std::chrono::steady_clock::now();
+    MappedPpm image(filename, screen.width_resolution, screen.height_resolution);
+
+    // The preview starts from the background of the screen
+    pool.parallel_for(screen.height_resolution, 16, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t j = begin; j < end; ++j)
+        {
+            for (int i = 0; i < screen.width_resolution; ++i)
+            {
+                image.fill(i, static_cast<int>(j), 1, screen.pixels(i, j));
+            }
+        } });
+
+    std::vector<Arena> arenas(pool.size());
+    for (int step = coarsest_step; step >= 1; step /= 2)
+    {
+        const std::size_t rows = (screen.height_resolution + step - 1) / step;
+        pool.parallel_for(rows, 1, [&](std::size_t begin, std::size_t end, unsigned thread)
+                          {
+            for (std::size_t row = begin; row < end; ++row)
+            {
+                const int j = static_cast<int>(row) * step;
+                for (int i = 0; i < screen.width_resolution; i += step)
+                {
+                    // Pixels of the previous (coarser) pass are kept, only their block shrinks
+                    bool traced = step < coarsest_step && i % (2 * step) == 0 && j % (2 * step) == 0;
+                    if (!traced)
+                    {
+                        Color pixel_color;
+                        if (screen.trace_pixel(scene, camera_position, max_hit, i, j, arenas[thread], pixel_color))
+                        {
+                            screen.color_pixel(i, j, pixel_color);
+                        }
+                    }
+                    image.fill(i, j, step, screen.pixels(i, j));
+                }
+                if (step == 1)
+                {
+                    screen.pixels.complete(0, j, screen.width_resolution, 1);
+                }
+            } });
+        image.flush();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::clog << "Preview 1/" << step << " resolution written to " << filename << " after " << elapsed.count() << " ms\n";
+    }
+};
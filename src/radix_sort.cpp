@@ -0,0 +1,94 @@
+// -*- lsst-c++ -*-
+/**
+ * @file radix_sort.cpp
+ * @brief Implementation of the parallel radix sort.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "radix_sort.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    constexpr std::size_t chunk_size = 1 << 16; ///< Values per chunk of the parallel loops.
+    constexpr int radix_bits = 8;               ///< Bits sorted per pass.
+    constexpr std::size_t radix_size = std::size_t(1) << radix_bits; ///< Number of buckets of a pass.
+}
+
+// Reserve the memory of a sort.
+void RadixSortBuffers::reserve(std::size_t count)
+{
+    values.reserve(count);
+    histograms.reserve((count + chunk_size - 1) / chunk_size * radix_size);
+};
+
+// Sort integers on a range of their bits.
+void radix_sort(std::vector<std::uint64_t> &values, int first_bit, int bit_count, ThreadPool &pool)
+{
+    RadixSortBuffers buffers;
+    radix_sort(values, first_bit, bit_count, pool, buffers);
+};
+
+// Sort integers on a range of their bits, with caller-owned scratch memory.
+void radix_sort(std::vector<std::uint64_t> &values, int first_bit, int bit_count, ThreadPool &pool, RadixSortBuffers &buffers)
+{
+    const std::size_t count = values.size();
+    const std::size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+    if (chunk_count == 0 || bit_count <= 0)
+    {
+        return;
+    }
+    std::vector<std::uint64_t> &sorted = buffers.values;
+    std::vector<std::size_t> &histograms = buffers.histograms;
+    sorted.resize(count);
+    histograms.resize(chunk_count * radix_size);
+
+    for (int shift = first_bit; shift < first_bit + bit_count; shift += radix_bits)
+    {
+        const std::uint64_t mask = (std::uint64_t(1) << std::min(radix_bits, first_bit + bit_count - shift)) - 1;
+        auto digit = [shift, mask](std::uint64_t value)
+        { return static_cast<std::size_t>((value >> shift) & mask); };
+
+        // Histogram of every chunk
+        pool.parallel_for(chunk_count, 1, [&](std::size_t begin, std::size_t end, unsigned)
+                          {
+            for (std::size_t chunk = begin; chunk < end; ++chunk)
+            {
+                std::size_t *histogram = histograms.data() + chunk * radix_size;
+                std::fill(histogram, histogram + radix_size, 0);
+                for (std::size_t k = chunk * chunk_size; k < std::min(count, (chunk + 1) * chunk_size); ++k)
+                {
+                    ++histogram[digit(values[k])];
+                }
+            } });
+
+        // Digit-major scan: the chunks of a digit keep their order, so the sort is stable
+        std::size_t offset = 0;
+        for (std::size_t d = 0; d < radix_size; ++d)
+        {
+            for (std::size_t chunk = 0; chunk < chunk_count; ++chunk)
+            {
+                const std::size_t bucket = histograms[chunk * radix_size + d];
+                histograms[chunk * radix_size + d] = offset;
+                offset += bucket;
+            }
+        }
+
+        // Scatter every chunk from its own cursors
+        pool.parallel_for(chunk_count, 1, [&](std::size_t begin, std::size_t end, unsigned)
+                          {
+            for (std::size_t chunk = begin; chunk < end; ++chunk)
+            {
+                std::size_t *cursors = histograms.data() + chunk * radix_size;
+                for (std::size_t k = chunk * chunk_size; k < std::min(count, (chunk + 1) * chunk_size); ++k)
+                {
+                    sorted[cursors[digit(values[k])]++] = values[k];
+                }
+            } });
+        values.swap(sorted);
+    }
+};
@@ -1,34 +1,45 @@
 #include "ray.hpp"
 #include "vec3.hpp"
+#include "checked_math.hpp"
 
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
 
 // Default constructor: initializes source and direction to (0, 0, 0)
-Ray::Ray() : source(Vec3()), direction(Vec3()) {}
+Ray::Ray() : source(Vec3()), direction(Vec3()), t_min(0.0), t_max(std::numeric_limits<double>::infinity()) {}
 
 // Constructor with source and direction
-Ray::Ray(const Vec3 &source, const Vec3 &direction)
-    : source(source), direction(direction) {}
+Ray::Ray(const Vec3 &source, const Vec3 &direction, double t_min, double t_max)
+    : source(source), direction(direction), t_min(t_min), t_max(t_max) {}
 
-// Method to get the point at time t along the ray
-Vec3 Ray::at(float t) const
+// Method to get the point at time t along the ray (t <= 0 checked or counted, see checked_math.hpp)
+Vec3 Ray::at(double t) const
 {
-    if (t > 0)
+    if (!(t > 0))
     {
-        return source + t * direction;
-    }
-    else
-    {
-        // Throw an exception if t is not positive
-        throw std::invalid_argument(
-            "Error: t must be strictly positive. Detected in file " + std::string(__FILE__) +
-            " at line " + std::to_string(__LINE__));
+        if (checked_math)
+        {
+            // Throw an exception if t is not positive
+            throw std::invalid_argument(
+                "Error: t must be strictly positive. Detected in file " + std::string(__FILE__) +
+                " at line " + std::to_string(__LINE__));
+        }
+        report_degenerate_math(DegenerateMath::NonPositiveRayTime);
     }
+    return source + t * direction;
 }
 
 Ray create_ray_from_points(const Vec3 &A, const Vec3 &B)
 {
     Vec3 direction = (B - A).normalize();
     return Ray(A, direction);
-};
\ No newline at end of file
+};
+
+// Push the point off the surface, by a margin relative to its largest coordinate.
+Vec3 offset_ray_origin(const Vec3 &point, const Vec3 &normal)
+{
+    const double relative_epsilon = 1e-9;
+    double magnitude = std::fmax(std::fabs(point[0]), std::fmax(std::fabs(point[1]), std::fabs(point[2])));
+    return point + (relative_epsilon * (1.0 + magnitude)) * normal;
+};
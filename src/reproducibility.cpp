@@ -0,0 +1,92 @@
+// -*- lsst-c++ -*-
+/**
+ * @file reproducibility.cpp
+ * @brief Implementation of the reproducibility check.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "reproducibility.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // Number of threads (or processes) meant by a setting (0 means one per hardware thread).
+    unsigned resolve_count(unsigned count)
+    {
+        return count == 0 ? std::max(1u, std::thread::hardware_concurrency()) : count;
+    };
+}
+
+// Render the scene twice with different thread counts and compare the images.
+ReproducibilityReport verify_reproducibility(Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit, const RenderSettings &settings, unsigned other_threads, std::size_t max_reported)
+{
+    if (screen.pixels.memory_budget() != 0)
+    {
+        throw std::invalid_argument("verify_reproducibility: both frames are compared whole, they do not fit in a memory budget.");
+    }
+    const bool distributed = settings.mode == RenderMode::Distributed;
+    RenderSettings second_settings = settings;
+    (distributed ? second_settings.processes : second_settings.threads) = other_threads;
+
+    ReproducibilityReport report;
+    report.first_threads = resolve_count(distributed ? settings.processes : settings.threads);
+    report.second_threads = resolve_count(other_threads);
+
+    // Both renders start from the same background (pixels missed by every ray keep it)
+    const Framebuffer background = screen.pixels;
+    screen.render_scene(scene, camera_position, max_hit, settings);
+    const Framebuffer first = screen.pixels;
+    screen.pixels = background;
+    screen.render_scene(scene, camera_position, max_hit, second_settings);
+
+    // Bitwise comparison: the renders must not even differ by a rounding
+    for (int j = 0; j < screen.height_resolution; ++j)
+    {
+        for (int i = 0; i < screen.width_resolution; ++i)
+        {
+            const Color &first_color = first(i, j);
+            const Color &second_color = screen.pixels(i, j);
+            if (std::memcmp(first_color.data(), second_color.data(), 3 * sizeof(double)) != 0)
+            {
+                ++report.differing_pixels;
+                if (report.mismatches.size() < max_reported)
+                {
+                    report.mismatches.push_back({i, j, first_color, second_color});
+                }
+            }
+        }
+    }
+    return report;
+};
+
+// Print a reproducibility report.
+void print_reproducibility_report(const ReproducibilityReport &report, std::ostream &stream)
+{
+    stream << "Reproducibility check (" << report.first_threads << " vs " << report.second_threads << " threads): ";
+    if (report.reproducible())
+    {
+        stream << "identical images.\n";
+        return;
+    }
+    stream << report.differing_pixels << " pixels differ.\n";
+    const auto precision = stream.precision(17);
+    for (const PixelMismatch &mismatch : report.mismatches)
+    {
+        stream << "  pixel (" << mismatch.i << ", " << mismatch.j << "): "
+               << mismatch.first[0] << ' ' << mismatch.first[1] << ' ' << mismatch.first[2] << " vs "
+               << mismatch.second[0] << ' ' << mismatch.second[1] << ' ' << mismatch.second[2] << "\n";
+    }
+    if (report.differing_pixels > report.mismatches.size())
+    {
+        stream << "  ... and " << (report.differing_pixels - report.mismatches.size()) << " more.\n";
+    }
+    stream.precision(precision);
+};
@@ -1,10 +1,146 @@
+#include "scene.hpp"
 
+#include <limits>
+#include <stdexcept>
 
-#include "scene.hpp"
+namespace
+{
+    // Closest-hit kernel, instantiated for each primitive type of the scene.
+    // The ray interval shrinks with each hit, so farther primitives (and nodes) are rejected early.
+    template <typename T, typename Acceleration>
+    void find_closest_hit(const std::vector<const T *> &primitives, const std::vector<std::uint32_t> &element_indices, const Acceleration &acceleration, int type, Ray &ray, Intersection &closest)
+    {
+        acceleration.closest_hit(ray, [&](std::uint32_t index, Ray &interval_ray)
+                        {
+            if (primitives[index]->intersect_closest(interval_ray, closest))
+            {
+                closest.type = type;
+                closest.element_index = element_indices[index];
+                return true;
+            }
+            return false; });
+    }
+
+    // Occlusion kernel: tell if any primitive is hit within the ray interval.
+    template <typename T, typename Acceleration>
+    bool find_any_hit(const std::vector<const T *> &primitives, const Acceleration &acceleration, const Ray &ray)
+    {
+        return acceleration.any_hit(ray, [&](std::uint32_t index, const Ray &interval_ray)
+                           {
+            Ray probe = interval_ray;
+            Intersection hit;
+            return primitives[index]->intersect_closest(probe, hit); });
+    }
+
+    // Fill the optical path of a ray (up to max_hit intersections, stops at the first miss).
+    template <typename Path>
+    void trace_optical_path(Scene &scene, const Ray &ray, int max_hit, Path &optical_path)
+    {
+        optical_path.reserve(max_hit > 0 ? max_hit : 0);
+        for (auto i = 0; i < max_hit; i++)
+        {
+            Intersection current_intersection = scene.find_first_intersection(ray);
+            optical_path.push_back(current_intersection);
+            if (!current_intersection.valid)
+            {
+                return;
+            }
+        }
+    }
+}
 
 void Scene::add_element(std::shared_ptr<Element> element)
 {
+    if (!primitives.add_element(element.get(), static_cast<std::uint32_t>(elements.size())))
+    {
+        throw std::invalid_argument("Scene::add_element: unsupported element type (see ScenePrimitives).");
+    }
     elements.push_back(element);
+    acceleration_dirty = true;
+};
+
+// Choose the top-level acceleration structure.
+void Scene::set_acceleration_structure(AccelerationStructure acceleration_structure)
+{
+    if (acceleration_structure != structure)
+    {
+        structure = acceleration_structure;
+        acceleration_dirty = true;
+    }
+};
+
+// Choose how the top-level Bvh are built.
+void Scene::set_bvh_build_method(BvhBuildMethod method)
+{
+    if (method != bvh_method)
+    {
+        bvh_method = method;
+        acceleration_dirty = acceleration_dirty || structure != AccelerationStructure::Grid;
+    }
+};
+
+// Build the top-level acceleration structures on the calling thread.
+void Scene::build_acceleration()
+{
+    if (!acceleration_dirty && !acceleration_stale)
+    {
+        return;
+    }
+    ThreadPool pool(1); // the calling thread only
+    build_acceleration(pool);
+};
+
+// Build the top-level acceleration structures (one Bvh, Bvh4 or UniformGrid per primitive type).
+void Scene::build_acceleration(ThreadPool &pool)
+{
+    if (!acceleration_dirty && !acceleration_stale)
+    {
+        return;
+    }
+    primitives.for_each_type([&](auto type, const auto &array)
+                             {
+        std::vector<Aabb> bounds;
+        bounds.reserve(array.size());
+        for (const auto *primitive : array)
+        {
+            bounds.push_back(primitive->bounds());
+        }
+        if (structure == AccelerationStructure::Grid)
+        {
+            acceleration[type] = Bvh();
+            wide_acceleration[type] = Bvh4();
+            grids[type].build(bounds, pool);
+        }
+        else
+        {
+            grids[type] = UniformGrid();
+            if (acceleration_dirty)
+            {
+                acceleration[type].build(bounds, pool, bvh_method);
+            }
+            else
+            {
+                acceleration[type].refit(bounds);
+            }
+            // The wide hierarchy is collapsed again from the binary one (linear in its nodes)
+            if (structure == AccelerationStructure::WideBvh)
+            {
+                wide_acceleration[type].build(acceleration[type]);
+            }
+            else
+            {
+                wide_acceleration[type] = Bvh4();
+            }
+        } });
+    acceleration_dirty = false;
+    acceleration_stale = false;
+};
+
+// Move an element of the scene.
+void Scene::set_element_transform(std::size_t index, const Transform &transform)
+{
+    elements.at(index)->set_transform(transform);
+    acceleration_stale = true;
 };
 
 void Scene::add_light(const Light &light)
@@ -16,76 +152,137 @@ std::vector<Intersection> Scene::compute_intersections(const Ray &ray)
 {
     std::vector<Intersection> intersections;
 
-    for (const auto &element : elements)
-    {
-        Intersection intersection = element->intersect(ray);
-        intersections.push_back(intersection);
-        // if (intersection.valid)
-        // {
-        //     intersections.push_back(intersection);
-        // }
-    }
+    primitives.for_each_type([&](auto type, const auto &array)
+                             {
+        for (const auto *primitive : array)
+        {
+            Intersection intersection = primitive->intersect(ray);
+            intersection.type = type;
+            intersections.push_back(intersection);
+        } });
     return intersections;
 };
 
 // Find the first intersection between the ray and the scene.
 Intersection Scene::find_first_intersection(const Ray &ray)
 {
-    std::vector<Intersection> intersections = compute_intersections(ray);
-    // std::cout << "calculated intersections" << intersections << "\n";
-    float minimal_time = std::numeric_limits<float>::infinity();
+    build_acceleration();
+
     Intersection first_intersection = Intersection();
-    for (const auto &intersection : intersections)
+    Ray interval_ray = ray;
+
+    if (structure == AccelerationStructure::Grid)
     {
-        if ((intersection.t <= minimal_time) && (intersection.valid))
-        {
-            minimal_time = intersection.t;
-            first_intersection = intersection;
-        }
+        primitives.for_each_type([&](auto type, const auto &array)
+                                 { find_closest_hit(array, primitives.get_indices(type), grids[type], type, interval_ray, first_intersection); });
+    }
+    else if (structure == AccelerationStructure::WideBvh)
+    {
+        primitives.for_each_type([&](auto type, const auto &array)
+                                 { find_closest_hit(array, primitives.get_indices(type), wide_acceleration[type], type, interval_ray, first_intersection); });
+    }
+    else
+    {
+        primitives.for_each_type([&](auto type, const auto &array)
+                                 { find_closest_hit(array, primitives.get_indices(type), acceleration[type], type, interval_ray, first_intersection); });
+    }
+
+    // The hit point is only evaluated for the closest hit
+    if (first_intersection.valid)
+    {
+        first_intersection.point = ray.at(first_intersection.t);
+    }
+    else
+    {
+        first_intersection.t = 0.0;
     }
     return first_intersection;
 };
 
-bool Scene::light_is_visible_from_point_on_element(const Light &light, const Vec3 &point, const std::shared_ptr<const Element> &element)
+// Get the normal of the intersected element at the intersection point.
+Vec3 Scene::get_normal(const Intersection &intersection) const
+{
+    return ScenePrimitives::visit(intersection.type, intersection.element, [&](const auto *primitive)
+                                  { return primitive->get_normal(intersection); });
+};
+
+// Get the geometric normal of the intersected element at the intersection point.
+Vec3 Scene::get_geometric_normal(const Intersection &intersection) const
+{
+    return ScenePrimitives::visit(intersection.type, intersection.element, [&](const auto *primitive)
+                                  { return primitive->get_geometric_normal(intersection); });
+};
+
+bool Scene::light_is_visible_from_point_on_element(const Light &light, const Vec3 &point, const Element *element)
 {
     if (element->is_light_visible_from_point(light, point) == false)
     {
         return false;
     }
 
-    Ray ray_to_light = create_ray_from_points(point, light.position);
+    return !is_occluded(shadow_ray(light, point, element->get_normal(point)));
+};
 
-    for (const auto &scene_element : elements)
+bool Scene::light_is_visible_from_intersection(const Light &light, const Intersection &intersection, const Vec3 &normal, const Vec3 &geometric_normal)
+{
+    if (!light_is_facing_intersection(light, intersection, normal))
     {
-        if (scene_element != element)
-        {
-            Intersection intersection = scene_element->intersect(ray_to_light);
-
-            if (intersection.valid && intersection.t < (light.position - point).norm())
-            {
-                return false;
-            }
-        }
+        return false;
     }
 
-    return true;
+    return !is_occluded(shadow_ray(light, intersection.point, geometric_normal));
 };
 
-std::vector<Intersection> Scene::propagate_ray(const Ray &ray, const int max_hit)
+// Tell if the light lies on the outer side of the intersected element.
+bool Scene::light_is_facing_intersection(const Light &light, const Intersection &intersection, const Vec3 &normal) const
 {
-    std::vector<Intersection> optical_path;
-    for (auto i = 0; i < max_hit; i++)
+    return normal.dot(light.position - intersection.point) >= 0;
+};
+
+// Ray from a surface point to a light, leaving the surface along its geometric normal.
+Ray Scene::shadow_ray(const Light &light, const Vec3 &point, const Vec3 &geometric_normal) const
+{
+    const bool light_side = geometric_normal.dot(light.position - point) >= 0;
+    Vec3 origin = offset_ray_origin(point, light_side ? geometric_normal : -1.0 * geometric_normal);
+    Vec3 to_light = light.position - origin;
+    double distance = to_light.norm();
+    return Ray(origin, to_light / distance, 0.0, distance);
+};
+
+// Tell if an element is hit within the ray interval.
+bool Scene::is_occluded(const Ray &ray)
+{
+    build_acceleration();
+
+    bool occluded = false;
+    if (structure == AccelerationStructure::Grid)
     {
-        Intersection current_intersection = find_first_intersection(ray);
-        if (current_intersection.valid)
-        {
-            optical_path.push_back(current_intersection);
-        }
-        else
-        {
-            optical_path.push_back(current_intersection);
-            return optical_path;
-        }
+        primitives.for_each_type([&](auto type, const auto &array)
+                                 { occluded = occluded || find_any_hit(array, grids[type], ray); });
     }
+    else if (structure == AccelerationStructure::WideBvh)
+    {
+        primitives.for_each_type([&](auto type, const auto &array)
+                                 { occluded = occluded || find_any_hit(array, wide_acceleration[type], ray); });
+    }
+    else
+    {
+        primitives.for_each_type([&](auto type, const auto &array)
+                                 { occluded = occluded || find_any_hit(array, acceleration[type], ray); });
+    }
+    return occluded;
+};
+
+std::vector<Intersection> Scene::propagate_ray(const Ray &ray, const int max_hit)
+{
+    std::vector<Intersection> optical_path;
+    trace_optical_path(*this, ray, max_hit, optical_path);
     return optical_path;
-};
\ No newline at end of file
+};
+
+ArenaVector<Intersection> Scene::propagate_ray(const Ray &ray, const int max_hit, Arena &arena)
+{
+    ArenaVector<Intersection> optical_path{ArenaAllocator<Intersection>(arena)};
+    trace_optical_path(*this, ray, max_hit, optical_path);
+    return optical_path;
+};
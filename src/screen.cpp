@@ -11,17 +11,23 @@
  */
 
 #include "screen.hpp"
+#include "wavefront.hpp"
+#include "preview.hpp"
+#include "tile_farm.hpp"
+#include "tone_mapping.hpp"
+#include "allocation_counter.hpp"
+#include "cycle_counter.hpp"
+#include "sampler.hpp"
+
+#include <algorithm>
+#include <atomic>
 // #include "ray.hpp"
 // #include "vec3.hpp"
 
 // #include <ranges>
 
 // Value constructor
-Screen::Screen(const float w, const float h, const int w_res, const int h_res) : width(w), height(h), width_resolution(w_res), height_resolution(h_res), pixel_width(w / w_res), pixel_height(h / h_res), pixels(
-                                                                                                                                                                                                              h_res,
-                                                                                                                                                                                                              std::vector<Color>(
-                                                                                                                                                                                                                  w_res,
-                                                                                                                                                                                                                  Color(0.0, 0.0, 0.0))) {};
+Screen::Screen(const float w, const float h, const int w_res, const int h_res, std::size_t memory_budget) : width(w), height(h), width_resolution(w_res), height_resolution(h_res), pixel_width(w / w_res), pixel_height(h / h_res), pixels(w_res, h_res, memory_budget) {};
 
 // Return if the considered pixel belongs to the screen.
 bool Screen::valid_pixel(int i, int j) const
@@ -34,7 +40,7 @@ Color Screen::get_pixel_color(int i, int j) const
 {
     if (valid_pixel(i, j))
     {
-        return pixels[j][i]; // Return the color of the pixel at (x, y).
+        return pixels(i, j); // Return the color of the pixel at (x, y).
     }
     else
     {
@@ -45,11 +51,17 @@ Color Screen::get_pixel_color(int i, int j) const
 
 // Get the center of the considered pixel.
 Vec3 Screen::get_pixel_center(int i, int j)
+{
+    return get_pixel_point(i, j, 0.5f, 0.5f);
+};
+
+// Get a point of the considered pixel.
+Vec3 Screen::get_pixel_point(int i, int j, float u, float v)
 {
     if (valid_pixel(i, j))
     {
-        float x = -width / 2 + (i + 0.5f) * pixel_width;
-        float y = height / 2 - (j + 0.5f) * pixel_height;
+        float x = -width / 2 + (i + u) * pixel_width;
+        float y = height / 2 - (j + v) * pixel_height;
         return Vec3(x, y, 0.0f);
     }
     else
@@ -61,12 +73,18 @@ Vec3 Screen::get_pixel_center(int i, int j)
 
 // Get the ray coming from the camera to the pixel center.
 Ray Screen::get_ray_passing_through_pixel(int i, int j, const Vec3 &camera_position)
+{
+    return get_ray_passing_through_pixel(i, j, camera_position, 0.5f, 0.5f);
+};
+
+// Get the ray coming from the camera to a point of the pixel.
+Ray Screen::get_ray_passing_through_pixel(int i, int j, const Vec3 &camera_position, float u, float v)
 {
     if (valid_pixel(i, j))
     {
-        Vec3 pixel_center = get_pixel_center(i, j);
-        Vec3 ray_direction = (pixel_center - camera_position).normalize();
-        return Ray(pixel_center, ray_direction);
+        Vec3 pixel_point = get_pixel_point(i, j, u, v);
+        Vec3 ray_direction = (pixel_point - camera_position).normalize();
+        return Ray(pixel_point, ray_direction);
     }
     else
     {
@@ -80,7 +98,7 @@ void Screen::color_pixel(int i, int j, const Color &c)
 {
     if (valid_pixel(i, j))
     {
-        pixels[j][i] = c;
+        pixels(i, j) = c;
     }
     else
     {
@@ -90,6 +108,13 @@ void Screen::color_pixel(int i, int j, const Color &c)
 
 // Save the screen image as a Portable pixmap.
 void Screen::save_image_as_ppm(const std::string &filename)
+{
+    ThreadPool pool(1); // the calling thread only
+    save_image_as_ppm(filename, ToneMapper(), pool);
+};
+
+// Save the screen image as a Portable pixmap, through a tone mapping stage.
+void Screen::save_image_as_ppm(const std::string &filename, const ToneMapper &tone_mapper, ThreadPool &pool)
 {
     std::ofstream file(filename);
 
@@ -103,19 +128,34 @@ void Screen::save_image_as_ppm(const std::string &filename)
     file << width_resolution << " " << height_resolution << "\n"; // Image dimensions
     file << "255\n";                                              // Maximum color value (255 for 8-bit colors)
 
-    // Write pixel data
-    for (int j = 0; j < height_resolution; ++j)
+    // Text of every byte value
+    std::string values[256];
+    for (int value = 0; value < 256; ++value)
     {
-        std::clog << "\rLines to save remaining: " << (height_resolution - j) << ' ' << std::flush;
-        for (int i = 0; i < width_resolution; ++i)
+        values[value] = std::to_string(value) + " ";
+    }
+
+    // Write pixel data, tone mapped one band of rows at a time (a row of tiles unless the image is
+    // spilled: the tone mapper reads it from its file, see Framebuffer::read_row)
+    const int band_height = pixels.band_height();
+    std::vector<std::uint8_t> band(static_cast<std::size_t>(band_height) * width_resolution * 3);
+    std::string line;
+    for (int y0 = 0; y0 < height_resolution; y0 += band_height)
+    {
+        const int rows = std::min(band_height, height_resolution - y0);
+        tone_mapper.apply(*this, y0, rows, band.data(), pool);
+        for (int row = 0; row < rows; ++row)
         {
-            Color color = get_pixel_color(i, j).as_bytes(); // Convert color to byte representation
-            // std::cout << "(R, G, B) = (" << color.r() << ", " << color.g() << ", " << color.b() << ")\n";
-            file << color.r() << " "
-                 << color.g() << " "
-                 << color.b() << " ";
+            std::clog << "\rLines to save remaining: " << (height_resolution - y0 - row) << ' ' << std::flush;
+            const std::uint8_t *bytes = band.data() + static_cast<std::size_t>(row) * width_resolution * 3;
+            line.clear();
+            for (int k = 0; k < width_resolution * 3; ++k)
+            {
+                line += values[bytes[k]];
+            }
+            line += "\n"; // End of line for each row
+            file << line;
         }
-        file << "\n"; // End of line for each row
     }
 
     file.close();
@@ -165,43 +205,240 @@ void Screen::save_image_as_ppm(const std::string &filename)
 
 void Screen::render_scene(Scene &scene, const Vec3 &camera_position, int max_hit)
 {
-    for (int j = 0; j < height_resolution; ++j)
+    render_scene(scene, camera_position, max_hit, RenderSettings());
+};
+
+void Screen::render_scene(Scene &scene, const Vec3 &camera_position, int max_hit, const RenderSettings &settings)
+{
+    ThreadPool pool(settings.threads);
+    render_scene(scene, camera_position, max_hit, settings, pool);
+};
+
+void Screen::render_scene(Scene &scene, const Vec3 &camera_position, int max_hit, const RenderSettings &settings, ThreadPool &pool)
+{
+    // The scene is only read from here on: build its structures before the threads share it
+    scene.build_acceleration(pool);
 
+    // Auxiliary buffers: only allocated (and recorded) if requested
+    if (settings.aovs != 0 && settings.mode != RenderMode::DepthFirst && settings.mode != RenderMode::Wavefront)
     {
-        std::clog << "\rLines to render remaining: " << (height_resolution - j) << ' ' << std::flush;
-        for (int i = 0; i < width_resolution; ++i)
-        {
-            Ray current_ray = get_ray_passing_through_pixel(i, j, camera_position);
-            std::vector<Intersection> optical_path = scene.propagate_ray(current_ray, max_hit);
-            Color pixel_color = Color(0.0, 0.0, 0.0); // Initialiser la couleur à noir
+        throw std::invalid_argument("Screen::render_scene: auxiliary buffers are only recorded by the depth-first and wavefront modes.");
+    }
+    if ((settings.aovs & AovBuffers::Cost) && settings.mode != RenderMode::DepthFirst)
+    {
+        throw std::invalid_argument("Screen::render_scene: per-pixel costs are only measured by the depth-first mode.");
+    }
+    if (pixels.memory_budget() != 0 && (settings.aovs != 0 || settings.mode == RenderMode::Preview))
+    {
+        throw std::invalid_argument("Screen::render_scene: auxiliary buffers and the preview mode hold whole frames, they do not fit in a memory budget.");
+    }
+    if (settings.samples_per_pixel < 1)
+    {
+        throw std::invalid_argument("Screen::render_scene: at least one sample per pixel is needed.");
+    }
+    if (settings.samples_per_pixel > 1 && settings.mode != RenderMode::DepthFirst && settings.mode != RenderMode::Distributed)
+    {
+        throw std::invalid_argument("Screen::render_scene: several samples per pixel are only traced by the depth-first and distributed modes.");
+    }
+    aovs.resize(width_resolution, height_resolution, settings.aovs);
+    AovBuffers *recorded_aovs = settings.aovs != 0 ? &aovs : nullptr;
+
+    if (settings.mode == RenderMode::Wavefront)
+    {
+        WavefrontRenderer renderer(settings.wavefront_batch_size, settings.wavefront_ray_sort);
+        renderer.render(*this, scene, camera_position, max_hit, pool, recorded_aovs);
+        return;
+    }
+    if (settings.mode == RenderMode::Preview)
+    {
+        PreviewRenderer renderer(settings.preview_file);
+        renderer.render(*this, scene, camera_position, max_hit, pool);
+        return;
+    }
+    if (settings.mode == RenderMode::Distributed)
+    {
+        TileFarm farm(settings.processes, settings.tile_size, settings.samples_per_pixel, settings.seed);
+        farm.render(*this, scene, camera_position, max_hit);
+        return;
+    }
+
+    // One arena per thread; the first row (or tile) of a thread sizes it, the next ones must not allocate
+    std::vector<Arena> arenas(pool.size());
+    std::vector<std::size_t> steady_allocations(pool.size(), 0);
+    std::vector<char> warmed_up(pool.size(), 0);
 
-            if (optical_path.size() != 1)
+    // Row by row, or tile by tile in waves of the tiles the memory budget holds when the image is spilled
+    const bool by_tile = pixels.is_spilled();
+    const std::size_t units = by_tile ? pixels.tile_count() : static_cast<std::size_t>(height_resolution);
+    const std::size_t wave = by_tile ? pixels.tiles_in_flight() : units;
+    std::atomic<std::size_t> units_done(0);
+    for (std::size_t first = 0; first < units; first += wave)
+    {
+        pool.parallel_for(std::min(wave, units - first), 1, [&](std::size_t begin, std::size_t end, unsigned thread)
+                          {
+            for (std::size_t unit = first + begin; unit < first + end; ++unit)
             {
-                // std::cout << "une d'intersection" << "\n";
-                // Si le rayon intersecte quelque chose, calcule la couleur en fonction des intersections
-                for (const auto &intersection : optical_path)
+                std::size_t allocations = thread_allocation_count();
+                if (by_tile)
+                {
+                    render_tile(scene, camera_position, max_hit, unit, arenas[thread], settings);
+                }
+                else
                 {
-                    Vec3 normal_at_point = intersection.element->get_normal(intersection.point);
-
-                    for (const auto &light : scene.lights)
-                    {
-                        if (scene.light_is_visible_from_point_on_element(light, intersection.point, intersection.element))
-                        {
-                            Ray light_ray = create_ray_from_points(intersection.point, light.position);
-                            float cos_theta = normal_at_point.dot(light_ray.direction);
-                            // std::cout << "cos theta = " << cos_theta << "\n";
-                            // Calcul de la couleur avec la loi de Lambert
-                            pixel_color += Hadamard(intersection.element->material.albedo, light.color) * cos_theta;
-                        }
-                    }
-                    // std::cout << "(R, G, B) = (" << pixel_color.r() << ", " << pixel_color.g() << ", " << pixel_color.b() << ")\n";
-                    pixel_color *= intersection.element->material.reflectance;
+                    render_row(scene, camera_position, max_hit, static_cast<int>(unit), arenas[thread], settings, recorded_aovs);
                 }
-                // std::cout << "(R, G, B) = (" << pixel_color.r() << ", " << pixel_color.g() << ", " << pixel_color.b() << ")\n";
-                color_pixel(i, j, pixel_color); // Assigne la couleur au pixel
+                if (warmed_up[thread])
+                {
+                    steady_allocations[thread] += thread_allocation_count() - allocations;
+                }
+                warmed_up[thread] = 1;
+                std::size_t done = ++units_done;
+                if (thread == 0)
+                {
+                    std::clog << (by_tile ? "\rTiles" : "\rLines") << " to render remaining: " << (units - done) << ' ' << std::flush;
+                }
+            } });
+    }
+    std::cout << std::flush;
+
+    std::size_t total_allocations = 0;
+    for (std::size_t count : steady_allocations)
+    {
+        total_allocations += count;
+    }
+    if (total_allocations > 0)
+    {
+        std::cerr << "\nWarning: " << total_allocations << " heap allocations in the steady-state render loop.\n";
+    }
+};
+
+// Color one row of the screen (depth-first).
+void Screen::render_row(Scene &scene, const Vec3 &camera_position, int max_hit, int j, Arena &arena, const RenderSettings &settings, AovBuffers *aovs)
+{
+    for (int i = 0; i < width_resolution; ++i)
+    {
+        Color pixel_color;
+        if (sample_pixel(scene, camera_position, max_hit, i, j, settings.samples_per_pixel, settings.seed, arena, pixel_color, aovs))
+        {
+            color_pixel(i, j, pixel_color); // Assigne la couleur au pixel
+        }
+    }
+    pixels.complete(0, j, width_resolution, 1);
+};
+
+// Color one tile of the framebuffer (depth-first).
+void Screen::render_tile(Scene &scene, const Vec3 &camera_position, int max_hit, std::size_t tile, Arena &arena, const RenderSettings &settings)
+{
+    int x, y, w, h;
+    pixels.tile_rectangle(tile, x, y, w, h);
+    for (int j = y; j < y + h; ++j)
+    {
+        for (int i = x; i < x + w; ++i)
+        {
+            Color pixel_color;
+            if (sample_pixel(scene, camera_position, max_hit, i, j, settings.samples_per_pixel, settings.seed, arena, pixel_color))
+            {
+                color_pixel(i, j, pixel_color);
             }
         }
     }
-    std::cout << std::flush;
-    // std::cout << "\n";
-}
\ No newline at end of file
+    pixels.complete(x, y, w, h);
+};
+
+// Compute the color of one pixel (false if the pixel keeps its background color).
+bool Screen::trace_pixel(Scene &scene, const Vec3 &camera_position, int max_hit, int i, int j, Arena &arena, Color &pixel_color, AovBuffers *aovs)
+{
+    return sample_pixel(scene, camera_position, max_hit, i, j, 1, 0, arena, pixel_color, aovs);
+};
+
+// Compute the color of one pixel as the mean of jittered samples, summed in a fixed order.
+bool Screen::sample_pixel(Scene &scene, const Vec3 &camera_position, int max_hit, int i, int j, int samples, std::uint64_t seed, Arena &arena, Color &pixel_color, AovBuffers *aovs)
+{
+    // The cost covers every sample of the pixel
+    const bool measure_cost = aovs != nullptr && aovs->has(AovBuffers::Cost);
+    const std::uint64_t start = measure_cost ? read_cycle_counter() : 0;
+    Intersection first_hit = Intersection();
+    std::uint32_t shadow_rays = 0;
+    Intersection *first_hit_output = aovs != nullptr ? &first_hit : nullptr;
+    std::uint32_t *shadow_rays_output = aovs != nullptr && aovs->has(AovBuffers::ShadowRays) ? &shadow_rays : nullptr;
+
+    bool hit = false;
+    if (samples <= 1)
+    {
+        hit = trace_camera_ray(scene, get_ray_passing_through_pixel(i, j, camera_position), max_hit, arena, pixel_color, first_hit_output, shadow_rays_output);
+    }
+    else
+    {
+        const Color background = pixels(i, j);
+        Color sum = Color(0.0, 0.0, 0.0);
+        for (int sample = 0; sample < samples; ++sample)
+        {
+            SampleStream stream(seed, i, j, sample);
+            const float u = stream.next();
+            const float v = stream.next();
+            Color sample_color;
+            if (trace_camera_ray(scene, get_ray_passing_through_pixel(i, j, camera_position, u, v), max_hit, arena, sample_color, sample == 0 ? first_hit_output : nullptr, shadow_rays_output))
+            {
+                sum += sample_color;
+                hit = true;
+            }
+            else
+            {
+                sum += background;
+            }
+        }
+        pixel_color = sum / static_cast<double>(samples);
+    }
+
+    // The cycles are read before the other channels are recorded, which must not count in the cost
+    if (measure_cost)
+    {
+        aovs->record_cost(i, j, read_cycle_counter() - start);
+    }
+    if (aovs != nullptr)
+    {
+        aovs->record(i, j, scene, first_hit, shadow_rays);
+    }
+    return hit;
+};
+
+// Compute the color carried by a camera ray (false if it hits nothing).
+bool Screen::trace_camera_ray(Scene &scene, const Ray &ray, int max_hit, Arena &arena, Color &pixel_color, Intersection *first_hit, std::uint32_t *shadow_rays)
+{
+    arena.reset(); // the optical path of the previous pixel is no longer used
+    ArenaVector<Intersection> optical_path = scene.propagate_ray(ray, max_hit, arena);
+    pixel_color = Color(0.0, 0.0, 0.0); // Initialiser la couleur à noir
+    if (first_hit != nullptr)
+    {
+        *first_hit = optical_path.empty() ? Intersection() : optical_path.front();
+    }
+
+    if (optical_path.size() == 1)
+    {
+        return false; // the ray hits nothing and we keep the background color
+    }
+
+    // Si le rayon intersecte quelque chose, calcule la couleur en fonction des intersections
+    for (const auto &intersection : optical_path)
+    {
+        Vec3 normal_at_point = scene.get_normal(intersection);
+        Vec3 geometric_normal = scene.get_geometric_normal(intersection);
+
+        for (const auto &light : scene.lights)
+        {
+            if (shadow_rays != nullptr && scene.light_is_facing_intersection(light, intersection, normal_at_point))
+            {
+                ++*shadow_rays; // lights facing the point are tested with a shadow ray
+            }
+            if (scene.light_is_visible_from_intersection(light, intersection, normal_at_point, geometric_normal))
+            {
+                Ray light_ray = create_ray_from_points(intersection.point, light.position);
+                float cos_theta = normal_at_point.dot(light_ray.direction);
+                // Calcul de la couleur avec la loi de Lambert
+                pixel_color += Hadamard(intersection.element->material.albedo, light.color) * cos_theta;
+            }
+        }
+        pixel_color *= intersection.element->material.reflectance;
+    }
+    return true;
+};
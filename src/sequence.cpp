@@ -0,0 +1,114 @@
+// -*- lsst-c++ -*-
+/**
+ * @file sequence.cpp
+ * @brief Implementation of the SequenceRenderer class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "sequence.hpp"
+
+#include <cctype>
+#include <iostream>
+#include <stdexcept>
+
+SequenceRenderer::SequenceRenderer(Screen &screen, const RenderSettings &settings, const ToneMapper &tone_mapper, HalfCompression compression)
+    : screen(screen), settings(settings), pool(settings.threads), wavefront(settings.wavefront_batch_size, settings.wavefront_ray_sort),
+      tone_mapper(tone_mapper), compression(compression), writer_pool(1),
+      encoding(screen.width, screen.height, screen.width_resolution, screen.height_resolution, screen.pixels.memory_budget()), background(screen.pixels) {}
+
+SequenceRenderer::~SequenceRenderer()
+{
+    if (pending_write.valid())
+    {
+        try
+        {
+            pending_write.get();
+        }
+        catch (const std::exception &error)
+        {
+            std::cerr << "Error: " << error.what() << "\n";
+        }
+    }
+};
+
+// Render and save every frame of the sequence.
+void SequenceRenderer::render(Scene &scene, const Vec3 &camera_position, int max_hit, const std::vector<SequenceFrame> &frames, const std::string &filename_pattern)
+{
+    frame_filename(filename_pattern, 0); // validate the pattern before rendering anything
+    if (settings.mode == RenderMode::Wavefront && settings.samples_per_pixel != 1)
+    {
+        throw std::invalid_argument("SequenceRenderer::render: the wavefront mode traces one sample per pixel.");
+    }
+
+    for (std::size_t frame = 0; frame < frames.size(); ++frame)
+    {
+        std::clog << "\rFrame " << frame + 1 << " / " << frames.size() << "\n";
+        for (const auto &element_transform : frames[frame].transforms)
+        {
+            scene.set_element_transform(element_transform.first, element_transform.second);
+        }
+
+        // Refit (not rebuild) the acceleration structures, and restart from the background
+        scene.build_acceleration(pool);
+        screen.pixels = background;
+
+        if (settings.mode == RenderMode::Wavefront)
+        {
+            wavefront.render(screen, scene, camera_position, max_hit, pool);
+        }
+        else
+        {
+            screen.render_scene(scene, camera_position, max_hit, settings, pool);
+        }
+
+        // Hand the frame over to the writer thread once it finished the previous one
+        if (pending_write.valid())
+        {
+            pending_write.get();
+        }
+        std::swap(screen.pixels, encoding.pixels);
+        std::string filename = frame_filename(filename_pattern, static_cast<int>(frame));
+        pending_write = std::async(std::launch::async, [this, filename]
+                                   { save_image(encoding, filename, tone_mapper, compression, writer_pool); });
+        if (screen.pixels.memory_budget() != 0)
+        {
+            pending_write.get(); // within a memory budget, the writer and the next frame would both be in flight
+        }
+    }
+
+    if (pending_write.valid())
+    {
+        pending_write.get();
+    }
+};
+
+// Name of a frame.
+std::string SequenceRenderer::frame_filename(const std::string &filename_pattern, int frame)
+{
+    std::size_t start = filename_pattern.find('%');
+    std::size_t end = start;
+    if (start != std::string::npos)
+    {
+        end = start + 1;
+        while (end < filename_pattern.size() && std::isdigit(static_cast<unsigned char>(filename_pattern[end])))
+        {
+            ++end;
+        }
+    }
+    if (start == std::string::npos || end >= filename_pattern.size() || filename_pattern[end] != 'd')
+    {
+        throw std::invalid_argument("The frame name pattern needs an integer field (e.g. frame_%04d.ppm): " + filename_pattern);
+    }
+
+    std::string number = std::to_string(frame);
+    std::string width_field = filename_pattern.substr(start + 1, end - start - 1);
+    std::size_t width = width_field.empty() ? 0 : std::stoul(width_field);
+    if (number.size() < width)
+    {
+        number.insert(0, width - number.size(), width_field[0] == '0' ? '0' : ' ');
+    }
+    return filename_pattern.substr(0, start) + number + filename_pattern.substr(end + 1);
+};
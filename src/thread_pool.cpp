@@ -0,0 +1,133 @@
+// -*- lsst-c++ -*-
+/**
+ * @file thread_pool.cpp
+ * @brief Implementation of the ThreadPool class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned thread_count)
+    : task(nullptr), task_context(nullptr), task_count(0), task_grain(1), next_index(0), generation(0), busy_workers(0), stopping(false)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(thread_count - 1);
+    for (unsigned i = 1; i < thread_count; ++i)
+    {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+};
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_signal.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+};
+
+// Run a loop over [0, count) on every thread, then wait for it.
+void ThreadPool::run_loop(std::size_t count, std::size_t grain, Invoker invoke, const void *context)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    grain = std::max<std::size_t>(1, grain);
+    if (workers.empty() || count <= grain)
+    {
+        invoke(context, 0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = invoke;
+        task_context = context;
+        task_count = count;
+        task_grain = grain;
+        next_index.store(0);
+        error = nullptr;
+        busy_workers = static_cast<unsigned>(workers.size());
+        ++generation;
+    }
+    start_signal.notify_all();
+
+    run_chunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_signal.wait(lock, [this]
+                     { return busy_workers == 0; });
+    task = nullptr;
+    task_context = nullptr;
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+};
+
+void ThreadPool::worker_loop(unsigned index)
+{
+    std::uint64_t seen_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_signal.wait(lock, [&]
+                              { return stopping || generation != seen_generation; });
+            if (stopping)
+            {
+                return;
+            }
+            seen_generation = generation;
+        }
+
+        run_chunks(index);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --busy_workers;
+        }
+        done_signal.notify_one();
+    }
+};
+
+// Process chunks of the current loop until none is left.
+void ThreadPool::run_chunks(unsigned thread)
+{
+    while (true)
+    {
+        std::size_t begin = next_index.fetch_add(task_grain);
+        if (begin >= task_count)
+        {
+            return;
+        }
+        std::size_t end = std::min(begin + task_grain, task_count);
+        try
+        {
+            task(task_context, begin, end, thread);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+            next_index.store(task_count); // stop handing out chunks
+        }
+    }
+};
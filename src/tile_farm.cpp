@@ -0,0 +1,284 @@
+// -*- lsst-c++ -*-
+/**
+ * @file tile_farm.cpp
+ * @brief Implementation of the TileFarm class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "tile_farm.hpp"
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    // Send the whole buffer (false if the peer is gone).
+    bool send_all(int socket, const void *data, std::size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t sent = ::send(socket, bytes, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (sent <= 0)
+            {
+                return false;
+            }
+            bytes += sent;
+            size -= static_cast<std::size_t>(sent);
+        }
+        return true;
+    }
+
+    // Receive the whole buffer (false if the peer is gone).
+    bool receive_all(int socket, void *data, std::size_t size)
+    {
+        char *bytes = static_cast<char *>(data);
+        while (size > 0)
+        {
+            ssize_t received = ::recv(socket, bytes, size, 0);
+            if (received < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                return false;
+            }
+            bytes += received;
+            size -= static_cast<std::size_t>(received);
+        }
+        return true;
+    }
+
+    // Worker process: render the tiles sent by the coordinator until told to stop.
+    void worker_loop(int socket, Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit, int samples_per_pixel, std::uint64_t seed)
+    {
+        Arena arena;
+        std::vector<double> colors;
+        Tile tile;
+        while (receive_all(socket, &tile, sizeof(tile)) && tile.width > 0)
+        {
+            colors.resize(static_cast<std::size_t>(tile.width) * tile.height * 3);
+            std::size_t k = 0;
+            for (int j = tile.y; j < tile.y + tile.height; ++j)
+            {
+                for (int i = tile.x; i < tile.x + tile.width; ++i)
+                {
+                    Color pixel_color;
+                    if (!screen.sample_pixel(scene, camera_position, max_hit, i, j, samples_per_pixel, seed, arena, pixel_color))
+                    {
+                        pixel_color = screen.pixels(i, j); // background
+                    }
+                    for (int channel = 0; channel < 3; ++channel)
+                    {
+                        colors[k++] = pixel_color[channel];
+                    }
+                }
+            }
+            screen.pixels.complete(tile.x, tile.y, tile.width, tile.height); // the background read from a spilled image
+            if (!send_all(socket, &tile, sizeof(tile)) || !send_all(socket, colors.data(), colors.size() * sizeof(double)))
+            {
+                return;
+            }
+        }
+    }
+
+    struct Worker
+    {
+        pid_t pid;   ///< Process of the worker.
+        int socket;  ///< Coordinator end of the socket pair.
+        bool busy;   ///< True while the worker renders a tile.
+    };
+
+    // Ask the workers to stop, then wait for them (killing them first on an error).
+    void stop_workers(std::vector<Worker> &workers, bool kill)
+    {
+        const Tile stop = {0, 0, 0, 0};
+        for (Worker &worker : workers)
+        {
+            if (kill)
+            {
+                ::kill(worker.pid, SIGKILL);
+            }
+            else
+            {
+                send_all(worker.socket, &stop, sizeof(stop));
+            }
+            ::close(worker.socket);
+        }
+        for (Worker &worker : workers)
+        {
+            ::waitpid(worker.pid, nullptr, 0);
+        }
+        workers.clear();
+    }
+}
+
+TileFarm::TileFarm(unsigned processes, int tile_size, int samples_per_pixel, std::uint64_t seed)
+    : processes(processes == 0 ? std::max(1u, std::thread::hardware_concurrency()) : processes),
+      tile_size(std::max(1, tile_size)), samples_per_pixel(samples_per_pixel), seed(seed) {}
+
+// Color the screen with the worker processes.
+void TileFarm::render(Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit)
+{
+    std::vector<Tile> tiles;
+    unsigned worker_count = processes;
+    if (!screen.pixels.is_spilled())
+    {
+        for (int y = 0; y < screen.height_resolution; y += tile_size)
+        {
+            for (int x = 0; x < screen.width_resolution; x += tile_size)
+            {
+                tiles.push_back({x, y, std::min(tile_size, screen.width_resolution - x), std::min(tile_size, screen.height_resolution - y)});
+            }
+        }
+    }
+    else
+    {
+        // Within a memory budget the tiles are cut along the framebuffer tiles and handed out in
+        // their order: each framebuffer tile is completed (and spilled) before the next ones are
+        // started, and there are not more of them in flight than workers
+        for (std::size_t framebuffer_tile = 0; framebuffer_tile < screen.pixels.tile_count(); ++framebuffer_tile)
+        {
+            int x0, y0, w, h;
+            screen.pixels.tile_rectangle(framebuffer_tile, x0, y0, w, h);
+            for (int y = y0; y < y0 + h; y += tile_size)
+            {
+                for (int x = x0; x < x0 + w; x += tile_size)
+                {
+                    tiles.push_back({x, y, std::min(tile_size, x0 + w - x), std::min(tile_size, y0 + h - y)});
+                }
+            }
+        }
+        worker_count = static_cast<unsigned>(std::min<std::size_t>(processes, screen.pixels.tiles_in_flight()));
+    }
+
+    // Fork the workers: they inherit the built scene and the background of the screen
+    std::vector<Worker> workers;
+    std::cout << std::flush;
+    std::clog << std::flush;
+    for (unsigned k = 0; k < worker_count && k < tiles.size(); ++k)
+    {
+        int sockets[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+        {
+            stop_workers(workers, true);
+            throw std::runtime_error("TileFarm: cannot create a socket pair.");
+        }
+        pid_t pid = ::fork();
+        if (pid < 0)
+        {
+            ::close(sockets[0]);
+            ::close(sockets[1]);
+            stop_workers(workers, true);
+            throw std::runtime_error("TileFarm: cannot start a worker process.");
+        }
+        if (pid == 0)
+        {
+            ::close(sockets[0]);
+            for (const Worker &worker : workers)
+            {
+                ::close(worker.socket);
+            }
+            worker_loop(sockets[1], screen, scene, camera_position, max_hit, samples_per_pixel, seed);
+            ::_exit(0); // the parent's objects (threads, files) must not be destroyed twice
+        }
+        ::close(sockets[1]);
+        workers.push_back({pid, sockets[0], false});
+    }
+
+    // Hand out the tiles and composite the results
+    std::size_t next_tile = 0;
+    std::size_t completed = 0;
+    std::vector<double> colors;
+    std::vector<pollfd> descriptors;
+    for (Worker &worker : workers)
+    {
+        worker.busy = send_all(worker.socket, &tiles[next_tile], sizeof(Tile));
+        next_tile += worker.busy ? 1 : 0;
+    }
+
+    while (completed < tiles.size())
+    {
+        descriptors.clear();
+        for (const Worker &worker : workers)
+        {
+            descriptors.push_back({worker.socket, POLLIN, 0});
+        }
+        if (::poll(descriptors.data(), descriptors.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            stop_workers(workers, true);
+            throw std::runtime_error("TileFarm: poll failed.");
+        }
+
+        for (std::size_t w = 0; w < workers.size(); ++w)
+        {
+            if (descriptors[w].revents == 0)
+            {
+                continue;
+            }
+            Worker &worker = workers[w];
+            Tile tile;
+            bool received = worker.busy && receive_all(worker.socket, &tile, sizeof(tile));
+            if (received)
+            {
+                colors.resize(static_cast<std::size_t>(tile.width) * tile.height * 3);
+                received = receive_all(worker.socket, colors.data(), colors.size() * sizeof(double));
+            }
+            if (!received)
+            {
+                stop_workers(workers, true);
+                throw std::runtime_error("TileFarm: a worker process stopped before the end of the render.");
+            }
+
+            std::size_t k = 0;
+            for (int j = tile.y; j < tile.y + tile.height; ++j)
+            {
+                for (int i = tile.x; i < tile.x + tile.width; ++i, k += 3)
+                {
+                    screen.pixels(i, j) = Color(colors[k], colors[k + 1], colors[k + 2]);
+                }
+            }
+            screen.pixels.complete(tile.x, tile.y, tile.width, tile.height);
+            ++completed;
+            std::clog << "\rTiles to render remaining: " << (tiles.size() - completed) << ' ' << std::flush;
+
+            worker.busy = false;
+            if (next_tile < tiles.size())
+            {
+                worker.busy = send_all(worker.socket, &tiles[next_tile], sizeof(Tile));
+                if (!worker.busy)
+                {
+                    stop_workers(workers, true);
+                    throw std::runtime_error("TileFarm: a worker process stopped before the end of the render.");
+                }
+                ++next_tile;
+            }
+        }
+    }
+
+    stop_workers(workers, false);
+    std::cout << std::flush;
+};
@@ -0,0 +1,143 @@
+// -*- lsst-c++ -*-
+/**
+ * @file tone_mapping.cpp
+ * @brief Implementation of the ToneMapper class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "tone_mapping.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr int block = 64; ///< Pixels converted together (fixed-size loops the compiler vectorises).
+
+    // 8x8 Bayer matrix: thresholds (k + 0.5) / 64 in dithering order.
+    constexpr int bayer[8][8] = {
+        {0, 32, 8, 40, 2, 34, 10, 42},
+        {48, 16, 56, 24, 50, 18, 58, 26},
+        {12, 44, 4, 36, 14, 46, 6, 38},
+        {60, 28, 52, 20, 62, 30, 54, 22},
+        {3, 35, 11, 43, 1, 33, 9, 41},
+        {51, 19, 59, 27, 49, 17, 57, 25},
+        {15, 47, 7, 39, 13, 45, 5, 37},
+        {63, 31, 55, 23, 61, 29, 53, 21}};
+
+    double srgb_encode(double linear)
+    {
+        return linear <= 0.0031308 ? 12.92 * linear : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+    }
+}
+
+ToneMapper::ToneMapper(const ToneMapSettings &settings)
+    : settings(settings), exposure_scale(std::exp2(settings.exposure)), srgb_table(table_size + 1)
+{
+    for (int k = 0; k <= table_size; ++k)
+    {
+        srgb_table[k] = 255.0 * srgb_encode(static_cast<double>(k) / table_size);
+    }
+};
+
+// Tone map rows of the screen.
+void ToneMapper::apply(const Screen &screen, int first_row, int row_count, std::uint8_t *rgb, ThreadPool &pool) const
+{
+    const std::size_t row_size = static_cast<std::size_t>(screen.width_resolution) * 3;
+    pool.parallel_for(row_count, 16, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t row = begin; row < end; ++row)
+        {
+            map_row(screen, first_row + static_cast<int>(row), rgb + row * row_size);
+        } });
+};
+
+// Tone map the whole screen.
+std::vector<std::uint8_t> ToneMapper::apply(const Screen &screen, ThreadPool &pool) const
+{
+    std::vector<std::uint8_t> rgb(static_cast<std::size_t>(screen.width_resolution) * screen.height_resolution * 3);
+    apply(screen, 0, screen.height_resolution, rgb.data(), pool);
+    return rgb;
+};
+
+// Tone map one row, a block of pixels at a time: each stage is a plain loop over the block.
+void ToneMapper::map_row(const Screen &screen, int j, std::uint8_t *rgb) const
+{
+    Color colors[block];
+    double values[block * 3];
+    double offsets[block * 3];
+    for (int x0 = 0; x0 < screen.width_resolution; x0 += block)
+    {
+        const int count = std::min(block, screen.width_resolution - x0);
+        const int n = count * 3;
+
+        // Exposure; the components go through float like Color::r(), g() and b()
+        screen.pixels.read_row(x0, j, count, colors);
+        for (int i = 0; i < count; ++i)
+        {
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                values[3 * i + channel] = static_cast<float>(colors[i][channel] * exposure_scale);
+            }
+        }
+
+        // Tone map operator
+        if (settings.tone_map == ToneMapOperator::Reinhard)
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                const double v = std::max(values[k], 0.0);
+                values[k] = v / (1.0 + v);
+            }
+        }
+        else if (settings.tone_map == ToneMapOperator::Aces)
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                const double v = std::max(values[k], 0.0);
+                values[k] = (v * (2.51 * v + 0.03)) / (v * (2.43 * v + 0.59) + 0.14);
+            }
+        }
+
+        // Transfer function, scaled to [0, 255]
+        if (settings.transfer == TransferFunction::Srgb)
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                const double position = std::clamp(values[k], 0.0, 1.0) * table_size;
+                const int index = std::min(static_cast<int>(position), table_size - 1);
+                const double fraction = position - index;
+                values[k] = srgb_table[index] + fraction * (srgb_table[index + 1] - srgb_table[index]);
+            }
+        }
+        else
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                values[k] *= 255.0;
+            }
+        }
+
+        // Quantization: truncation, after adding the dithering threshold
+        for (int k = 0; k < n; ++k)
+        {
+            offsets[k] = 0.0;
+        }
+        if (settings.dither)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                const double threshold = (bayer[j % 8][(x0 + i) % 8] + 0.5) / 64.0;
+                offsets[3 * i] = offsets[3 * i + 1] = offsets[3 * i + 2] = threshold;
+            }
+        }
+        std::uint8_t *out = rgb + static_cast<std::size_t>(x0) * 3;
+        for (int k = 0; k < n; ++k)
+        {
+            out[k] = static_cast<std::uint8_t>(static_cast<int>(std::clamp(values[k] + offsets[k], 0.0, 255.0)));
+        }
+    }
+};
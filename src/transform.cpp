@@ -0,0 +1,186 @@
+// -*- lsst-c++ -*-
+/**
+ * @file transform.cpp
+ * @brief Implementation of the Transform class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "transform.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+    const Transform::Matrix identity_matrix = {{{1.0, 0.0, 0.0, 0.0},
+                                                {0.0, 1.0, 0.0, 0.0},
+                                                {0.0, 0.0, 1.0, 0.0}}};
+
+    // Product of two affine matrices (the implicit last row is (0, 0, 0, 1)).
+    Transform::Matrix multiply(const Transform::Matrix &a, const Transform::Matrix &b)
+    {
+        Transform::Matrix result;
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                result[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j] + (j == 3 ? a[i][3] : 0.0);
+            }
+        }
+        return result;
+    }
+
+    // Inverse of an affine matrix (cofactors of the linear part, then the translation).
+    Transform::Matrix invert(const Transform::Matrix &a)
+    {
+        double det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) -
+                     a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+                     a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+        if (det == 0.0)
+        {
+            throw std::invalid_argument("Transform: the matrix is not invertible.");
+        }
+        double inv_det = 1.0 / det;
+
+        Transform::Matrix r;
+        r[0][0] = (a[1][1] * a[2][2] - a[1][2] * a[2][1]) * inv_det;
+        r[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * inv_det;
+        r[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * inv_det;
+        r[1][0] = (a[1][2] * a[2][0] - a[1][0] * a[2][2]) * inv_det;
+        r[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * inv_det;
+        r[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * inv_det;
+        r[2][0] = (a[1][0] * a[2][1] - a[1][1] * a[2][0]) * inv_det;
+        r[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * inv_det;
+        r[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * inv_det;
+        for (int i = 0; i < 3; ++i)
+        {
+            r[i][3] = -(r[i][0] * a[0][3] + r[i][1] * a[1][3] + r[i][2] * a[2][3]);
+        }
+        return r;
+    }
+
+    Vec3 apply_to_point(const Transform::Matrix &a, const Vec3 &p)
+    {
+        return Vec3(a[0][0] * p[0] + a[0][1] * p[1] + a[0][2] * p[2] + a[0][3],
+                    a[1][0] * p[0] + a[1][1] * p[1] + a[1][2] * p[2] + a[1][3],
+                    a[2][0] * p[0] + a[2][1] * p[1] + a[2][2] * p[2] + a[2][3]);
+    }
+
+    Vec3 apply_to_vector(const Transform::Matrix &a, const Vec3 &v)
+    {
+        return Vec3(a[0][0] * v[0] + a[0][1] * v[1] + a[0][2] * v[2],
+                    a[1][0] * v[0] + a[1][1] * v[1] + a[1][2] * v[2],
+                    a[2][0] * v[0] + a[2][1] * v[1] + a[2][2] * v[2]);
+    }
+}
+
+Transform::Transform() : m(identity_matrix), m_inv(identity_matrix) {}
+
+Transform::Transform(const Matrix &m) : m(m), m_inv(invert(m)) {}
+
+Transform Transform::translation(const Vec3 &offset)
+{
+    Matrix t = identity_matrix;
+    Matrix t_inv = identity_matrix;
+    for (int i = 0; i < 3; ++i)
+    {
+        t[i][3] = offset[i];
+        t_inv[i][3] = -offset[i];
+    }
+    return Transform(t, t_inv);
+};
+
+Transform Transform::scaling(const Vec3 &factors)
+{
+    Matrix s = identity_matrix;
+    for (int i = 0; i < 3; ++i)
+    {
+        s[i][i] = factors[i];
+    }
+    return Transform(s);
+};
+
+Transform Transform::rotation(const Vec3 &axis, double angle)
+{
+    Vec3 a = axis.normalize();
+    double c = std::cos(angle);
+    double s = std::sin(angle);
+    double k = 1.0 - c;
+
+    // Rodrigues' rotation formula
+    Matrix r = {{{c + a[0] * a[0] * k, a[0] * a[1] * k - a[2] * s, a[0] * a[2] * k + a[1] * s, 0.0},
+                 {a[1] * a[0] * k + a[2] * s, c + a[1] * a[1] * k, a[1] * a[2] * k - a[0] * s, 0.0},
+                 {a[2] * a[0] * k - a[1] * s, a[2] * a[1] * k + a[0] * s, c + a[2] * a[2] * k, 0.0}}};
+    Matrix r_inv = identity_matrix;
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            r_inv[i][j] = r[j][i]; // orthogonal matrix
+        }
+    }
+    return Transform(r, r_inv);
+};
+
+Transform Transform::operator*(const Transform &other) const
+{
+    return Transform(multiply(m, other.m), multiply(other.m_inv, m_inv));
+};
+
+Transform Transform::inverse() const
+{
+    return Transform(m_inv, m);
+};
+
+Vec3 Transform::transform_point(const Vec3 &p) const
+{
+    return apply_to_point(m, p);
+};
+
+Vec3 Transform::transform_vector(const Vec3 &v) const
+{
+    return apply_to_vector(m, v);
+};
+
+Vec3 Transform::transform_normal(const Vec3 &n) const
+{
+    // Transposed inverse of the linear part
+    return Vec3(m_inv[0][0] * n[0] + m_inv[1][0] * n[1] + m_inv[2][0] * n[2],
+                m_inv[0][1] * n[0] + m_inv[1][1] * n[1] + m_inv[2][1] * n[2],
+                m_inv[0][2] * n[0] + m_inv[1][2] * n[1] + m_inv[2][2] * n[2]);
+};
+
+Ray Transform::transform_ray(const Ray &ray) const
+{
+    return Ray(transform_point(ray.source), transform_vector(ray.direction), ray.t_min, ray.t_max);
+};
+
+Vec3 Transform::inverse_transform_point(const Vec3 &p) const
+{
+    return apply_to_point(m_inv, p);
+};
+
+Ray Transform::inverse_transform_ray(const Ray &ray) const
+{
+    return Ray(apply_to_point(m_inv, ray.source), apply_to_vector(m_inv, ray.direction), ray.t_min, ray.t_max);
+};
+
+Aabb Transform::transform_bounds(const Aabb &box) const
+{
+    Aabb result;
+    if (box.empty())
+    {
+        return result;
+    }
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        Vec3 p((corner & 1) ? box.max[0] : box.min[0],
+               (corner & 2) ? box.max[1] : box.min[1],
+               (corner & 4) ? box.max[2] : box.min[2]);
+        result.expand(transform_point(p));
+    }
+    return result;
+};
@@ -8,6 +8,7 @@
  */
 
 #include "vec3.hpp"
+#include "checked_math.hpp"
 #include <stdexcept> // For handling exceptions like length_error and runtime_error
 #include <cmath>     // For std::sqrt
 
@@ -77,12 +78,16 @@ Vec3 &Vec3::operator*=(const double &a)
     return *this;
 }
 
-// Scalar division operator (with division by zero check)
+// Scalar division operator (division by zero checked or counted, see checked_math.hpp)
 Vec3 &Vec3::operator/=(const double &a)
 {
     if (a == 0.0)
     {
-        throw std::runtime_error("Division by zero is not allowed.");
+        if (checked_math)
+        {
+            throw std::runtime_error("Division by zero is not allowed.");
+        }
+        report_degenerate_math(DegenerateMath::DivisionByZero);
     }
     for (size_t i = 0; i < 3; ++i)
     {
@@ -115,13 +120,9 @@ Vec3 Vec3::operator*(const double &a) const
     return result;
 }
 
-// Non-modifying scalar division (with division by zero check)
+// Non-modifying scalar division (the check is done by /=)
 Vec3 Vec3::operator/(const double &a) const
 {
-    if (a == 0.0)
-    {
-        throw std::runtime_error("Division by zero is not allowed.");
-    }
     Vec3 result = *this;
     result /= a; // Use the /= operator we already defined
     return result;
@@ -157,23 +158,32 @@ double Vec3::norm() const
     return std::hypot((*this)[0], (*this)[1], (*this)[2]);
 }
 
+// Unit vector (zero length checked or counted, see checked_math.hpp)
 Vec3 Vec3::normalize() const
 {
     double n = norm();
     if (n == 0)
     {
-        throw std::runtime_error("Cannot normalize a zero-length vector");
+        if (checked_math)
+        {
+            throw std::runtime_error("Cannot normalize a zero-length vector");
+        }
+        report_degenerate_math(DegenerateMath::ZeroLengthNormalize);
+    }
+    Vec3 result = *this;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        result[i] /= n;
     }
-    return *this / n;
+    return result;
 }
 
 // Cross product of this vector and another vector
 Vec3 cross(const Vec3 &u, const Vec3 &v)
 {
-    return Vec3{
-        u[1] * v[2] - u[2] * v[1],
-        u[2] * v[0] - u[0] * v[2],
-        u[0] * v[1] - u[1] * v[0]};
+    return Vec3(u[1] * v[2] - u[2] * v[1],
+                u[2] * v[0] - u[0] * v[2],
+                u[0] * v[1] - u[1] * v[0]);
 }
 
 // Hadamard product of this vector and another vector
@@ -0,0 +1,348 @@
+// -*- lsst-c++ -*-
+/**
+ * @file wavefront.cpp
+ * @brief Implementation of the WavefrontRenderer class.
+ *
+ * @version 0.1
+ * @date 2024
+ * @author Etienne Rosin
+ */
+
+#include "wavefront.hpp"
+#include "allocation_counter.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Number of queue entries processed per chunk of a parallel stage.
+    const std::size_t stage_grain = 256;
+
+    // Bits of the Morton code of a shadow ray origin along each axis (128³ cells over the batch).
+    const int morton_axis_bits = 7;
+}
+
+void RayQueue::resize(std::size_t count)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        origin[axis].resize(count);
+        direction[axis].resize(count);
+    }
+    t_min.resize(count);
+    t_max.resize(count);
+    pixel.resize(count);
+};
+
+void RayQueue::reserve(std::size_t count)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        origin[axis].reserve(count);
+        direction[axis].reserve(count);
+    }
+    t_min.reserve(count);
+    t_max.reserve(count);
+    pixel.reserve(count);
+};
+
+void RayQueue::set(std::size_t index, const Ray &ray, std::uint32_t pixel_index)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        origin[axis][index] = ray.source[axis];
+        direction[axis][index] = ray.direction[axis];
+    }
+    t_min[index] = ray.t_min;
+    t_max[index] = ray.t_max;
+    pixel[index] = pixel_index;
+};
+
+Ray RayQueue::get(std::size_t index) const
+{
+    return Ray(Vec3(origin[0][index], origin[1][index], origin[2][index]),
+               Vec3(direction[0][index], direction[1][index], direction[2][index]), t_min[index], t_max[index]);
+};
+
+WavefrontRenderer::WavefrontRenderer(std::size_t batch_size, bool sort_rays) : batch_size(std::max<std::size_t>(1, batch_size)), sort_rays(sort_rays) {}
+
+// Color the screen by ray tracing the scene, one stage at a time.
+void WavefrontRenderer::render(Screen &screen, Scene &scene, const Vec3 &camera_position, int max_hit, ThreadPool &pool, AovBuffers *aovs)
+{
+    const std::size_t pixel_count = static_cast<std::size_t>(screen.width_resolution) * screen.height_resolution;
+
+    // Queues sized for a full batch: the first batches (top rows) are mostly background and would
+    // size them too small. The batches after the first must not allocate (checked on the calling thread)
+    const std::size_t shadow_capacity = batch_size * scene.lights.size();
+    primary.reserve(batch_size);
+    hits.reserve(batch_size);
+    active.reserve(batch_size);
+    shadow.reserve(shadow_capacity);
+    light_visible.reserve(shadow_capacity);
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        contribution[channel].reserve(shadow_capacity);
+    }
+    if (sort_rays)
+    {
+        shadow_order.reserve(shadow_capacity);
+        sort_buffers.reserve(shadow_capacity);
+    }
+
+    // Pixels in render order: tile by tile when the image is spilled, so that a batch never
+    // spans more tiles than the memory budget holds
+    std::size_t steady_allocations = 0;
+    std::size_t count = 0;
+    for (std::size_t first_pixel = 0; first_pixel < pixel_count; first_pixel += count)
+    {
+        std::size_t allocations = thread_allocation_count();
+        std::clog << "\rPixels to render remaining: " << (pixel_count - first_pixel) << ' ' << std::flush;
+        count = std::min(batch_size, screen.pixels.render_order_limit(first_pixel));
+
+        generate(screen, camera_position, first_pixel, count, pool);
+        if (max_hit <= 0)
+        {
+            // Empty optical path: the depth-first renderer paints the pixel black
+            for (std::size_t slot = 0; slot < count; ++slot)
+            {
+                std::uint32_t pixel = primary.pixel[slot];
+                screen.color_pixel(pixel % screen.width_resolution, pixel / screen.width_resolution, Color(0.0, 0.0, 0.0));
+            }
+        }
+        else if (max_hit == 1)
+        {
+            // A single-element optical path leaves the background untouched
+            if (aovs != nullptr)
+            {
+                extend(scene, pool);
+                record_aovs(scene, *aovs, false, pool);
+            }
+        }
+        else
+        {
+            extend(scene, pool);
+            compact_misses();
+            shade(scene, pool);
+            if (sort_rays)
+            {
+                sort_shadows(pool);
+            }
+            trace_shadows(scene, pool);
+            accumulate(screen, scene, max_hit, pool);
+            if (aovs != nullptr)
+            {
+                record_aovs(scene, *aovs, true, pool);
+            }
+        }
+        screen.pixels.complete_range(first_pixel, count);
+        if (first_pixel > 0)
+        {
+            steady_allocations += thread_allocation_count() - allocations;
+        }
+    }
+    std::cout << std::flush;
+    if (steady_allocations > 0)
+    {
+        std::cerr << "\nWarning: " << steady_allocations << " heap allocations in the steady-state render loop.\n";
+    }
+};
+
+// Generate stage: one camera ray per pixel of the batch.
+void WavefrontRenderer::generate(Screen &screen, const Vec3 &camera_position, std::size_t first_pixel, std::size_t count, ThreadPool &pool)
+{
+    primary.resize(count);
+    pool.parallel_for(count, stage_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t slot = begin; slot < end; ++slot)
+        {
+            int i, j;
+            screen.pixels.render_order_pixel(first_pixel + slot, i, j);
+            std::uint32_t pixel = static_cast<std::uint32_t>(j) * screen.width_resolution + i;
+            primary.set(slot, screen.get_ray_passing_through_pixel(i, j, camera_position), pixel);
+        } });
+};
+
+// Extend stage: closest hit of every camera ray.
+void WavefrontRenderer::extend(Scene &scene, ThreadPool &pool)
+{
+    hits.resize(primary.size());
+    pool.parallel_for(primary.size(), stage_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t slot = begin; slot < end; ++slot)
+        {
+            hits[slot] = scene.find_first_intersection(primary.get(slot));
+        } });
+};
+
+// Miss stage: rays that hit nothing keep the background color and leave the pipeline.
+void WavefrontRenderer::compact_misses()
+{
+    active.clear();
+    for (std::uint32_t slot = 0; slot < hits.size(); ++slot)
+    {
+        if (hits[slot].valid)
+        {
+            active.push_back(slot);
+        }
+    }
+};
+
+// Shade stage: one shadow ray (and its potential contribution) per active hit and light.
+void WavefrontRenderer::shade(Scene &scene, ThreadPool &pool)
+{
+    const std::size_t light_count = scene.lights.size();
+    const std::size_t count = active.size() * light_count;
+    shadow.resize(count);
+    light_visible.resize(count);
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        contribution[channel].resize(count);
+    }
+
+    pool.parallel_for(active.size(), stage_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t k = begin; k < end; ++k)
+        {
+            const Intersection &intersection = hits[active[k]];
+            Vec3 normal_at_point = scene.get_normal(intersection);
+            Vec3 geometric_normal = scene.get_geometric_normal(intersection);
+
+            for (std::size_t l = 0; l < light_count; ++l)
+            {
+                const Light &light = scene.lights[l];
+                std::size_t slot = k * light_count + l;
+                light_visible[slot] = scene.light_is_facing_intersection(light, intersection, normal_at_point) ? 1 : 0;
+                if (!light_visible[slot])
+                {
+                    continue;
+                }
+
+                Ray light_ray = create_ray_from_points(intersection.point, light.position);
+                float cos_theta = normal_at_point.dot(light_ray.direction);
+                Vec3 lambert = Hadamard(intersection.element->material.albedo, light.color) * cos_theta;
+
+                shadow.set(slot, scene.shadow_ray(light, intersection.point, geometric_normal), primary.pixel[active[k]]);
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    contribution[channel][slot] = lambert[channel];
+                }
+            }
+        } });
+};
+
+// Sort stage: order the shadow rays by direction octant, then by Morton code of their origin.
+void WavefrontRenderer::sort_shadows(ThreadPool &pool)
+{
+    const std::size_t count = shadow.size();
+
+    // Bounds of the origins of the rays to trace: one partial box per thread
+    origin_bounds.assign(pool.size(), Aabb());
+    pool.parallel_for(count, stage_grain, [&](std::size_t begin, std::size_t end, unsigned thread)
+                      {
+        for (std::size_t slot = begin; slot < end; ++slot)
+        {
+            if (light_visible[slot])
+            {
+                origin_bounds[thread].expand(Vec3(shadow.origin[0][slot], shadow.origin[1][slot], shadow.origin[2][slot]));
+            }
+        } });
+    Aabb bounds;
+    for (const Aabb &box : origin_bounds)
+    {
+        bounds.expand(box);
+    }
+    const Vec3 extent = bounds.extent();
+
+    // Key: octant (3 bits) above the Morton code (3 x 7 bits). Rays that are not traced get key 0.
+    shadow_order.resize(count);
+    pool.parallel_for(count, stage_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t slot = begin; slot < end; ++slot)
+        {
+            std::uint32_t key = 0;
+            if (light_visible[slot])
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    key = (key << 1) | (shadow.direction[axis][slot] < 0.0 ? 1 : 0);
+                }
+                std::uint32_t code = 0;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    const double x = extent[axis] > 0.0 ? (shadow.origin[axis][slot] - bounds.min[axis]) / extent[axis] : 0.0;
+                    code = (code << 1) | spread_bits(static_cast<std::uint32_t>(std::min(127.0, x * 128.0)));
+                }
+                key = (key << (3 * morton_axis_bits)) | code;
+            }
+            shadow_order[slot] = static_cast<std::uint64_t>(key) << 32 | slot;
+        } });
+    radix_sort(shadow_order, 32, 3 + 3 * morton_axis_bits, pool, sort_buffers);
+};
+
+// Shadow stage: any-hit query for every shadow ray of a light facing its hit point (in sorted order if enabled).
+void WavefrontRenderer::trace_shadows(Scene &scene, ThreadPool &pool)
+{
+    pool.parallel_for(shadow.size(), stage_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t k = begin; k < end; ++k)
+        {
+            const std::size_t slot = sort_rays ? static_cast<std::uint32_t>(shadow_order[k]) : k;
+            if (light_visible[slot] && scene.is_occluded(shadow.get(slot)))
+            {
+                light_visible[slot] = 0;
+            }
+        } });
+};
+
+// Accumulate stage: same accumulation order as the depth-first renderer.
+void WavefrontRenderer::accumulate(Screen &screen, Scene &scene, int max_hit, ThreadPool &pool)
+{
+    const std::size_t light_count = scene.lights.size();
+    pool.parallel_for(active.size(), stage_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t k = begin; k < end; ++k)
+        {
+            const Intersection &intersection = hits[active[k]];
+            Color pixel_color = Color(0.0, 0.0, 0.0);
+
+            // propagate_ray re-traces the camera ray, so the optical path repeats this hit max_hit times
+            for (int hit = 0; hit < max_hit; ++hit)
+            {
+                for (std::size_t l = 0; l < light_count; ++l)
+                {
+                    std::size_t slot = k * light_count + l;
+                    if (light_visible[slot])
+                    {
+                        pixel_color += Vec3(contribution[0][slot], contribution[1][slot], contribution[2][slot]);
+                    }
+                }
+                pixel_color *= intersection.element->material.reflectance;
+            }
+
+            std::uint32_t pixel = primary.pixel[active[k]];
+            screen.color_pixel(pixel % screen.width_resolution, pixel / screen.width_resolution, pixel_color);
+        } });
+};
+
+// AOV stage: first hit of every camera ray of the batch, and the shadow rays the shade stage traced for it.
+void WavefrontRenderer::record_aovs(Scene &scene, AovBuffers &aovs, bool traced_shadows, ThreadPool &pool)
+{
+    const bool count_shadow_rays = traced_shadows && aovs.has(AovBuffers::ShadowRays);
+    pool.parallel_for(hits.size(), stage_grain, [&](std::size_t begin, std::size_t end, unsigned)
+                      {
+        for (std::size_t slot = begin; slot < end; ++slot)
+        {
+            const Intersection &intersection = hits[slot];
+            std::uint32_t shadow_rays = 0;
+            if (count_shadow_rays && intersection.valid)
+            {
+                Vec3 normal_at_point = scene.get_normal(intersection);
+                for (const Light &light : scene.lights)
+                {
+                    shadow_rays += scene.light_is_facing_intersection(light, intersection, normal_at_point) ? 1 : 0;
+                }
+            }
+            std::uint32_t pixel = primary.pixel[slot];
+            aovs.record(pixel % aovs.width, pixel / aovs.width, scene, intersection, shadow_rays);
+        } });
+};